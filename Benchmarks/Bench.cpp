@@ -0,0 +1,276 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Net/NeuralNet.hpp"
+
+/*
+ * Benchmarks of the Matrix operations and of NeuralNet training, for catching performance regressions.
+ * Each case runs for at least --min-time milliseconds, five times over, and keeps the fastest run; it reports
+ * the time per call with GFLOP/s, GB/s or samples/s where they apply, and the heap blocks Matrix storage took
+ * per step. The table goes to stdout, and with --json the same results go to a file that runs on other
+ * commits or machines can be compared with.
+ *
+ *     bnn_bench [--filter SUBSTRING] [--min-time MS] [--threads N] [--json FILE]
+ */
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+    using nnint = std::size_t;
+
+    struct Options {
+        // run only the cases whose name contains filter
+        std::string filter;
+        // where to write the results as JSON, empty for nowhere
+        std::string json;
+        double min_time = 100;
+        nnint threads = 0;
+    };
+
+    struct Result {
+        // e.g. "matrix.multiply/float/n=256"
+        std::string name;
+        std::vector<std::pair<std::string, nnint> > params;
+        // per call: fastest time, and floating point operations, bytes and samples it covers (0 where
+        // they do not apply), training steps it takes, and heap blocks it took
+        double seconds, flops, bytes, samples, steps, allocations;
+    };
+
+    struct Timing {
+        double seconds, allocations;
+    };
+
+    // seconds and heap blocks per call of f, from the fastest of five runs of at least min_time ms each,
+    // after one call that warms up caches and workspaces
+    template<typename F>
+    Timing measure(F const &f, double min_time) {
+        f();
+        Timing best{1e300, 0};
+        for (int rep = 0; rep < 5; rep++) {
+            nnint iterations = 0;
+            nnint const before = LinearAlgebra::heap_allocations();
+            auto const start = Clock::now();
+            double elapsed = 0;
+            do {
+                f();
+                iterations++;
+                elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            } while (elapsed < min_time);
+            double const seconds = elapsed / 1e3 / static_cast<double>(iterations);
+            if (seconds < best.seconds) {
+                best = {seconds, static_cast<double>(LinearAlgebra::heap_allocations() - before) /
+                                 static_cast<double>(iterations)};
+            }
+        }
+        return best;
+    }
+
+    class Suite {
+        Options options;
+        std::vector<Result> results;
+
+        static std::string describe(std::string name, std::vector<std::pair<std::string, nnint> > const &params) {
+            for (auto const &param : params) {
+                name += "/" + param.first + "=" + std::to_string(param.second);
+            }
+            return name;
+        }
+
+    public:
+        explicit Suite(Options options) : options(std::move(options)) {
+            std::printf("%-48s %12s %9s %9s %12s %11s\n", "case", "time us", "GFLOP/s", "GB/s", "samples/s",
+                        "allocs/step");
+        }
+
+        // whether a case named name, with params, is to run; checked before building its inputs
+        bool wanted(std::string const &name, std::vector<std::pair<std::string, nnint> > const &params) const {
+            return options.filter.empty() || describe(name, params).find(options.filter) != std::string::npos;
+        }
+
+        // time f, which covers the given work per call
+        template<typename F>
+        void run(std::string const &name, std::vector<std::pair<std::string, nnint> > params, double flops,
+                 double bytes, double samples, double steps, F const &f) {
+            Timing const t = measure(f, options.min_time);
+            Result const &r = results.emplace_back(
+                    Result{name, std::move(params), t.seconds, flops, bytes, samples, steps, t.allocations});
+            std::string const full = describe(r.name, r.params);
+            std::printf("%-48s %12.2f %9.2f %9.2f %12.0f %11.2f\n", full.c_str(), r.seconds * 1e6,
+                        r.flops / r.seconds / 1e9, r.bytes / r.seconds / 1e9, r.samples / r.seconds,
+                        r.allocations / r.steps);
+            std::fflush(stdout);
+        }
+
+        // one object: the machine, and one entry per case with only the rates that apply to it
+        bool write_json() const {
+            if (options.json.empty()) {
+                return true;
+            }
+            std::FILE *file = std::fopen(options.json.c_str(), "w");
+            if (file == nullptr) {
+                return false;
+            }
+            std::fprintf(file, "{\n  \"isa\": \"%s\",\n  \"threads\": %zu,\n  \"min_time_ms\": %g,\n  \"results\": [",
+                         LinearAlgebra::Kernels::isa_name(LinearAlgebra::Kernels::active_isa()),
+                         LinearAlgebra::get_threads(), options.min_time);
+            for (nnint i = 0; i < results.size(); i++) {
+                Result const &r = results[i];
+                std::fprintf(file, "%s\n    {\"name\": \"%s\", \"params\": {", i == 0 ? "" : ",", r.name.c_str());
+                for (nnint p = 0; p < r.params.size(); p++) {
+                    std::fprintf(file, "%s\"%s\": %zu", p == 0 ? "" : ", ", r.params[p].first.c_str(),
+                                 r.params[p].second);
+                }
+                std::fprintf(file, "}, \"seconds\": %.9g", r.seconds);
+                if (r.flops > 0) {
+                    std::fprintf(file, ", \"gflops\": %.6g", r.flops / r.seconds / 1e9);
+                }
+                if (r.bytes > 0) {
+                    std::fprintf(file, ", \"gbytes_per_second\": %.6g", r.bytes / r.seconds / 1e9);
+                }
+                if (r.samples > 0) {
+                    std::fprintf(file, ", \"samples_per_second\": %.6g", r.samples / r.seconds);
+                }
+                std::fprintf(file, ", \"allocations_per_step\": %.6g}", r.allocations / r.steps);
+            }
+            std::fprintf(file, "\n  ]\n}\n");
+            return std::fclose(file) == 0;
+        }
+    };
+
+    template<typename T>
+    char const *type_name() {
+        return sizeof(T) == sizeof(float) ? "float" : "double";
+    }
+
+    // products, transposition and elementwise expressions of n x n matrices, each into an existing result
+    template<typename T>
+    void matrix_cases(Suite &suite, nnint n) {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        std::vector<std::pair<std::string, nnint> > const params{{"n", n}};
+        std::string const type = type_name<T>();
+        std::random_device rd;
+        Matrix A(n, n, rd), B(n, n, rd), C(n, n);
+        double const elements = static_cast<double>(n * n), size = sizeof(T);
+        if (suite.wanted("matrix.multiply/" + type, params)) {
+            suite.run("matrix.multiply/" + type, params, 2 * elements * static_cast<double>(n), 0, 0, 1,
+                      [&] { C = A * B; });
+        }
+        if (suite.wanted("matrix.transposed/" + type, params)) {
+            suite.run("matrix.transposed/" + type, params, 0, 2 * elements * size, 0, 1, [&] { C = A.transposed(); });
+        }
+        if (suite.wanted("matrix.add/" + type, params)) {
+            suite.run("matrix.add/" + type, params, elements, 3 * elements * size, 0, 1, [&] { C = A + B; });
+        }
+        if (suite.wanted("matrix.elementwise_multiply/" + type, params)) {
+            suite.run("matrix.elementwise_multiply/" + type, params, elements, 3 * elements * size, 0, 1,
+                      [&] { C = elementwise_multiplied(A, B); });
+        }
+    }
+
+    // NeuralNet with forward and backward callable one at a time
+    template<typename T>
+    struct Probe : Net::NeuralNet<T> {
+        using Net::NeuralNet<T>::NeuralNet;
+        using Net::NeuralNet<T>::forward;
+        using Net::NeuralNet<T>::backward;
+    };
+
+    // a depth-layer ReLU network of the given width with 10 softmax outputs, on random one-hot data
+    template<typename T>
+    void net_cases(Suite &suite, nnint width, nnint depth, nnint batch, nnint epoch) {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        std::vector<std::pair<std::string, nnint> > const params{{"width", width}, {"depth", depth}, {"batch", batch}};
+        std::string const type = type_name<T>();
+        std::string const forward = "net.forward/" + type, backward = "net.backward/" + type;
+        std::string const learn = "net.learn/" + type;
+        if (!suite.wanted(forward, params) && !suite.wanted(backward, params) &&
+            !suite.wanted(learn, params)) {
+            return;
+        }
+        std::vector<nnint> layer_size(depth, width);
+        layer_size.push_back(10);
+        Probe<T> nn(layer_size.size(), layer_size.data(), Net::Activation::ReLU, Net::Activation::Softmax,
+                    Net::Loss::SoftmaxCrossEntropy, static_cast<T>(0.01), batch);
+        std::random_device rd;
+        Matrix input(width, epoch, rd, 0, 1), answer = Matrix::Zeros(10, epoch);
+        for (nnint j = 0; j < epoch; j++) {
+            answer(rd() % 10, j) = 1;
+        }
+        // multiply-adds of one sample through every layer, and through every layer but the first
+        double products = 0, first = static_cast<double>(width * layer_size[1]);
+        for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+            products += static_cast<double>(layer_size[i] * layer_size[i + 1]);
+        }
+        auto const x = input.view().col_block(0, batch), t = answer.view().col_block(0, batch);
+        // one batch of learning leaves the network averaging gradients over batch samples
+        nn.learn(x, t);
+        double const b = static_cast<double>(batch);
+        if (suite.wanted(forward, params)) {
+            suite.run(forward, params, 2 * products * b, 0, b, 1, [&] { nn.forward(x); });
+        }
+        if (suite.wanted(backward, params)) {
+            // weight gradients for every layer, error signals for all but the first
+            nn.forward(x);
+            suite.run(backward, params, 2 * (2 * products - first) * b, 0, b, 1, [&] { nn.backward(t); });
+        }
+        if (suite.wanted(learn, params)) {
+            double const e = static_cast<double>(epoch);
+            suite.run(learn, params, 2 * (3 * products - first) * e, 0, e, static_cast<double>((epoch + batch - 1) / batch),
+                      [&] { nn.learn(input, answer); });
+        }
+    }
+
+    bool parse(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; i++) {
+            bool const value = i + 1 < argc;
+            if (std::strcmp(argv[i], "--filter") == 0 && value) {
+                options.filter = argv[++i];
+            } else if (std::strcmp(argv[i], "--json") == 0 && value) {
+                options.json = argv[++i];
+            } else if (std::strcmp(argv[i], "--min-time") == 0 && value) {
+                options.min_time = std::atof(argv[++i]);
+            } else if (std::strcmp(argv[i], "--threads") == 0 && value) {
+                options.threads = static_cast<nnint>(std::atoi(argv[++i]));
+            } else {
+                return false;
+            }
+        }
+        return options.min_time > 0;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--filter SUBSTRING] [--min-time MS] [--threads N] [--json FILE]\n", argv[0]);
+        return 2;
+    }
+    if (options.threads != 0) {
+        LinearAlgebra::set_threads(options.threads);
+    }
+    std::printf("vector path: %s, threads: %zu\n", LinearAlgebra::Kernels::isa_name(LinearAlgebra::Kernels::active_isa()),
+                LinearAlgebra::get_threads());
+    Suite suite(options);
+    for (nnint n : {64, 256, 1024}) {
+        matrix_cases<float>(suite, n);
+        matrix_cases<double>(suite, n);
+    }
+    for (nnint depth : {2, 4}) {
+        for (nnint width : {64, 256, 1024}) {
+            net_cases<float>(suite, width, depth, 64, 1024);
+            net_cases<double>(suite, width, depth, 64, 1024);
+        }
+    }
+    if (!suite.write_json()) {
+        std::fprintf(stderr, "cannot write %s\n", options.json.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/ThreadPool.hpp"
+
+/*
+ * Per-op timing of the elementwise kernels: the scalar loop against the vector path
+ * chosen for this cpu, both on one thread, then the vector path split over the thread pool.
+ * All write into a preallocated matrix, so only the loop is measured.
+ */
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // nanoseconds per element of the fastest of several runs
+    template<typename F>
+    double time_per_element(F const &f, std::size_t elements) {
+        double best = 1e300;
+        for (int rep = 0; rep < 5; rep++) {
+            std::size_t iterations = 0;
+            auto const start = Clock::now();
+            double elapsed = 0;
+            do {
+                f();
+                iterations++;
+                elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            } while (elapsed < 2e7);
+            best = std::min(best, elapsed / static_cast<double>(iterations * elements));
+        }
+        return best;
+    }
+
+    template<typename T, typename E>
+    void report(char const *type, char const *op, std::size_t n, LinearAlgebra::Matrix<T> &out, E const &e) {
+        using namespace LinearAlgebra;
+        T *dst = out.data();
+        std::size_t const ld = out.get_ld();
+        std::size_t const threads = get_threads();
+        double const scalar = time_per_element([&] { Kernels::evaluate_scalar(e, n, n, dst, ld); }, n * n);
+        set_threads(1);
+        double const simd = time_per_element([&] { Kernels::evaluate(e, n, n, dst, ld); }, n * n);
+        set_threads(threads);
+        double const threaded = time_per_element([&] { Kernels::evaluate(e, n, n, dst, ld); }, n * n);
+        std::printf("%-7s %-22s %5zu %10.3f %10.3f %8.2fx\n", type, op, n, scalar, simd, scalar / simd);
+        std::printf("%-7s %-22s %5zu %10s %10.3f %8.2fx  on %zu thread(s)\n", "", "", n, "", threaded,
+                    simd / threaded, threads);
+    }
+
+    template<typename T>
+    void run(char const *type, std::size_t n) {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        std::random_device rd;
+        Matrix A(n, n, rd), B(n, n, rd), C(n, n);
+        T const s = static_cast<T>(1.5);
+        B += static_cast<T>(8);
+        report(type, "add", n, C, A + B);
+        report(type, "subtract", n, C, A - B);
+        report(type, "multiply(T)", n, C, A * s);
+        report(type, "divide(T)", n, C, A / s);
+        report(type, "elementwise_multiply", n, C, elementwise_multiplied(A, B));
+        report(type, "elementwise_divide", n, C, elementwise_divided(A, B));
+    }
+
+}
+
+int main() {
+    std::printf("vector path: %s\n", LinearAlgebra::Kernels::isa_name(LinearAlgebra::Kernels::active_isa()));
+    std::printf("%-7s %-22s %5s %10s %10s %9s\n", "type", "op", "n", "scalar ns", "simd ns", "speedup");
+    for (std::size_t n : {64, 512, 2048}) {
+        run<float>("float", n);
+        run<double>("double", n);
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#ifndef BNN_Data_BatchLoader_hpp
+#define BNN_Data_BatchLoader_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Dataset.hpp"
+#include "../LinearAlgebra/Matrix.hpp"
+
+namespace Data {
+
+    /*
+     * Batches of matching input and answer samples, assembled on a background thread.
+     * The thread walks the datasets epoch after epoch, in a fresh random order each time when
+     * shuffling, and packs each batch into one of two buffers while the caller trains on the other.
+     * next() hands out the batches of one epoch as one sample per column, then returns false once
+     * and starts on the following epoch; a batch stays valid until the next call.
+     */
+    template<typename T>
+    class BatchLoader {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        struct Buffer {
+            Matrix input, answer;
+            // samples in the batch, 0 for the end of an epoch
+            nnint count;
+        };
+
+        Dataset<T> inputs, answers;
+        nnint batch_size;
+        bool shuffle;
+        std::mt19937 random;
+
+        Buffer buffers[2];
+        std::mutex mutex;
+        std::condition_variable filled, emptied;
+        // batches (and epoch ends) the thread has packed, and the caller has finished with
+        nnint produced, consumed;
+        // the caller holds the buffer of batch consumed
+        bool holding;
+        bool stopping;
+        std::thread worker;
+
+        void fill(Buffer &buffer, std::vector<nnint> const &order, nnint first, nnint count) {
+            T *in = buffer.input.data(), *out = buffer.answer.data();
+            nnint const ldi = buffer.input.get_ld(), lda = buffer.answer.get_ld();
+            for (nnint j = 0; j < count; j++) {
+                inputs.read(order[first + j], in + j, ldi);
+                answers.read(order[first + j], out + j, lda);
+            }
+            buffer.count = count;
+        }
+
+        // waits for a free buffer, false when stopping
+        bool acquire() {
+            std::unique_lock<std::mutex> lock(mutex);
+            emptied.wait(lock, [&] { return stopping || produced - consumed < 2; });
+            return !stopping;
+        }
+
+        void publish() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                produced++;
+            }
+            filled.notify_one();
+        }
+
+        void run() {
+            std::vector<nnint> order(inputs.size());
+            std::iota(order.begin(), order.end(), nnint(0));
+            for (;;) {
+                if (shuffle) {
+                    std::shuffle(order.begin(), order.end(), random);
+                }
+                for (nnint first = 0; first < order.size(); first += batch_size) {
+                    if (!acquire()) {
+                        return;
+                    }
+                    // only this thread touches buffer produced % 2 until it is published
+                    fill(buffers[produced % 2], order, first, std::min(batch_size, order.size() - first));
+                    publish();
+                }
+                if (!acquire()) {
+                    return;
+                }
+                buffers[produced % 2].count = 0;
+                publish();
+            }
+        }
+
+    public:
+        // inputs and answers must be valid and hold the same number of samples
+        BatchLoader(Dataset<T> inputs, Dataset<T> answers, nnint batch_size, bool shuffle = true,
+                    unsigned seed = std::random_device()())
+                : inputs(std::move(inputs)), answers(std::move(answers)), batch_size(batch_size),
+                  shuffle(shuffle), random(seed), produced(0), consumed(0), holding(false), stopping(false) {
+            assert(this->inputs.valid() && this->answers.valid() && batch_size != 0);
+            assert(this->inputs.size() == this->answers.size() && this->inputs.size() != 0);
+            for (Buffer &buffer : buffers) {
+                buffer.input.resize(this->inputs.features(), batch_size);
+                buffer.answer.resize(this->answers.features(), batch_size);
+                buffer.count = 0;
+            }
+            worker = std::thread([this] { run(); });
+        }
+
+        BatchLoader(BatchLoader const &) = delete;
+        BatchLoader &operator=(BatchLoader const &) = delete;
+
+        ~BatchLoader() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            emptied.notify_one();
+            worker.join();
+        }
+
+        // the next batch of the epoch into input and answer, or false at the end of the epoch
+        bool next(ConstView &input, ConstView &answer) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (holding) {
+                consumed++;
+                holding = false;
+                emptied.notify_one();
+            }
+            filled.wait(lock, [&] { return produced > consumed; });
+            Buffer const &buffer = buffers[consumed % 2];
+            if (buffer.count == 0) {
+                consumed++;
+                emptied.notify_one();
+                return false;
+            }
+            holding = true;
+            input = buffer.input.view().col_block(0, buffer.count);
+            answer = buffer.answer.view().col_block(0, buffer.count);
+            return true;
+        }
+
+        nnint size() const {
+            return inputs.size();
+        }
+        nnint get_batch_size() const {
+            return batch_size;
+        }
+    };
+
+}
+
+#endif
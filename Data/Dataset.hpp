@@ -0,0 +1,217 @@
+#ifndef BNN_Data_Dataset_hpp
+#define BNN_Data_Dataset_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "MappedFile.hpp"
+
+/*
+ * Samples stored back to back in one binary file, read in place from a mapping.
+ * IDX files (the MNIST format: a big-endian header giving the element type and the dimensions,
+ * the first of which counts the samples) hold any of their element types; raw files are native
+ * float32 with a sample size given by the caller. read converts one sample to T into a column of
+ * a batch, scaled, or one-hot encoded for class labels.
+ */
+
+namespace Data {
+
+    enum class Element {
+        UInt8,
+        Int8,
+        Int16,
+        Int32,
+        Float32,
+        Float64
+    };
+
+    namespace detail {
+
+        inline std::size_t element_size(Element element) {
+            switch (element) {
+                case Element::UInt8:
+                case Element::Int8:
+                    return 1;
+                case Element::Int16:
+                    return 2;
+                case Element::Int32:
+                case Element::Float32:
+                    return 4;
+                default:
+                    return 8;
+            }
+        }
+
+        inline std::uint32_t big_endian32(unsigned char const *p) {
+            return std::uint32_t(p[0]) << 24 | std::uint32_t(p[1]) << 16 | std::uint32_t(p[2]) << 8 | p[3];
+        }
+
+        // element k of a run of elements, byte-swapped first when they are big-endian
+        template<typename T>
+        T load(Element element, bool big_endian, unsigned char const *p, std::size_t k) {
+            std::size_t const size = element_size(element);
+            unsigned char bytes[8];
+            p += k * size;
+            for (std::size_t b = 0; b < size; b++) {
+                bytes[b] = big_endian ? p[size - 1 - b] : p[b];
+            }
+            switch (element) {
+                case Element::UInt8:
+                    return static_cast<T>(bytes[0]);
+                case Element::Int8:
+                    return static_cast<T>(static_cast<std::int8_t>(bytes[0]));
+                case Element::Int16: {
+                    std::int16_t v;
+                    std::memcpy(&v, bytes, sizeof(v));
+                    return static_cast<T>(v);
+                }
+                case Element::Int32: {
+                    std::int32_t v;
+                    std::memcpy(&v, bytes, sizeof(v));
+                    return static_cast<T>(v);
+                }
+                case Element::Float32: {
+                    float v;
+                    std::memcpy(&v, bytes, sizeof(v));
+                    return static_cast<T>(v);
+                }
+                default: {
+                    double v;
+                    std::memcpy(&v, bytes, sizeof(v));
+                    return static_cast<T>(v);
+                }
+            }
+        }
+
+    }
+
+    template<typename T>
+    class Dataset {
+        using nnint = std::size_t;
+
+        std::shared_ptr<MappedFile const> file;
+        // first byte of sample 0
+        unsigned char const *samples;
+        nnint count, sample_size;
+        Element element;
+        // multi-byte elements are big-endian (IDX) rather than native (raw)
+        bool big_endian;
+        T scale;
+        // width of the one-hot rows labels expand to, 0 to read samples as they are
+        nnint classes;
+
+        Dataset() : samples(nullptr), count(0), sample_size(0), element(Element::Float32), big_endian(false),
+                    scale(1), classes(0) {}
+
+    public:
+        // IDX file, every element multiplied by scale (1 / 255 for pixels, say)
+        static Dataset idx(std::string const &path, T scale = 1) {
+            Dataset ret;
+            ret.file = std::make_shared<MappedFile const>(path);
+            ret.scale = scale;
+            ret.big_endian = true;
+            if (!ret.file->valid() || ret.file->size() < 8) {
+                return ret;
+            }
+            unsigned char const *p = ret.file->data();
+            nnint const dims = p[3];
+            switch (p[2]) {
+                case 0x08: ret.element = Element::UInt8; break;
+                case 0x09: ret.element = Element::Int8; break;
+                case 0x0B: ret.element = Element::Int16; break;
+                case 0x0C: ret.element = Element::Int32; break;
+                case 0x0D: ret.element = Element::Float32; break;
+                case 0x0E: ret.element = Element::Float64; break;
+                default: return ret;
+            }
+            nnint const header = 4 + 4 * dims;
+            if (p[0] != 0 || p[1] != 0 || dims == 0 || ret.file->size() < header) {
+                return ret;
+            }
+            nnint const count = detail::big_endian32(p + 4);
+            nnint sample_size = 1;
+            for (nnint d = 1; d < dims; d++) {
+                sample_size *= detail::big_endian32(p + 4 + 4 * d);
+            }
+            if (sample_size == 0 ||
+                (ret.file->size() - header) / detail::element_size(ret.element) / sample_size < count) {
+                return ret;
+            }
+            ret.samples = p + header;
+            ret.count = count;
+            ret.sample_size = sample_size;
+            return ret;
+        }
+
+        // native float32 samples of sample_size elements each; a partial sample at the end is ignored
+        static Dataset raw(std::string const &path, nnint sample_size, T scale = 1) {
+            assert(sample_size != 0);
+            Dataset ret;
+            ret.file = std::make_shared<MappedFile const>(path);
+            ret.scale = scale;
+            if (ret.file->valid()) {
+                ret.samples = ret.file->data();
+                ret.count = ret.file->size() / sizeof(float) / sample_size;
+                ret.sample_size = sample_size;
+            }
+            return ret;
+        }
+
+        // the same file read as class labels, one element per sample, expanded to one-hot columns of classes
+        Dataset one_hot(nnint classes) const {
+            assert(sample_size == 1 && classes != 0);
+            Dataset ret = *this;
+            ret.classes = classes;
+            return ret;
+        }
+
+        // false when the file is missing or malformed
+        bool valid() const {
+            return samples != nullptr;
+        }
+
+        // number of samples
+        nnint size() const {
+            return count;
+        }
+
+        // rows a sample takes in a batch
+        nnint features() const {
+            return classes != 0 ? classes : sample_size;
+        }
+
+        // sample index into column dst[0], dst[stride], ... of a batch
+        void read(nnint index, T *dst, nnint stride) const {
+            assert(valid() && index < count);
+            unsigned char const *p = samples + index * sample_size * detail::element_size(element);
+            if (classes != 0) {
+                nnint const label = static_cast<nnint>(detail::load<T>(element, big_endian, p, 0));
+                for (nnint r = 0; r < classes; r++) {
+                    dst[r * stride] = static_cast<T>(r == label);
+                }
+                return;
+            }
+            if (element == Element::UInt8) {
+                for (nnint r = 0; r < sample_size; r++) {
+                    dst[r * stride] = scale * static_cast<T>(p[r]);
+                }
+            } else if (element == Element::Float32 && !big_endian) {
+                for (nnint r = 0; r < sample_size; r++) {
+                    float v;
+                    std::memcpy(&v, p + r * sizeof(float), sizeof(v));
+                    dst[r * stride] = scale * static_cast<T>(v);
+                }
+            } else {
+                for (nnint r = 0; r < sample_size; r++) {
+                    dst[r * stride] = scale * detail::load<T>(element, big_endian, p, r);
+                }
+            }
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef BNN_Data_MappedFile_hpp
+#define BNN_Data_MappedFile_hpp
+
+#include <cstddef>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Data {
+
+    // a whole file mapped read-only and shared with every other process mapping it; pages are read on
+    // first touch, so files larger than memory work too
+    class MappedFile {
+        void *address;
+        std::size_t length;
+
+    public:
+        explicit MappedFile(std::string const &path) : address(MAP_FAILED), length(0) {
+            int const fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+                length = static_cast<std::size_t>(info.st_size);
+                address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            }
+            // the mapping stays valid without the descriptor
+            ::close(fd);
+        }
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+
+        ~MappedFile() {
+            if (address != MAP_FAILED) {
+                ::munmap(address, length);
+            }
+        }
+
+        // false when the file is missing, empty or cannot be mapped
+        bool valid() const {
+            return address != MAP_FAILED;
+        }
+        unsigned char const *data() const {
+            return static_cast<unsigned char const *>(address);
+        }
+        std::size_t size() const {
+            return length;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef BNN_LinearAlgebra_Arena_hpp
+#define BNN_LinearAlgebra_Arena_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/*
+ * Bump allocator for Matrix storage.
+ * While an Arena::Scope is alive on a thread, every Matrix constructed on that thread takes
+ * its buffer from the arena instead of the heap, and freeing it costs nothing. reset() drops
+ * everything at once, so matrices created inside a scope must not outlive it.
+ * A request that does not fit falls back to the heap; the next reset() grows the arena to the
+ * observed demand, so a repeated workload stops touching the heap after its first round.
+ */
+
+namespace LinearAlgebra {
+
+    // number of heap blocks Matrix storage has taken so far, for checking allocation-free paths
+    inline std::atomic<std::size_t> &heap_allocation_counter() {
+        static std::atomic<std::size_t> counter{0};
+        return counter;
+    }
+
+    inline std::size_t heap_allocations() {
+        return heap_allocation_counter().load(std::memory_order_relaxed);
+    }
+
+    // alignment of every Matrix buffer
+    inline constexpr std::size_t storage_alignment = 64;
+
+    class Arena {
+        static constexpr std::size_t alignment = storage_alignment;
+
+        std::byte *buffer;
+        std::size_t capacity, used, demand;
+
+        static std::size_t round_up(std::size_t bytes) {
+            return (bytes + alignment - 1) / alignment * alignment;
+        }
+
+        static Arena *&current_slot() {
+            thread_local Arena *current = nullptr;
+            return current;
+        }
+
+    public:
+        explicit Arena(std::size_t bytes = 0) : buffer(nullptr), capacity(0), used(0), demand(0) {
+            reserve(bytes);
+        }
+
+        Arena(Arena const &) = delete;
+        Arena &operator=(Arena const &) = delete;
+
+        // make room for at least bytes; only call while nothing lives in the arena
+        void reserve(std::size_t bytes) {
+            bytes = round_up(bytes);
+            if (bytes <= capacity) {
+                return;
+            }
+            ::operator delete(buffer, std::align_val_t(alignment));
+            buffer = static_cast<std::byte *>(::operator new(bytes, std::align_val_t(alignment)));
+            heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+            capacity = bytes;
+        }
+
+        // 64-byte aligned block, or nullptr if the arena is full
+        void *allocate(std::size_t bytes) {
+            bytes = round_up(bytes);
+            demand += bytes;
+            if (used + bytes > capacity) {
+                return nullptr;
+            }
+            void *p = buffer + used;
+            used += bytes;
+            return p;
+        }
+
+        bool owns(void const *p) const {
+            auto const *b = static_cast<std::byte const *>(p);
+            return b >= buffer && b < buffer + capacity;
+        }
+
+        // release everything, growing to the demand seen since the last reset
+        void reset() {
+            used = 0;
+            if (demand > capacity) {
+                reserve(demand);
+            }
+            demand = 0;
+        }
+
+        std::size_t get_capacity() const {
+            return capacity;
+        }
+
+        // arena used by Matrix constructors on this thread, or nullptr for the heap
+        static Arena *current() {
+            return current_slot();
+        }
+
+        class Scope {
+            Arena *previous;
+
+        public:
+            explicit Scope(Arena &arena) : previous(current_slot()) {
+                current_slot() = &arena;
+            }
+
+            Scope(Scope const &) = delete;
+            Scope &operator=(Scope const &) = delete;
+
+            ~Scope() {
+                current_slot() = previous;
+            }
+        };
+
+        ~Arena() {
+            ::operator delete(buffer, std::align_val_t(alignment));
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef BNN_LinearAlgebra_BitMatrix_hpp
+#define BNN_LinearAlgebra_BitMatrix_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MatrixView.hpp"
+#include "Kernels/Binary.hpp"
+
+namespace LinearAlgebra {
+
+    /*
+     * The signs of a real matrix, 64 to a word, 32 times smaller than the floats.
+     * Row i holds column i of the source: bit r is set when element r is >= 0 (+1) and clear when it is
+     * negative (-1). Rows start on a whole word and the bits past the last sign are clear, which the
+     * XNOR products of Kernels/Binary.hpp rely on.
+     * Columns are what a network's weights (one per output) and batches (one per sample) are made of.
+     */
+    class BitMatrix {
+        std::vector<std::uint64_t> bits;
+        // packed rows, signs in each, and words between the starts of consecutive rows
+        std::size_t row, col, words;
+
+    public:
+        BitMatrix() : row(0), col(0), words(0) {}
+
+        template<typename X, enable_if_views_t<X> = 0>
+        explicit BitMatrix(X const &x) : BitMatrix() {
+            pack(x);
+        }
+
+        // the signs of the columns of x, reusing the storage when it is large enough
+        template<typename X, enable_if_views_t<X> = 0>
+        void pack(X const &x) {
+            using T = value_t<X>;
+            const_view_t<X> const v = x.view();
+            row = v.get_col(), col = v.get_row(), words = (col + 63) / 64;
+            bits.assign(row * words, 0);
+            // one source row at a time, so the reads run along memory
+            for (std::size_t r = 0; r < col; r++) {
+                T const *p = v.data() + r * v.get_ld();
+                std::uint64_t *w = bits.data() + r / 64;
+                std::uint64_t const bit = std::uint64_t(1) << r % 64;
+                for (std::size_t c = 0; c < row; c++) {
+                    w[c * words] |= p[c] < static_cast<T>(0) ? 0 : bit;
+                }
+            }
+        }
+
+        std::size_t get_row() const {
+            return row;
+        }
+        std::size_t get_col() const {
+            return col;
+        }
+        std::size_t get_words() const {
+            return words;
+        }
+        std::uint64_t const *data() const {
+            return bits.data();
+        }
+        std::size_t bytes() const {
+            return bits.size() * sizeof(std::uint64_t);
+        }
+    };
+
+    // C = diag(scale) * A * B^T with A and B in signs: C(i, j) = scale(i) * (row i of A) . (row j of B),
+    // an XNOR and a popcount per 64 terms
+    template<typename S, typename C, enable_if_views_t<C> = 0>
+    void xnor_gemm(BitMatrix const &a, BitMatrix const &b, S const &scale, C &&c) {
+        const_view_t<C> const vs = scale.view();
+        auto vc = c.view();
+        assert(a.get_col() == b.get_col() && vs.is_contiguous() && vs.get_row() * vs.get_col() == a.get_row());
+        assert(vc.get_row() == a.get_row() && vc.get_col() == b.get_row());
+        Kernels::xnor_gemm(a.get_row(), b.get_row(), a.get_col(), a.get_words(), a.data(), b.data(), vs.data(),
+                           vc.data(), vc.get_ld());
+    }
+
+    // C = diag(scale) * A * B with A in signs and B real: every product is an add or a subtract
+    template<typename S, typename B, typename C, enable_if_views_t<C> = 0>
+    void sign_gemm(BitMatrix const &a, S const &scale, B const &b, C &&c) {
+        const_view_t<C> const vs = scale.view(), vb = b.view();
+        auto vc = c.view();
+        assert(a.get_col() == vb.get_row() && vs.is_contiguous() && vs.get_row() * vs.get_col() == a.get_row());
+        assert(vc.get_row() == a.get_row() && vc.get_col() == vb.get_col());
+        Kernels::sign_gemm(a.get_row(), vb.get_col(), a.get_col(), a.get_words(), a.data(), vs.data(), vb.data(),
+                           vb.get_ld(), vc.data(), vc.get_ld());
+    }
+
+}
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef BNN_LinearAlgebra_Expression_hpp
+#define BNN_LinearAlgebra_Expression_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Kernels/Simd.hpp"
+
+/*
+ * Lazy elementwise expressions.
+ * +, -, scalar * and /, elementwise_multiplied and elementwise_divided only build small nodes;
+ * nothing is computed until the tree is assigned to a Matrix, which then runs one fused loop.
+ * Lvalue operands are referenced and temporaries are moved into the node that uses them,
+ * so an expression never outlives its operands.
+ *
+ * A node with `static constexpr bool vectorizable = true` also provides
+ *     template<Kernels::Isa isa> void packet(std::size_t r, std::size_t c, Vec<value_type, isa>::type &out) const;
+ * storing elements (r, c) .. (r, c + width - 1) in one Kernels::Vec register, and the fused
+ * loop then runs on whole registers with the instruction set picked at startup.
+ * Registers travel by reference so that generic code never passes them by value.
+ *
+ * map and zip apply an Operators::OperatorBase to each element of one or two operands; they vectorize
+ * when its functor does, see Ops/Operators/Operator.hpp.
+ */
+
+namespace LinearAlgebra {
+
+    // CRTP base of everything that can be evaluated elementwise
+    template<typename E>
+    struct Expression {
+        E const &self() const {
+            return static_cast<E const &>(*this);
+        }
+    };
+
+    template<typename X>
+    constexpr bool is_expression_v = std::is_base_of_v<Expression<std::decay_t<X> >, std::decay_t<X> >;
+
+    template<typename X>
+    using value_t = typename std::decay_t<X>::value_type;
+
+    template<typename X, typename = void>
+    constexpr bool is_vectorizable_v = false;
+    template<typename X>
+    constexpr bool is_vectorizable_v<X, std::enable_if_t<std::decay_t<X>::vectorizable> > = true;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+    namespace Expressions {
+
+        // how a node keeps its operand
+        template<typename X>
+        using operand_t = std::conditional_t<std::is_lvalue_reference_v<X>, std::decay_t<X> const &, std::decay_t<X> >;
+
+        struct Plus {
+            template<typename T>
+            static T apply(T a, T b) { return a + b; }
+            template<typename V, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &a, P const &b) { a = V::add(a, b); }
+        };
+
+        struct Minus {
+            template<typename T>
+            static T apply(T a, T b) { return a - b; }
+            template<typename V, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &a, P const &b) { a = V::sub(a, b); }
+        };
+
+        struct Multiplies {
+            template<typename T>
+            static T apply(T a, T b) { return a * b; }
+            template<typename V, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &a, P const &b) { a = V::mul(a, b); }
+        };
+
+        struct Divides {
+            template<typename T>
+            static T apply(T a, T b) { return a / b; }
+            template<typename V, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &a, P const &b) { a = V::div(a, b); }
+        };
+
+        struct Negate {
+            template<typename T>
+            static T apply(T a) { return -a; }
+            template<typename V, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &a) { a = V::sub(V::zero(), a); }
+        };
+
+        // a scalar seen as a row x col matrix
+        template<typename T>
+        class Broadcast : public Expression<Broadcast<T> > {
+            T value;
+            std::size_t row, col;
+
+        public:
+            using value_type = T;
+
+            Broadcast(T value, std::size_t row, std::size_t col) : value(value), row(row), col(col) {}
+
+            T operator()(std::size_t, std::size_t) const {
+                return value;
+            }
+
+            static constexpr bool vectorizable = true;
+
+            template<Kernels::Isa isa>
+            BNN_ALWAYS_INLINE void packet(std::size_t, std::size_t, typename Kernels::Vec<T, isa>::type &out) const {
+                out = Kernels::Vec<T, isa>::set1(value);
+            }
+
+            std::size_t get_row() const {
+                return row;
+            }
+            std::size_t get_col() const {
+                return col;
+            }
+        };
+
+        template<typename Op, typename E>
+        class Unary : public Expression<Unary<Op, E> > {
+            E operand;
+
+        public:
+            using value_type = value_t<E>;
+
+            template<typename X>
+            explicit Unary(X &&x) : operand(std::forward<X>(x)) {}
+
+            value_type operator()(std::size_t r, std::size_t c) const {
+                return Op::apply(operand(r, c));
+            }
+
+            static constexpr bool vectorizable = is_vectorizable_v<E>;
+
+            template<Kernels::Isa isa>
+            BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c,
+                                          typename Kernels::Vec<value_type, isa>::type &out) const {
+                operand.template packet<isa>(r, c, out);
+                Op::template packet<Kernels::Vec<value_type, isa> >(out);
+            }
+
+            std::size_t get_row() const {
+                return operand.get_row();
+            }
+            std::size_t get_col() const {
+                return operand.get_col();
+            }
+        };
+
+        template<typename Op, typename L, typename R>
+        class Binary : public Expression<Binary<Op, L, R> > {
+            L lhs;
+            R rhs;
+
+        public:
+            using value_type = value_t<L>;
+
+            template<typename X, typename Y>
+            Binary(X &&x, Y &&y) : lhs(std::forward<X>(x)), rhs(std::forward<Y>(y)) {
+                assert(lhs.get_row() == rhs.get_row() && lhs.get_col() == rhs.get_col());
+            }
+
+            value_type operator()(std::size_t r, std::size_t c) const {
+                return Op::apply(lhs(r, c), rhs(r, c));
+            }
+
+            static constexpr bool vectorizable = is_vectorizable_v<L> && is_vectorizable_v<R>;
+
+            template<Kernels::Isa isa>
+            BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c,
+                                          typename Kernels::Vec<value_type, isa>::type &out) const {
+                typename Kernels::Vec<value_type, isa>::type other;
+                lhs.template packet<isa>(r, c, out);
+                rhs.template packet<isa>(r, c, other);
+                Op::template packet<Kernels::Vec<value_type, isa> >(out, other);
+            }
+
+            std::size_t get_row() const {
+                return lhs.get_row();
+            }
+            std::size_t get_col() const {
+                return lhs.get_col();
+            }
+        };
+
+        // op(operand(r, c)) for an Operators::UnaryOperator op
+        template<typename Op, typename E>
+        class Map : public Expression<Map<Op, E> > {
+            Op op;
+            E operand;
+
+        public:
+            using value_type = value_t<E>;
+
+            template<typename X>
+            Map(Op const &op, X &&x) : op(op), operand(std::forward<X>(x)) {}
+
+            value_type operator()(std::size_t r, std::size_t c) const {
+                return static_cast<value_type>(op(operand(r, c)));
+            }
+
+            static constexpr bool vectorizable = Op::vectorizable && is_vectorizable_v<E>;
+
+            template<Kernels::Isa isa>
+            BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c,
+                                          typename Kernels::Vec<value_type, isa>::type &out) const {
+                operand.template packet<isa>(r, c, out);
+                op.template packet<Kernels::Vec<value_type, isa> >(out);
+            }
+
+            std::size_t get_row() const {
+                return operand.get_row();
+            }
+            std::size_t get_col() const {
+                return operand.get_col();
+            }
+        };
+
+        // op(lhs(r, c), rhs(r, c)) for an Operators::BinomialOperator op
+        template<typename Op, typename L, typename R>
+        class Zip : public Expression<Zip<Op, L, R> > {
+            Op op;
+            L lhs;
+            R rhs;
+
+        public:
+            using value_type = value_t<L>;
+
+            template<typename X, typename Y>
+            Zip(Op const &op, X &&x, Y &&y) : op(op), lhs(std::forward<X>(x)), rhs(std::forward<Y>(y)) {
+                assert(lhs.get_row() == rhs.get_row() && lhs.get_col() == rhs.get_col());
+            }
+
+            value_type operator()(std::size_t r, std::size_t c) const {
+                return static_cast<value_type>(op(lhs(r, c), rhs(r, c)));
+            }
+
+            static constexpr bool vectorizable = Op::vectorizable && is_vectorizable_v<L> && is_vectorizable_v<R>;
+
+            template<Kernels::Isa isa>
+            BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c,
+                                          typename Kernels::Vec<value_type, isa>::type &out) const {
+                typename Kernels::Vec<value_type, isa>::type other;
+                lhs.template packet<isa>(r, c, out);
+                rhs.template packet<isa>(r, c, other);
+                op.template packet<Kernels::Vec<value_type, isa> >(out, other);
+            }
+
+            std::size_t get_row() const {
+                return lhs.get_row();
+            }
+            std::size_t get_col() const {
+                return lhs.get_col();
+            }
+        };
+
+        template<typename Op, typename L, typename R>
+        auto make_binary(L &&lhs, R &&rhs) {
+            return Binary<Op, operand_t<L>, operand_t<R> >(std::forward<L>(lhs), std::forward<R>(rhs));
+        }
+
+        template<typename L>
+        auto broadcast_like(L const &lhs, value_t<L> const &value) {
+            return Broadcast<value_t<L> >(value, lhs.get_row(), lhs.get_col());
+        }
+
+    }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    template<typename X>
+    using enable_if_expression_t = std::enable_if_t<is_expression_v<X>, int>;
+
+    template<typename X, typename Y>
+    using enable_if_expressions_t = std::enable_if_t<is_expression_v<X> && is_expression_v<Y>, int>;
+
+    // operators
+    template<typename E, enable_if_expression_t<E> = 0>
+    auto operator-(E &&e) {
+        return Expressions::Unary<Expressions::Negate, Expressions::operand_t<E> >(std::forward<E>(e));
+    }
+
+    template<typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto operator+(L &&lhs, R &&rhs) {
+        return Expressions::make_binary<Expressions::Plus>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<typename L, enable_if_expression_t<L> = 0>
+    auto operator+(L &&lhs, value_t<L> const &b) {
+        return Expressions::make_binary<Expressions::Plus>(std::forward<L>(lhs), Expressions::broadcast_like(lhs, b));
+    }
+
+    template<typename R, enable_if_expression_t<R> = 0>
+    auto operator+(value_t<R> const &a, R &&rhs) {
+        return Expressions::make_binary<Expressions::Plus>(Expressions::broadcast_like(rhs, a), std::forward<R>(rhs));
+    }
+
+    template<typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto operator-(L &&lhs, R &&rhs) {
+        return Expressions::make_binary<Expressions::Minus>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<typename L, enable_if_expression_t<L> = 0>
+    auto operator-(L &&lhs, value_t<L> const &b) {
+        return Expressions::make_binary<Expressions::Minus>(std::forward<L>(lhs), Expressions::broadcast_like(lhs, b));
+    }
+
+    template<typename R, enable_if_expression_t<R> = 0>
+    auto operator-(value_t<R> const &a, R &&rhs) {
+        return Expressions::make_binary<Expressions::Minus>(Expressions::broadcast_like(rhs, a), std::forward<R>(rhs));
+    }
+
+    template<typename L, enable_if_expression_t<L> = 0>
+    auto operator*(L &&lhs, value_t<L> const &b) {
+        return Expressions::make_binary<Expressions::Multiplies>(std::forward<L>(lhs), Expressions::broadcast_like(lhs, b));
+    }
+
+    template<typename R, enable_if_expression_t<R> = 0>
+    auto operator*(value_t<R> const &a, R &&rhs) {
+        return Expressions::make_binary<Expressions::Multiplies>(Expressions::broadcast_like(rhs, a), std::forward<R>(rhs));
+    }
+
+    template<typename L, enable_if_expression_t<L> = 0>
+    auto operator/(L &&lhs, value_t<L> const &b) {
+        return Expressions::make_binary<Expressions::Divides>(std::forward<L>(lhs), Expressions::broadcast_like(lhs, b));
+    }
+
+    // basic operations only for matrix
+    template<typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto elementwise_multiplied(L &&lhs, R &&rhs) {
+        return Expressions::make_binary<Expressions::Multiplies>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    template<typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto elementwise_divided(L &&lhs, R &&rhs) {
+        return Expressions::make_binary<Expressions::Divides>(std::forward<L>(lhs), std::forward<R>(rhs));
+    }
+
+    // op applied to every element, as one more node of the fused loop
+    template<typename Op, typename E, enable_if_expression_t<E> = 0>
+    auto map(Op const &op, E &&e) {
+        static_assert(Op::arity == 1, "In map: the operator must be unary!");
+        return Expressions::Map<Op, Expressions::operand_t<E> >(op, std::forward<E>(e));
+    }
+
+    template<typename Op, typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto zip(Op const &op, L &&lhs, R &&rhs) {
+        static_assert(Op::arity == 2, "In zip: the operator must be binomial!");
+        return Expressions::Zip<Op, Expressions::operand_t<L>, Expressions::operand_t<R> >(op, std::forward<L>(lhs),
+                                                                                        std::forward<R>(rhs));
+    }
+
+}
+
+#endif
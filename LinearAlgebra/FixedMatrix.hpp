@@ -0,0 +1,229 @@
+#ifndef BNN_LinearAlgebra_FixedMatrix_hpp
+#define BNN_LinearAlgebra_FixedMatrix_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include "Matrix.hpp"
+
+/*
+ * Matrix<T, R, C>: size known at compile time, elements stored inline.
+ * No heap, no vtable and no virtual calls; loops have constant bounds so the compiler
+ * unrolls them. It takes part in expressions like any Matrix, converts to and from Matrix<T>
+ * (the dynamic side is checked at run time), and hands out views for the BLAS-style products.
+ */
+
+namespace LinearAlgebra {
+
+    template<typename T, std::size_t R, std::size_t C>
+    class Matrix : public Expression<Matrix<T, R, C> > {
+        static_assert(R != Dynamic && C != Dynamic, "In Matrix: either both or no dimension is Dynamic!");
+        static_assert(R != 0 && C != 0, "In Matrix: fixed dimensions must be positive!");
+
+        // row-major, no padding
+        T mat[R * C];
+
+        template<typename E>
+        void evaluate(Expression<E> const &expression) {
+            E const &e = expression.self();
+            assert(e.get_row() == R && e.get_col() == C);
+            for (std::size_t i = 0; i < R; i++) {
+                for (std::size_t j = 0; j < C; j++) {
+                    mat[i * C + j] = e(i, j);
+                }
+            }
+        }
+
+    public:
+        using value_type = T;
+        static constexpr std::size_t rows = R, cols = C;
+
+        // constructors; the default one leaves the elements uninitialized
+        Matrix() = default;
+
+        Matrix(std::random_device &rd, T mean = 0, T stdv = 1) {
+            std::default_random_engine e1(rd());
+            std::normal_distribution<T> normal_dist(mean, stdv);
+            for (std::size_t i = 0; i < R * C; i++) {
+                mat[i] = static_cast<T>(normal_dist(e1));
+            }
+        }
+
+        explicit Matrix(T constant) {
+            fill(constant);
+        }
+
+        explicit Matrix(T const *arr) {
+            std::copy(arr, arr + R * C, mat);
+        }
+
+        static Matrix Constant(T constant) {
+            return Matrix(constant);
+        }
+        static Matrix Zeros() {
+            return Constant(static_cast<T>(0));
+        }
+        static Matrix Ones() {
+            return Constant(static_cast<T>(1));
+        }
+
+        // from any expression of the same shape, including a dynamic Matrix<T>
+        template<typename E>
+        Matrix(Expression<E> const &expression) {
+            evaluate(expression);
+        }
+
+        template<typename E>
+        Matrix &operator=(Expression<E> const &expression) {
+            evaluate(expression);
+            return *this;
+        }
+
+        // operators; elementwise ones live in Expression.hpp
+        template<typename E>
+        Matrix &operator+=(Expression<E> const &A) {
+            return *this = *this + A.self();
+        }
+
+        Matrix &operator+=(T const &a) {
+            return *this = *this + a;
+        }
+
+        template<typename E>
+        Matrix &operator-=(Expression<E> const &A) {
+            return *this = *this - A.self();
+        }
+
+        Matrix &operator-=(T const &a) {
+            return *this = *this - a;
+        }
+
+        template<std::size_t N = C, std::enable_if_t<N == R, int> = 0>
+        Matrix &operator*=(Matrix const &A) {
+            return *this = *this * A;
+        }
+
+        Matrix &operator*=(T const &a) {
+            return *this = *this * a;
+        }
+
+        Matrix &operator/=(T const &a) {
+            return *this = *this / a;
+        }
+
+        template<typename E>
+        Matrix &elementwise_multiply(Expression<E> const &A) {
+            return *this = elementwise_multiplied(*this, A.self());
+        }
+
+        Matrix<T, C, R> transposed() const {
+            Matrix<T, C, R> M;
+            for (std::size_t i = 0; i < R; i++) {
+                for (std::size_t j = 0; j < C; j++) {
+                    M(j, i) = mat[i * C + j];
+                }
+            }
+            return M;
+        }
+
+        // get max and min element
+        T get_max() const {
+            return *std::max_element(mat, mat + R * C);
+        }
+        T get_min() const {
+            return *std::min_element(mat, mat + R * C);
+        }
+
+        // index
+        T const &operator()(std::size_t r, std::size_t c) const {
+            return mat[r * C + c];
+        }
+        T &operator()(std::size_t r, std::size_t c) {
+            return mat[r * C + c];
+        }
+
+        static constexpr bool vectorizable = true;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+        template<Kernels::Isa isa>
+        BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c, typename Kernels::Vec<T, isa>::type &out) const {
+            out = Kernels::Vec<T, isa>::load(mat + r * C + c);
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        // out stream operator
+        friend std::ostream &operator<<(std::ostream &os, Matrix const &matrix) {
+            for (std::size_t i = 0; i < R; i++) {
+                for (std::size_t j = 0; j < C; j++) {
+                    os << matrix.mat[i * C + j] << ' ';
+                }
+                os << '\n';
+            }
+            return os;
+        }
+
+        void fill(T const &value) {
+            std::fill(mat, mat + R * C, value);
+        }
+
+        // raw row-major storage
+        T *data() {
+            return mat;
+        }
+        T const *data() const {
+            return mat;
+        }
+
+        // non-owning views, for gemm/gemv/ger and slicing
+        MatrixView<T> view() {
+            return MatrixView<T>(mat, R, C);
+        }
+        MatrixView<T const> view() const {
+            return MatrixView<T const>(mat, R, C);
+        }
+        operator MatrixView<T>() {
+            return view();
+        }
+        operator MatrixView<T const>() const {
+            return view();
+        }
+
+        static constexpr std::size_t get_row() {
+            return R;
+        }
+        static constexpr std::size_t get_col() {
+            return C;
+        }
+        static constexpr std::size_t get_ld() {
+            return C;
+        }
+    };
+
+    // fixed-size product, unrolled for small shapes and packed GEMM beyond that
+    template<typename T, std::size_t R, std::size_t K, std::size_t C>
+    Matrix<T, R, C> operator*(Matrix<T, R, K> const &A, Matrix<T, K, C> const &B) {
+        auto M = Matrix<T, R, C>::Zeros();
+        if constexpr (R * K * C < Kernels::detail::gemm_scalar_cutoff) {
+            for (std::size_t i = 0; i < R; i++) {
+                for (std::size_t k = 0; k < K; k++) {
+                    T const a = A(i, k);
+                    for (std::size_t j = 0; j < C; j++) {
+                        M(i, j) += a * B(k, j);
+                    }
+                }
+            }
+        } else {
+            Kernels::gemm(R, C, K, A.data(), K, B.data(), C, M.data(), C);
+        }
+        return M;
+    }
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef BNN_LinearAlgebra_FlatBuffer_hpp
+#define BNN_LinearAlgebra_FlatBuffer_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Half.hpp"
+#include "Matrix.hpp"
+#include "Kernels/Convert.hpp"
+
+namespace LinearAlgebra {
+
+    /*
+     * A fixed set of matrices laid out back to back in one 64-byte aligned allocation.
+     * Each one starts on a cache line and has the rows of a Matrix of its shape; view(i) hands it out.
+     * The gaps and row padding are zero and stay zero under elementwise updates, so buffers with the
+     * same shapes can be updated, zeroed, averaged or saved as one linear pass over data()[0, size()),
+     * element k of one matching element k of the others.
+     */
+    template<typename T>
+    class FlatBuffer {
+        struct Slot {
+            std::size_t offset, row, col, ld;
+        };
+
+        // 1 x size row, zeroed on construction
+        Matrix<T> storage;
+        std::vector<Slot> slots;
+        std::size_t length;
+
+    public:
+        FlatBuffer() : length(0) {}
+
+        // shapes are (rows, cols) pairs
+        explicit FlatBuffer(std::vector<std::pair<std::size_t, std::size_t> > const &shapes) : length(0) {
+            constexpr std::size_t line = sizeof(T) < storage_alignment ? storage_alignment / sizeof(T) : 1;
+            slots.reserve(shapes.size());
+            for (auto const &shape : shapes) {
+                std::size_t const ld = Matrix<T>::padded(shape.second);
+                slots.push_back({length, shape.first, shape.second, ld});
+                length += (shape.first * ld + line - 1) / line * line;
+            }
+            storage = Matrix<T>::Zeros(1, length == 0 ? 1 : length);
+        }
+
+        // same layout, all zeros
+        static FlatBuffer zeros_like(FlatBuffer const &buffer) {
+            FlatBuffer ret;
+            ret.slots = buffer.slots;
+            ret.length = buffer.length;
+            ret.storage = Matrix<T>::Zeros(1, buffer.length == 0 ? 1 : buffer.length);
+            return ret;
+        }
+
+        // true when element k of both buffers belongs to the same matrix element
+        bool same_layout(FlatBuffer const &buffer) const {
+            if (length != buffer.length || slots.size() != buffer.slots.size()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < slots.size(); i++) {
+                if (slots[i].offset != buffer.slots[i].offset || slots[i].row != buffer.slots[i].row ||
+                    slots[i].col != buffer.slots[i].col) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        MatrixView<T> view(std::size_t i) {
+            assert(i < slots.size());
+            Slot const &s = slots[i];
+            return MatrixView<T>(storage.data() + s.offset, s.row, s.col, s.ld);
+        }
+        MatrixView<T const> view(std::size_t i) const {
+            assert(i < slots.size());
+            Slot const &s = slots[i];
+            return MatrixView<T const>(storage.data() + s.offset, s.row, s.col, s.ld);
+        }
+
+        // the whole buffer as a 1 x size() row, for linear passes through the usual kernels
+        MatrixView<T> flat() {
+            return MatrixView<T>(storage.data(), 1, length);
+        }
+        MatrixView<T const> flat() const {
+            return MatrixView<T const>(storage.data(), 1, length);
+        }
+
+        void zero() {
+            std::fill(storage.data(), storage.data() + length, static_cast<T>(0));
+        }
+
+        void copy_from(FlatBuffer const &buffer) {
+            assert(same_layout(buffer));
+            std::copy(buffer.data(), buffer.data() + length, storage.data());
+        }
+
+        T *data() {
+            return storage.data();
+        }
+        T const *data() const {
+            return storage.data();
+        }
+
+        // number of elements, padding included
+        std::size_t size() const {
+            return length;
+        }
+        // number of matrices
+        std::size_t count() const {
+            return slots.size();
+        }
+    };
+
+    /*
+     * The contents of a FlatBuffer in another scalar type, bfloat16 or float16 for a float buffer,
+     * element k for element k: refreshing it is one conversion pass, and view(i) has the shape and
+     * leading dimension of the source's view(i).
+     */
+    template<typename S>
+    class FlatCopy {
+        struct Slot {
+            std::size_t offset, row, col, ld;
+        };
+
+        std::vector<S> storage;
+        std::vector<Slot> slots;
+
+    public:
+        FlatCopy() = default;
+
+        template<typename T>
+        explicit FlatCopy(FlatBuffer<T> const &source) : storage(source.size()) {
+            for (std::size_t i = 0; i < source.count(); i++) {
+                MatrixView<T const> const view = source.view(i);
+                slots.push_back({static_cast<std::size_t>(view.data() - source.data()),
+                                 view.get_row(), view.get_col(), view.get_ld()});
+            }
+            copy_from(source);
+        }
+
+        template<typename T>
+        void copy_from(FlatBuffer<T> const &source) {
+            assert(source.size() == storage.size());
+            Kernels::convert(storage.size(), source.data(), storage.data());
+        }
+
+        MatrixView<S const> view(std::size_t i) const {
+            assert(i < slots.size());
+            Slot const &s = slots[i];
+            return MatrixView<S const>(storage.data() + s.offset, s.row, s.col, s.ld);
+        }
+
+        S const *data() const {
+            return storage.data();
+        }
+        std::size_t size() const {
+            return storage.size();
+        }
+    };
+
+}
+
+#endif
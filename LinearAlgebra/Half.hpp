@@ -0,0 +1,109 @@
+#ifndef BNN_LinearAlgebra_Half_hpp
+#define BNN_LinearAlgebra_Half_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * 16-bit storage formats. They only hold values: arithmetic happens in float, which both convert
+ * to and from implicitly, rounding to nearest even.
+ * bfloat16 keeps the exponent range of float with 8 bits of precision; float16 (IEEE half) has
+ * 11 bits of precision but overflows above 65504.
+ */
+
+namespace LinearAlgebra {
+
+    namespace detail {
+
+        inline std::uint32_t float_bits(float f) {
+            std::uint32_t ret;
+            std::memcpy(&ret, &f, sizeof(ret));
+            return ret;
+        }
+
+        inline float bits_float(std::uint32_t u) {
+            float ret;
+            std::memcpy(&ret, &u, sizeof(ret));
+            return ret;
+        }
+
+        inline std::uint16_t float_to_bfloat16(float f) {
+            std::uint32_t const x = float_bits(f);
+            if ((x & 0x7fffffffu) > 0x7f800000u) {
+                // quiet NaN, keeping the sign
+                return static_cast<std::uint16_t>(x >> 16 | 0x40u);
+            }
+            return static_cast<std::uint16_t>((x + 0x7fffu + (x >> 16 & 1u)) >> 16);
+        }
+
+        inline float bfloat16_to_float(std::uint16_t h) {
+            return bits_float(std::uint32_t(h) << 16);
+        }
+
+        inline std::uint16_t float_to_float16(float f) {
+            std::uint32_t x = float_bits(f);
+            std::uint32_t const sign = x >> 16 & 0x8000u;
+            x &= 0x7fffffffu;
+            if (x >= 0x7f800000u) {
+                // infinity, or a quiet NaN
+                return static_cast<std::uint16_t>(sign | 0x7c00u | (x > 0x7f800000u ? 0x200u : 0u));
+            }
+            if (x >= 0x477ff000u) {
+                // rounds past 65504
+                return static_cast<std::uint16_t>(sign | 0x7c00u);
+            }
+            if (x < 0x38800000u) {
+                // subnormal or zero: adding 0.5 lines the half's mantissa up with the float's, rounding it
+                return static_cast<std::uint16_t>(sign | (float_bits(bits_float(x) + 0.5f) - 0x3f000000u));
+            }
+            // rebias the exponent from 127 to 15 and round to nearest even on the 13 dropped bits
+            x += 0xc8000fffu + (x >> 13 & 1u);
+            return static_cast<std::uint16_t>(sign | x >> 13);
+        }
+
+        inline float float16_to_float(std::uint16_t h) {
+            std::uint32_t const sign = std::uint32_t(h & 0x8000u) << 16;
+            std::uint32_t x = std::uint32_t(h & 0x7fffu) << 13;
+            std::uint32_t const exponent = x & 0x0f800000u;
+            x += (127u - 15u) << 23;
+            if (exponent == 0x0f800000u) {
+                // infinity or NaN
+                x += (128u - 16u) << 23;
+            } else if (exponent == 0) {
+                // subnormal: renormalize through a float subtraction
+                x = float_bits(bits_float(x + (1u << 23)) - bits_float(113u << 23));
+            }
+            return bits_float(x | sign);
+        }
+
+    }
+
+    struct bfloat16 {
+        std::uint16_t bits;
+
+        bfloat16() = default;
+        bfloat16(float f) : bits(detail::float_to_bfloat16(f)) {}
+
+        operator float() const {
+            return detail::bfloat16_to_float(bits);
+        }
+    };
+
+    struct float16 {
+        std::uint16_t bits;
+
+        float16() = default;
+        float16(float f) : bits(detail::float_to_float16(f)) {}
+
+        operator float() const {
+            return detail::float16_to_float(bits);
+        }
+    };
+
+    template<typename T>
+    constexpr bool is_half_v = std::is_same_v<T, bfloat16> || std::is_same_v<T, float16>;
+
+}
+
+#endif
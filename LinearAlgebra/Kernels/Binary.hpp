@@ -0,0 +1,170 @@
+#ifndef BNN_LinearAlgebra_Kernels_Binary_hpp
+#define BNN_LinearAlgebra_Kernels_Binary_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "Simd.hpp"
+#include "../ThreadPool.hpp"
+
+/*
+ * Products with sign matrices stored 64 signs to a word, a set bit for +1 and a clear one for -1.
+ * Two rows of k signs agree in all but popcount(a ^ b) places, so their dot product is
+ * k - 2 * popcount(a ^ b): a whole word of multiply-adds in one xor and one popcount. The bits past k
+ * are clear in every row and never differ.
+ * Every output row i is scaled by scale[i], the magnitude the signs stand in for.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    // below this many word (or multiply-add) operations the products stay on the calling thread
+    inline constexpr std::size_t binary_parallel_cutoff = 1 << 18;
+
+    namespace detail {
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // one instruction inside the popcnt targets of run_avx2 and run_avx512
+        BNN_ALWAYS_INLINE std::size_t popcount(std::uint64_t x) {
+            return static_cast<std::size_t>(__builtin_popcountll(x));
+        }
+
+        // dot product of two rows of k signs that differ in differ places
+        template<typename T>
+        BNN_ALWAYS_INLINE T sign_dot(std::size_t k, std::size_t differ) {
+            return static_cast<T>(static_cast<std::ptrdiff_t>(k) - 2 * static_cast<std::ptrdiff_t>(differ));
+        }
+
+        // C(m x n) = diag(scale) * A * B^T for the sign rows of A (m of them) and B (n of them),
+        // each k signs in words words
+        struct XnorGemmKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, std::size_t k, std::size_t words,
+                                              std::uint64_t const *A, std::uint64_t const *B, T const *scale,
+                                              T *C, std::size_t ldc) {
+                for (std::size_t i = 0; i < m; i++) {
+                    std::uint64_t const *a = A + i * words;
+                    T *c = C + i * ldc;
+                    std::size_t j = 0;
+                    // four rows of B at a time, so each word of a feeds four popcounts
+                    for (; j + 4 <= n; j += 4) {
+                        std::uint64_t const *b = B + j * words;
+                        std::size_t d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+                        for (std::size_t w = 0; w < words; w++) {
+                            d0 += popcount(a[w] ^ b[w]);
+                            d1 += popcount(a[w] ^ b[words + w]);
+                            d2 += popcount(a[w] ^ b[2 * words + w]);
+                            d3 += popcount(a[w] ^ b[3 * words + w]);
+                        }
+                        c[j] = scale[i] * sign_dot<T>(k, d0);
+                        c[j + 1] = scale[i] * sign_dot<T>(k, d1);
+                        c[j + 2] = scale[i] * sign_dot<T>(k, d2);
+                        c[j + 3] = scale[i] * sign_dot<T>(k, d3);
+                    }
+                    for (; j < n; j++) {
+                        std::uint64_t const *b = B + j * words;
+                        std::size_t d = 0;
+                        for (std::size_t w = 0; w < words; w++) {
+                            d += popcount(a[w] ^ b[w]);
+                        }
+                        c[j] = scale[i] * sign_dot<T>(k, d);
+                    }
+                }
+            }
+        };
+
+        // C(m x n) = diag(scale) * A * B for the sign rows of A (m of them, k signs in words words each)
+        // and a real B(k x n): every product is an add or a subtract
+        struct SignGemmKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, std::size_t k, std::size_t words,
+                                              std::uint64_t const *A, T const *scale, T const *B, std::size_t ldb,
+                                              T *C, std::size_t ldc) {
+                std::size_t j = 0;
+#if BNN_X86
+                if constexpr (isa != Isa::Scalar) {
+                    using V = Vec<T, isa>;
+                    constexpr std::size_t W = V::width;
+                    // a panel of 4 W columns of B is read by every row of A while it is in cache
+                    for (; j + 4 * W <= n; j += 4 * W) {
+                        for (std::size_t i = 0; i < m; i++) {
+                            std::uint64_t const *a = A + i * words;
+                            typename V::type c0 = V::zero(), c1 = V::zero(), c2 = V::zero(), c3 = V::zero();
+                            for (std::size_t p = 0; p < k; p++) {
+                                typename V::type const s = V::set1(a[p / 64] >> p % 64 & 1 ? T(1) : T(-1));
+                                T const *b = B + p * ldb + j;
+                                c0 = V::fmadd(s, V::load(b), c0);
+                                c1 = V::fmadd(s, V::load(b + W), c1);
+                                c2 = V::fmadd(s, V::load(b + 2 * W), c2);
+                                c3 = V::fmadd(s, V::load(b + 3 * W), c3);
+                            }
+                            typename V::type const f = V::set1(scale[i]);
+                            T *c = C + i * ldc + j;
+                            V::store(c, V::mul(f, c0));
+                            V::store(c + W, V::mul(f, c1));
+                            V::store(c + 2 * W, V::mul(f, c2));
+                            V::store(c + 3 * W, V::mul(f, c3));
+                        }
+                    }
+                }
+#endif
+                for (std::size_t i = 0; i < m; i++) {
+                    std::uint64_t const *a = A + i * words;
+                    T *c = C + i * ldc;
+                    std::fill(c + j, c + n, static_cast<T>(0));
+                    for (std::size_t p = 0; p < k; p++) {
+                        T const s = a[p / 64] >> p % 64 & 1 ? T(1) : T(-1);
+                        T const *b = B + p * ldb;
+                        for (std::size_t jj = j; jj < n; jj++) {
+                            c[jj] += s * b[jj];
+                        }
+                    }
+                    for (std::size_t jj = j; jj < n; jj++) {
+                        c[jj] *= scale[i];
+                    }
+                }
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // C(m x n) = diag(scale) * A * B^T, where A holds m and B n rows of k signs, words words apart
+    template<typename T>
+    void xnor_gemm(std::size_t m, std::size_t n, std::size_t k, std::size_t words,
+                   std::uint64_t const *A, std::uint64_t const *B, T const *scale, T *C, std::size_t ldc) {
+        if (m * n * words < 2 * binary_parallel_cutoff || ThreadPool::instance().size() == 1) {
+            dispatch<detail::XnorGemmKernel, T>(m, n, k, words, A, B, scale, C, ldc);
+            return;
+        }
+        std::size_t const grain = binary_parallel_cutoff / (n * words) + 1;
+        parallel_for(m, grain, [&](std::size_t begin, std::size_t end) {
+            dispatch<detail::XnorGemmKernel, T>(end - begin, n, k, words, A + begin * words, B, scale + begin,
+                                                C + begin * ldc, ldc);
+        });
+    }
+
+    // C(m x n) = diag(scale) * A * B, where A holds m rows of k signs, words words apart, and B is real
+    template<typename T>
+    void sign_gemm(std::size_t m, std::size_t n, std::size_t k, std::size_t words, std::uint64_t const *A,
+                   T const *scale, T const *B, std::size_t ldb, T *C, std::size_t ldc) {
+        if (m * n * k < 2 * binary_parallel_cutoff || ThreadPool::instance().size() == 1) {
+            dispatch<detail::SignGemmKernel, T>(m, n, k, words, A, scale, B, ldb, C, ldc);
+            return;
+        }
+        std::size_t const grain = binary_parallel_cutoff / (n * k) + 1;
+        parallel_for(m, grain, [&](std::size_t begin, std::size_t end) {
+            dispatch<detail::SignGemmKernel, T>(end - begin, n, k, words, A + begin * words, scale + begin, B, ldb,
+                                                C + begin * ldc, ldc);
+        });
+    }
+
+}
+
+#endif
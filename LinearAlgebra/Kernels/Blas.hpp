@@ -0,0 +1,166 @@
+#ifndef BNN_LinearAlgebra_Kernels_Blas_hpp
+#define BNN_LinearAlgebra_Kernels_Blas_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include "Simd.hpp"
+#include "Gemm.hpp"
+#include "../Profiler.hpp"
+
+/*
+ * Level 1/2 routines on contiguous, row-major storage.
+ * gemv and ger read A in its stored layout whatever the transpose flag says,
+ * so no transposed copy is ever made.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // sum x[i] * y[i]
+        template<Isa isa, typename T>
+        BNN_ALWAYS_INLINE T dot(std::size_t n, T const *BNN_RESTRICT x, T const *BNN_RESTRICT y) {
+            std::size_t i = 0;
+            T ret = 0;
+#if BNN_X86
+            if constexpr (isa != Isa::Scalar) {
+                using V = Vec<T, isa>;
+                constexpr std::size_t W = V::width;
+                typename V::type a0 = V::zero(), a1 = V::zero(), a2 = V::zero(), a3 = V::zero();
+                for (; i + 4 * W <= n; i += 4 * W) {
+                    a0 = V::fmadd(V::load(x + i), V::load(y + i), a0);
+                    a1 = V::fmadd(V::load(x + i + W), V::load(y + i + W), a1);
+                    a2 = V::fmadd(V::load(x + i + 2 * W), V::load(y + i + 2 * W), a2);
+                    a3 = V::fmadd(V::load(x + i + 3 * W), V::load(y + i + 3 * W), a3);
+                }
+                for (; i + W <= n; i += W) {
+                    a0 = V::fmadd(V::load(x + i), V::load(y + i), a0);
+                }
+                alignas(64) T lanes[W];
+                V::store(lanes, V::add(V::add(a0, a1), V::add(a2, a3)));
+                for (std::size_t l = 0; l < W; l++) {
+                    ret += lanes[l];
+                }
+            }
+#endif
+            for (; i < n; i++) {
+                ret += x[i] * y[i];
+            }
+            return ret;
+        }
+
+        // y += alpha * x
+        template<Isa isa, typename T>
+        BNN_ALWAYS_INLINE void axpy(std::size_t n, T alpha, T const *BNN_RESTRICT x, T *BNN_RESTRICT y) {
+            std::size_t i = 0;
+#if BNN_X86
+            if constexpr (isa != Isa::Scalar) {
+                using V = Vec<T, isa>;
+                constexpr std::size_t W = V::width;
+                typename V::type const a = V::set1(alpha);
+                for (; i + 2 * W <= n; i += 2 * W) {
+                    V::store(y + i, V::fmadd(a, V::load(x + i), V::load(y + i)));
+                    V::store(y + i + W, V::fmadd(a, V::load(x + i + W), V::load(y + i + W)));
+                }
+                for (; i + W <= n; i += W) {
+                    V::store(y + i, V::fmadd(a, V::load(x + i), V::load(y + i)));
+                }
+            }
+#endif
+            for (; i < n; i++) {
+                y[i] += alpha * x[i];
+            }
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        struct DotKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE T run(std::size_t n, T const *x, T const *y) {
+                return dot<isa>(n, x, y);
+            }
+        };
+
+        struct AxpyKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t n, T alpha, T const *x, T *y) {
+                axpy<isa>(n, alpha, x, y);
+            }
+        };
+
+        // y(m) = alpha * A(m x n) * x(n) + beta * y
+        struct GemvNKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, T alpha, T const *A, std::size_t lda,
+                                              T const *x, T beta, T *y) {
+                for (std::size_t i = 0; i < m; i++) {
+                    T const d = alpha * dot<isa>(n, A + i * lda, x);
+                    y[i] = beta == static_cast<T>(0) ? d : beta * y[i] + d;
+                }
+            }
+        };
+
+        // y(n) = alpha * A(m x n)^T * x(m) + beta * y, walking A row by row
+        struct GemvTKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, T alpha, T const *A, std::size_t lda,
+                                              T const *x, T beta, T *y) {
+                scale_rows<T>(1, n, beta, y, n);
+                for (std::size_t i = 0; i < m; i++) {
+                    axpy<isa>(n, alpha * x[i], A + i * lda, y);
+                }
+            }
+        };
+
+        // A(m x n) += alpha * x(m) * y(n)^T
+        struct GerKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, T alpha, T const *x, T const *y,
+                                              T *A, std::size_t lda) {
+                for (std::size_t i = 0; i < m; i++) {
+                    axpy<isa>(n, alpha * x[i], y, A + i * lda);
+                }
+            }
+        };
+
+    }
+
+    template<typename T>
+    T dot(std::size_t n, T const *x, T const *y) {
+        return dispatch<detail::DotKernel, T>(n, x, y);
+    }
+
+    template<typename T>
+    void axpy(std::size_t n, T alpha, T const *x, T *y) {
+        dispatch<detail::AxpyKernel, T>(n, alpha, x, y);
+    }
+
+    // y = alpha * op(A) * x + beta * y, where A is m x n row-major with leading dimension lda
+    template<typename T>
+    void gemv(Transpose transA, std::size_t m, std::size_t n, T alpha, T const *A, std::size_t lda,
+              T const *x, T beta, T *y) {
+        BNN_PROFILE_SCOPE("gemv", -1, 2 * m * n, (m * n + m + n) * sizeof(T));
+        if (transA == Transpose::NoTrans) {
+            dispatch<detail::GemvNKernel, T>(m, n, alpha, A, lda, x, beta, y);
+        } else {
+            dispatch<detail::GemvTKernel, T>(m, n, alpha, A, lda, x, beta, y);
+        }
+    }
+
+    // A += alpha * x * y^T, where A is m x n row-major with leading dimension lda
+    template<typename T>
+    void ger(std::size_t m, std::size_t n, T alpha, T const *x, T const *y, T *A, std::size_t lda) {
+        BNN_PROFILE_SCOPE("ger", -1, 2 * m * n, (2 * m * n + m + n) * sizeof(T));
+        dispatch<detail::GerKernel, T>(m, n, alpha, x, y, A, lda);
+    }
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef BNN_LinearAlgebra_Kernels_Convert_hpp
+#define BNN_LinearAlgebra_Kernels_Convert_hpp
+
+#include <cstddef>
+#include <type_traits>
+#include "Simd.hpp"
+#include "../Half.hpp"
+
+/*
+ * Conversion between float and the 16-bit storage formats, a register at a time.
+ * bfloat16 is the upper half of a float, so widening is a shift and narrowing an integer
+ * round to nearest even; float16 uses the F16C / AVX-512 conversion instructions.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if BNN_X86
+        // the vector part of widen and narrow for one instruction set, returning how many elements
+        // it converted; the intrinsics need the target attribute on the function that holds them
+
+        template<typename S>
+        BNN_TARGET_AVX512 std::size_t widen_avx512(std::size_t n, S const *src, float *dst) {
+            std::size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m256i const h = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+                if constexpr (std::is_same_v<S, bfloat16>) {
+                    _mm512_storeu_ps(dst + i, _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(h), 16)));
+                } else {
+                    _mm512_storeu_ps(dst + i, _mm512_cvtph_ps(h));
+                }
+            }
+            return i;
+        }
+
+        template<typename S>
+        BNN_TARGET_AVX2 std::size_t widen_avx2(std::size_t n, S const *src, float *dst) {
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m128i const h = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+                if constexpr (std::is_same_v<S, bfloat16>) {
+                    _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16)));
+                } else {
+                    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+                }
+            }
+            return i;
+        }
+
+        // SSE2 has no half conversion, so only bfloat16
+        inline std::size_t widen_sse(std::size_t n, bfloat16 const *src, float *dst) {
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i const h = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(src + i));
+                _mm_storeu_ps(dst + i, _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h)));
+            }
+            return i;
+        }
+
+        template<typename S>
+        BNN_TARGET_AVX512 std::size_t narrow_avx512(std::size_t n, float const *src, S *dst) {
+            std::size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m512 const v = _mm512_loadu_ps(src + i);
+                __m256i h;
+                if constexpr (std::is_same_v<S, bfloat16>) {
+                    __m512i const x = _mm512_castps_si512(v);
+                    __m512i const odd = _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(1));
+                    __m512i const rounded = _mm512_srli_epi32(
+                            _mm512_add_epi32(x, _mm512_add_epi32(odd, _mm512_set1_epi32(0x7fff))), 16);
+                    __m512i const nan = _mm512_or_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(0x40));
+                    h = _mm512_cvtepi32_epi16(_mm512_mask_blend_epi32(_mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q),
+                                                                      rounded, nan));
+                } else {
+                    h = _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), h);
+            }
+            return i;
+        }
+
+        template<typename S>
+        BNN_TARGET_AVX2 std::size_t narrow_avx2(std::size_t n, float const *src, S *dst) {
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256 const v = _mm256_loadu_ps(src + i);
+                __m128i h;
+                if constexpr (std::is_same_v<S, bfloat16>) {
+                    __m256i const x = _mm256_castps_si256(v);
+                    __m256i const odd = _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(1));
+                    __m256i const rounded = _mm256_srli_epi32(
+                            _mm256_add_epi32(x, _mm256_add_epi32(odd, _mm256_set1_epi32(0x7fff))), 16);
+                    __m256i const nan = _mm256_or_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x40));
+                    __m256i const r = _mm256_castps_si256(_mm256_blendv_ps(
+                            _mm256_castsi256_ps(rounded), _mm256_castsi256_ps(nan), _mm256_cmp_ps(v, v, _CMP_UNORD_Q)));
+                    // every lane fits 16 bits, so the unsigned saturation never kicks in
+                    h = _mm_packus_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+                } else {
+                    h = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+            }
+            return i;
+        }
+#endif
+
+        // dst[0, n) = src[0, n) as floats
+        template<Isa isa, typename S>
+        BNN_ALWAYS_INLINE void widen(std::size_t n, S const *src, float *dst) {
+            std::size_t i = 0;
+#if BNN_X86
+            if constexpr (isa == Isa::AVX512) {
+                i = widen_avx512(n, src, dst);
+            } else if constexpr (isa == Isa::AVX2) {
+                i = widen_avx2(n, src, dst);
+            } else if constexpr (isa == Isa::SSE && std::is_same_v<S, bfloat16>) {
+                i = widen_sse(n, src, dst);
+            }
+#endif
+            for (; i < n; i++) {
+                dst[i] = src[i];
+            }
+        }
+
+        // dst[0, n) = src[0, n) rounded to S
+        template<Isa isa, typename S>
+        BNN_ALWAYS_INLINE void narrow(std::size_t n, float const *src, S *dst) {
+            std::size_t i = 0;
+#if BNN_X86
+            if constexpr (isa == Isa::AVX512) {
+                i = narrow_avx512(n, src, dst);
+            } else if constexpr (isa == Isa::AVX2) {
+                i = narrow_avx2(n, src, dst);
+            }
+#endif
+            for (; i < n; i++) {
+                dst[i] = src[i];
+            }
+        }
+
+        // dst[0, n) = src[0, n), between float and a 16-bit format either way
+        struct ConvertKernel {
+            template<Isa isa, typename T, typename S, typename D>
+            static BNN_ALWAYS_INLINE void run(std::size_t n, S const *src, D *dst) {
+                if constexpr (std::is_same_v<S, float> && is_half_v<D>) {
+                    narrow<isa>(n, src, dst);
+                } else if constexpr (is_half_v<S> && std::is_same_v<D, float>) {
+                    widen<isa>(n, src, dst);
+                } else {
+                    for (std::size_t i = 0; i < n; i++) {
+                        dst[i] = static_cast<D>(static_cast<float>(src[i]));
+                    }
+                }
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // dst[0, n) = src[0, n), where one side is float and the other bfloat16 or float16
+    template<typename S, typename D>
+    void convert(std::size_t n, S const *src, D *dst) {
+        dispatch<detail::ConvertKernel, float>(n, src, dst);
+    }
+
+}
+
+#endif
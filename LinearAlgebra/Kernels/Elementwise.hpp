@@ -0,0 +1,173 @@
+#ifndef BNN_LinearAlgebra_Kernels_Elementwise_hpp
+#define BNN_LinearAlgebra_Kernels_Elementwise_hpp
+
+#include <cstddef>
+#include "Simd.hpp"
+#include "../Expression.hpp"
+#include "../Profiler.hpp"
+#include "../ThreadPool.hpp"
+
+/*
+ * Fused evaluation of elementwise expressions into row-major storage.
+ * Vectorizable trees are computed one register at a time with the dispatched instruction set;
+ * the remainder of each row, and trees with non-vectorizable nodes, go through the scalar path.
+ * Large blocks are split into bands of rows (or of columns, for a single row) on the shared thread pool.
+ * reduce folds an expression with a binomial operator the same way, keeping a register of partial results
+ * per band; the operator must be associative and commutative, as the order of the fold depends on the
+ * instruction set and the number of threads.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // below this many elements evaluation stays on the calling thread; bands are at least this big too
+        constexpr std::size_t elementwise_parallel_cutoff = 1 << 15;
+
+        // dst(i, j) = e(i, j) for rows [i0, i1) and columns [j0, j1) of a block with leading dimension ld
+        struct EvaluateKernel {
+            template<Isa isa, typename T, typename E>
+            static BNN_ALWAYS_INLINE void run(E const *e, std::size_t i0, std::size_t i1, std::size_t j0, std::size_t j1,
+                                              T *dst, std::size_t ld) {
+                for (std::size_t i = i0; i < i1; i++) {
+                    T *d = dst + i * ld;
+                    std::size_t j = j0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar && is_vectorizable_v<E>) {
+                        using V = Vec<T, isa>;
+                        constexpr std::size_t W = V::width;
+                        typename V::type p0, p1;
+                        for (; j + 2 * W <= j1; j += 2 * W) {
+                            e->template packet<isa>(i, j, p0);
+                            e->template packet<isa>(i, j + W, p1);
+                            V::store(d + j, p0);
+                            V::store(d + j + W, p1);
+                        }
+                        for (; j + W <= j1; j += W) {
+                            e->template packet<isa>(i, j, p0);
+                            V::store(d + j, p0);
+                        }
+                    }
+#endif
+                    for (; j < j1; j++) {
+                        d[j] = (*e)(i, j);
+                    }
+                }
+            }
+        };
+
+        // op folded over e(i, j) for rows [i0, i1) and columns [j0, j1), starting from identity
+        struct ReduceKernel {
+            template<Isa isa, typename T, typename Op, typename E>
+            static BNN_ALWAYS_INLINE T run(Op const *op, T identity, E const *e, std::size_t i0, std::size_t i1,
+                                           std::size_t j0, std::size_t j1) {
+                T ret = identity;
+#if BNN_X86
+                if constexpr (isa != Isa::Scalar && Op::vectorizable && is_vectorizable_v<E>) {
+                    using V = Vec<T, isa>;
+                    constexpr std::size_t W = V::width;
+                    if (j1 - j0 >= W) {
+                        // two chains, so that one fold need not wait for the last
+                        typename V::type acc0 = V::set1(identity), acc1 = acc0, p;
+                        for (std::size_t i = i0; i < i1; i++) {
+                            std::size_t j = j0;
+                            for (; j + 2 * W <= j1; j += 2 * W) {
+                                e->template packet<isa>(i, j, p);
+                                op->template packet<V>(acc0, p);
+                                e->template packet<isa>(i, j + W, p);
+                                op->template packet<V>(acc1, p);
+                            }
+                            for (; j + W <= j1; j += W) {
+                                e->template packet<isa>(i, j, p);
+                                op->template packet<V>(acc0, p);
+                            }
+                            for (; j < j1; j++) {
+                                ret = static_cast<T>((*op)(ret, (*e)(i, j)));
+                            }
+                        }
+                        op->template packet<V>(acc0, acc1);
+                        alignas(64) T lanes[W];
+                        V::store(lanes, acc0);
+                        for (std::size_t k = 0; k < W; k++) {
+                            ret = static_cast<T>((*op)(ret, lanes[k]));
+                        }
+                        return ret;
+                    }
+                }
+#endif
+                for (std::size_t i = i0; i < i1; i++) {
+                    for (std::size_t j = j0; j < j1; j++) {
+                        ret = static_cast<T>((*op)(ret, (*e)(i, j)));
+                    }
+                }
+                return ret;
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    template<typename E, typename T>
+    void evaluate(E const &e, std::size_t row, std::size_t col, T *dst, std::size_t ld) {
+        std::size_t const zero = 0;
+        // the operands an expression reads are not known here, only what it writes
+        BNN_PROFILE_SCOPE("elementwise", -1, 0, row * col * sizeof(T));
+        if (row * col < 2 * detail::elementwise_parallel_cutoff || ThreadPool::instance().size() == 1) {
+            dispatch<detail::EvaluateKernel, T>(&e, zero, row, zero, col, dst, ld);
+        } else if (row > 1) {
+            std::size_t const grain = (detail::elementwise_parallel_cutoff + col - 1) / col;
+            parallel_for(row, grain, [&](std::size_t begin, std::size_t end) {
+                dispatch<detail::EvaluateKernel, T>(&e, begin, end, zero, col, dst, ld);
+            });
+        } else {
+            // bands a multiple of 64 elements wide, so each starts on its own cache line
+            std::size_t const line = 64;
+            parallel_for(col / line, detail::elementwise_parallel_cutoff / line, [&](std::size_t begin, std::size_t end) {
+                dispatch<detail::EvaluateKernel, T>(&e, zero, row, begin * line, end == col / line ? col : end * line,
+                                                    dst, ld);
+            });
+        }
+    }
+
+    // op folded over the row x col elements of e, split like evaluate
+    template<typename Op, typename E, typename T>
+    T reduce(Op const &op, T identity, E const &e, std::size_t row, std::size_t col) {
+        static_assert(Op::arity == 2, "In reduce: the operator must be binomial!");
+        std::size_t const zero = 0;
+        // counting e as if it were one matrix
+        BNN_PROFILE_SCOPE("reduce", -1, 0, row * col * sizeof(T));
+        if (row * col < 2 * detail::elementwise_parallel_cutoff || ThreadPool::instance().size() == 1) {
+            return dispatch<detail::ReduceKernel, T>(&op, identity, &e, zero, row, zero, col);
+        }
+        auto const combine = [&](T a, T b) { return static_cast<T>(op(a, b)); };
+        if (row > 1) {
+            std::size_t const grain = (detail::elementwise_parallel_cutoff + col - 1) / col;
+            return parallel_reduce(row, grain, identity, [&](std::size_t begin, std::size_t end) {
+                return dispatch<detail::ReduceKernel, T>(&op, identity, &e, begin, end, zero, col);
+            }, combine);
+        }
+        std::size_t const line = 64;
+        return parallel_reduce(col / line, detail::elementwise_parallel_cutoff / line, identity,
+                               [&](std::size_t begin, std::size_t end) {
+            return dispatch<detail::ReduceKernel, T>(&op, identity, &e, zero, row, begin * line,
+                                                     end == col / line ? col : end * line);
+        }, combine);
+    }
+
+    // the same loop without vector instructions, for comparison
+    template<typename E, typename T>
+    void evaluate_scalar(E const &e, std::size_t row, std::size_t col, T *dst, std::size_t ld) {
+        detail::EvaluateKernel::run<Isa::Scalar>(&e, std::size_t(0), row, std::size_t(0), col, dst, ld);
+    }
+
+}
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef BNN_LinearAlgebra_Kernels_Gemm_hpp
+#define BNN_LinearAlgebra_Kernels_Gemm_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "Convert.hpp"
+#include "Simd.hpp"
+#include "../Profiler.hpp"
+#include "../ThreadPool.hpp"
+
+/*
+ * Packed, cache-blocked GEMM on row-major storage: C(m x n) += A(m x k) * B(k x n).
+ *
+ * The loop nest follows the usual Goto/BLIS layout. B is packed in KC x NC blocks
+ * into NR-wide column panels (stays in L3/L2), A is packed in MC x KC blocks into
+ * MR-high row panels (stays in L2), and the micro-kernel keeps an MR x NR tile of C
+ * in vector registers while streaming one panel of each through L1.
+ * A and B are addressed by (row stride, column stride), so packing also absorbs transposition.
+ */
+
+namespace LinearAlgebra {
+
+    // BLAS-style operand transposition flag
+    enum class Transpose : bool {
+        NoTrans = false,
+        Trans = true
+    };
+
+}
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+        // cache blocking, in elements
+        constexpr std::size_t gemm_kc = 256;
+        constexpr std::size_t gemm_mc_panels = 8;
+        constexpr std::size_t gemm_nc = 1024;
+
+        // below this many multiply-adds packing costs more than it saves
+        constexpr std::size_t gemm_scalar_cutoff = 16 * 16 * 16;
+        // below this many the wake-up of the pool costs more than splitting saves; tiles are at least this big too
+        constexpr std::size_t gemm_parallel_cutoff = 64 * 64 * 64;
+
+        // register tile (MR rows x NV vectors) of the micro-kernel for each instruction set
+        template<Isa isa>
+        struct GemmTile;
+        template<>
+        struct GemmTile<Isa::SSE> {
+            static constexpr std::size_t mr = 4, nv = 2;
+        };
+        template<>
+        struct GemmTile<Isa::AVX2> {
+            static constexpr std::size_t mr = 6, nv = 2;
+        };
+        template<>
+        struct GemmTile<Isa::AVX512> {
+            static constexpr std::size_t mr = 12, nv = 2;
+        };
+
+        // 64-byte aligned scratch reused by every call on the same thread
+        template<typename T, int slot>
+        T *pack_buffer(std::size_t size) {
+            struct Deleter {
+                void operator()(T *p) const {
+                    ::operator delete(p, std::align_val_t(64));
+                }
+            };
+            thread_local std::unique_ptr<T, Deleter> buffer;
+            thread_local std::size_t capacity = 0;
+            if (capacity < size) {
+                buffer.reset(static_cast<T *>(::operator new(size * sizeof(T), std::align_val_t(64))));
+                capacity = size;
+            }
+            return buffer.get();
+        }
+
+        // alpha * A(mc x kc) -> panels of mr rows, each stored column by column; short panels are zero padded
+        template<Isa isa, typename T, typename S>
+        BNN_ALWAYS_INLINE void pack_a(std::size_t mc, std::size_t kc, T alpha, S const *A, std::ptrdiff_t rs,
+                                      std::ptrdiff_t cs, std::size_t mr, T *BNN_RESTRICT dst) {
+            for (std::size_t i = 0; i < mc; i += mr) {
+                std::size_t const rows = std::min(mr, mc - i);
+                for (std::size_t p = 0; p < kc; p++) {
+                    S const *src = A + static_cast<std::ptrdiff_t>(i) * rs + static_cast<std::ptrdiff_t>(p) * cs;
+                    std::size_t r = 0;
+                    if constexpr (is_half_v<S> && std::is_same_v<T, float>) {
+                        if (rs == 1) {
+                            widen<isa>(rows, src, dst);
+                            for (; r < rows; r++) {
+                                dst[r] *= alpha;
+                            }
+                        }
+                    }
+                    for (; r < rows; r++) {
+                        dst[r] = alpha * static_cast<T>(src[static_cast<std::ptrdiff_t>(r) * rs]);
+                    }
+                    for (; r < mr; r++) {
+                        dst[r] = static_cast<T>(0);
+                    }
+                    dst += mr;
+                }
+            }
+        }
+
+        // B(kc x nc) -> panels of nr columns, each stored row by row; short panels are zero padded
+        template<Isa isa, typename T, typename S>
+        BNN_ALWAYS_INLINE void pack_b(std::size_t kc, std::size_t nc, S const *B, std::ptrdiff_t rs, std::ptrdiff_t cs,
+                                      std::size_t nr, T *BNN_RESTRICT dst) {
+            for (std::size_t j = 0; j < nc; j += nr) {
+                std::size_t const cols = std::min(nr, nc - j);
+                for (std::size_t p = 0; p < kc; p++) {
+                    S const *src = B + static_cast<std::ptrdiff_t>(p) * rs + static_cast<std::ptrdiff_t>(j) * cs;
+                    std::size_t c = 0;
+                    if (cs == 1) {
+                        if constexpr (is_half_v<S> && std::is_same_v<T, float>) {
+                            widen<isa>(cols, src, dst);
+                            c = cols;
+                        } else {
+                            for (; c < cols; c++) {
+                                dst[c] = src[c];
+                            }
+                        }
+                    } else {
+                        for (; c < cols; c++) {
+                            dst[c] = static_cast<T>(src[static_cast<std::ptrdiff_t>(c) * cs]);
+                        }
+                    }
+                    for (; c < nr; c++) {
+                        dst[c] = static_cast<T>(0);
+                    }
+                    dst += nr;
+                }
+            }
+        }
+
+#if BNN_X86
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // C(mr x nr) += a-panel * b-panel, accumulated in MR x NV registers
+        template<typename T, Isa isa>
+        BNN_ALWAYS_INLINE void micro_kernel(std::size_t kc, T const *BNN_RESTRICT a, T const *BNN_RESTRICT b,
+                                            T *c, std::size_t ldc, std::size_t mr, std::size_t nr) {
+            using V = Vec<T, isa>;
+            using type = typename V::type;
+            constexpr std::size_t MR = GemmTile<isa>::mr, NV = GemmTile<isa>::nv;
+            constexpr std::size_t W = V::width, NR = NV * W;
+
+            type acc[MR][NV];
+#pragma GCC unroll 16
+            for (std::size_t r = 0; r < MR; r++) {
+#pragma GCC unroll 4
+                for (std::size_t v = 0; v < NV; v++) {
+                    acc[r][v] = V::zero();
+                }
+            }
+            for (std::size_t p = 0; p < kc; p++) {
+                type bv[NV];
+#pragma GCC unroll 4
+                for (std::size_t v = 0; v < NV; v++) {
+                    bv[v] = V::load(b + v * W);
+                }
+#pragma GCC unroll 16
+                for (std::size_t r = 0; r < MR; r++) {
+                    type const ar = V::set1(a[r]);
+#pragma GCC unroll 4
+                    for (std::size_t v = 0; v < NV; v++) {
+                        acc[r][v] = V::fmadd(ar, bv[v], acc[r][v]);
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+
+            if (mr == MR && nr == NR) {
+#pragma GCC unroll 16
+                for (std::size_t r = 0; r < MR; r++) {
+#pragma GCC unroll 4
+                    for (std::size_t v = 0; v < NV; v++) {
+                        T *dst = c + r * ldc + v * W;
+                        V::store(dst, V::add(V::load(dst), acc[r][v]));
+                    }
+                }
+            } else {
+                alignas(64) T tile[MR * NR];
+#pragma GCC unroll 16
+                for (std::size_t r = 0; r < MR; r++) {
+#pragma GCC unroll 4
+                    for (std::size_t v = 0; v < NV; v++) {
+                        V::store(tile + r * NR + v * W, acc[r][v]);
+                    }
+                }
+                for (std::size_t r = 0; r < mr; r++) {
+                    for (std::size_t j = 0; j < nr; j++) {
+                        c[r * ldc + j] += tile[r * NR + j];
+                    }
+                }
+            }
+        }
+
+        template<typename T, Isa isa, typename SA, typename SB>
+        BNN_ALWAYS_INLINE void gemm_packed(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                                           SA const *A, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                                           SB const *B, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                                           T *C, std::size_t ldc) {
+            constexpr std::size_t MR = GemmTile<isa>::mr;
+            constexpr std::size_t NR = GemmTile<isa>::nv * Vec<T, isa>::width;
+            constexpr std::size_t KC = gemm_kc, MC = gemm_mc_panels * MR, NC = gemm_nc / NR * NR;
+
+            T *const Bp = pack_buffer<T, 0>(KC * NC);
+            T *const Ap = pack_buffer<T, 1>(MC * KC);
+
+            for (std::size_t jc = 0; jc < n; jc += NC) {
+                std::size_t const nc = std::min(NC, n - jc);
+                for (std::size_t pc = 0; pc < k; pc += KC) {
+                    std::size_t const kc = std::min(KC, k - pc);
+                    pack_b<isa>(kc, nc, B + static_cast<std::ptrdiff_t>(pc) * rsb + static_cast<std::ptrdiff_t>(jc) * csb,
+                           rsb, csb, NR, Bp);
+                    for (std::size_t ic = 0; ic < m; ic += MC) {
+                        std::size_t const mc = std::min(MC, m - ic);
+                        pack_a<isa>(mc, kc, alpha,
+                               A + static_cast<std::ptrdiff_t>(ic) * rsa + static_cast<std::ptrdiff_t>(pc) * csa,
+                               rsa, csa, MR, Ap);
+                        for (std::size_t jr = 0; jr < nc; jr += NR) {
+                            for (std::size_t ir = 0; ir < mc; ir += MR) {
+                                micro_kernel<T, isa>(kc, Ap + ir * kc, Bp + jr * kc,
+                                                     C + (ic + ir) * ldc + jc + jr, ldc,
+                                                     std::min(MR, mc - ir), std::min(NR, nc - jr));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+        // reference loop, also used for every type without a vector kernel
+        template<typename T, typename SA, typename SB>
+        void gemm_scalar(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                         SA const *A, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                         SB const *B, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                         T *C, std::size_t ldc) {
+            for (std::size_t i = 0; i < m; i++) {
+                T *c = C + i * ldc;
+                for (std::size_t p = 0; p < k; p++) {
+                    T const a = alpha * static_cast<T>(A[static_cast<std::ptrdiff_t>(i) * rsa +
+                                                         static_cast<std::ptrdiff_t>(p) * csa]);
+                    SB const *b = B + static_cast<std::ptrdiff_t>(p) * rsb;
+                    for (std::size_t j = 0; j < n; j++) {
+                        c[j] += a * static_cast<T>(b[static_cast<std::ptrdiff_t>(j) * csb]);
+                    }
+                }
+            }
+        }
+
+        // A and B may be stored as bfloat16 or float16 for T = float; they are widened while packing
+        struct GemmKernel {
+            template<Isa isa, typename T, typename SA, typename SB>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                                              SA const *A, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                                              SB const *B, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                                              T *C, std::size_t ldc) {
+#if BNN_X86
+                if constexpr (isa != Isa::Scalar) {
+                    gemm_packed<T, isa>(m, n, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+                    return;
+                }
+#endif
+                gemm_scalar(m, n, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+            }
+        };
+
+        // strided entry point: C(m x n) += alpha * A * B, where A(i, p) = A[i * rsa + p * csa] and likewise for B
+        template<typename T, typename SA, typename SB>
+        void gemm_strided(std::size_t m, std::size_t n, std::size_t k, T alpha,
+                          SA const *A, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                          SB const *B, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                          T *C, std::size_t ldc) {
+            if (m == 0 || n == 0 || k == 0 || alpha == static_cast<T>(0)) {
+                return;
+            }
+            BNN_PROFILE_SCOPE("gemm", -1, 2 * m * n * k, m * k * sizeof(SA) + k * n * sizeof(SB) + 2 * m * n * sizeof(T));
+            if (m * n * k < gemm_scalar_cutoff || m == 1 || n == 1) {
+                gemm_scalar(m, n, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+                return;
+            }
+            if (m * n * k < 2 * gemm_parallel_cutoff || ThreadPool::instance().size() == 1) {
+                dispatch<GemmKernel, T>(m, n, k, alpha, A, rsa, csa, B, rsb, csb, C, ldc);
+                return;
+            }
+            // tiles of C along its longer side; each one packs into its own thread's buffers
+            if (m >= n) {
+                std::size_t const grain = (gemm_parallel_cutoff / (n * k) + 16) / 16 * 16;
+                parallel_for(m, grain, [&](std::size_t begin, std::size_t end) {
+                    dispatch<GemmKernel, T>(end - begin, n, k, alpha, A + static_cast<std::ptrdiff_t>(begin) * rsa,
+                                            rsa, csa, B, rsb, csb, C + begin * ldc, ldc);
+                });
+            } else {
+                std::size_t const grain = (gemm_parallel_cutoff / (m * k) + 64) / 64 * 64;
+                parallel_for(n, grain, [&](std::size_t begin, std::size_t end) {
+                    dispatch<GemmKernel, T>(m, end - begin, k, alpha, A, rsa, csa,
+                                            B + static_cast<std::ptrdiff_t>(begin) * csb, rsb, csb, C + begin, ldc);
+                });
+            }
+        }
+
+        // C(m x n) *= beta
+        template<typename T>
+        void scale_rows(std::size_t m, std::size_t n, T beta, T *C, std::size_t ldc) {
+            if (beta == static_cast<T>(1)) {
+                return;
+            }
+            for (std::size_t i = 0; i < m; i++) {
+                T *c = C + i * ldc;
+                if (beta == static_cast<T>(0)) {
+                    std::fill(c, c + n, static_cast<T>(0));
+                } else {
+                    for (std::size_t j = 0; j < n; j++) {
+                        c[j] *= beta;
+                    }
+                }
+            }
+        }
+
+    }
+
+    // C(m x n) += A(m x k) * B(k x n), all row-major with leading dimensions lda, ldb, ldc
+    template<typename T>
+    void gemm(std::size_t m, std::size_t n, std::size_t k,
+              T const *A, std::size_t lda, T const *B, std::size_t ldb, T *C, std::size_t ldc) {
+        detail::gemm_strided(m, n, k, static_cast<T>(1),
+                             A, static_cast<std::ptrdiff_t>(lda), 1,
+                             B, static_cast<std::ptrdiff_t>(ldb), 1,
+                             C, ldc);
+    }
+
+    // C = alpha * op(A) * op(B) + beta * C, where op(A) is m x k and op(B) is k x n
+    // A and B are stored row-major with leading dimensions lda and ldb before op is applied;
+    // with C float, either may also be stored as bfloat16 or float16, accumulating in float all the same
+    template<typename T, typename SA, typename SB>
+    void gemm(Transpose transA, Transpose transB, std::size_t m, std::size_t n, std::size_t k,
+              T alpha, SA const *A, std::size_t lda, SB const *B, std::size_t ldb,
+              T beta, T *C, std::size_t ldc) {
+        auto const ilda = static_cast<std::ptrdiff_t>(lda), ildb = static_cast<std::ptrdiff_t>(ldb);
+        detail::scale_rows(m, n, beta, C, ldc);
+        detail::gemm_strided(m, n, k, alpha,
+                             A, transA == Transpose::NoTrans ? ilda : 1, transA == Transpose::NoTrans ? 1 : ilda,
+                             B, transB == Transpose::NoTrans ? ildb : 1, transB == Transpose::NoTrans ? 1 : ildb,
+                             C, ldc);
+    }
+
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef BNN_LinearAlgebra_Kernels_Int8_hpp
+#define BNN_LinearAlgebra_Kernels_Int8_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "Simd.hpp"
+#include "../ThreadPool.hpp"
+
+/*
+ * int8 x uint8 -> int32 products for quantized inference: C(i, j) = sum_p A(i, p) * B(j, p), where the
+ * rows of A hold int8 weights and the rows of B uint8 activations, both zero padded to int8_padding bytes.
+ * Activations stay within [0, uint8_activation_max = 127]: then the pairwise u8 x s8 sums of AVX2's maddubs
+ * cannot saturate 16 bits, and every instruction set gives the same exact result. AVX-512 cpus with VNNI
+ * multiply-add four bytes per lane straight into int32 with vpdpbusd.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    // rows of A and B are zero padded to a multiple of this many bytes, one AVX-512 register
+    inline constexpr std::size_t int8_padding = 64;
+    // quantized activations lie within [0, uint8_activation_max]
+    inline constexpr int uint8_activation_max = 127;
+
+    // bytes a row of k values takes
+    inline std::size_t int8_padded(std::size_t k) {
+        return (k + int8_padding - 1) / int8_padding * int8_padding;
+    }
+
+    namespace detail {
+
+        // below this many multiply-adds products stay on the calling thread
+        constexpr std::size_t int8_parallel_cutoff = std::size_t(1) << 20;
+
+        inline void int8_gemm_scalar(std::size_t m, std::size_t n, std::size_t kp, std::int8_t const *A,
+                                     std::uint8_t const *B, std::int32_t *C, std::size_t ldc) {
+            for (std::size_t i = 0; i < m; i++) {
+                for (std::size_t j = 0; j < n; j++) {
+                    std::int32_t sum = 0;
+                    for (std::size_t p = 0; p < kp; p++) {
+                        sum += std::int32_t(A[i * kp + p]) * std::int32_t(B[j * kp + p]);
+                    }
+                    C[i * ldc + j] = sum;
+                }
+            }
+        }
+
+#if BNN_X86
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        BNN_TARGET_AVX2 inline std::int32_t hsum_avx2(__m256i v) {
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_cvtsi128_si32(s);
+        }
+
+        // tiles of MR rows of A against NR rows of B, each pair of rows summed in its own register; the rows
+        // of an edge tile past m or n repeat the last one and are not stored
+        BNN_TARGET_VNNI inline void int8_gemm_vnni(std::size_t m, std::size_t n, std::size_t kp, std::int8_t const *A,
+                                                   std::uint8_t const *B, std::int32_t *C, std::size_t ldc) {
+            constexpr std::size_t MR = 4, NR = 4;
+            for (std::size_t i = 0; i < m; i += MR) {
+                std::size_t const mr = std::min(MR, m - i);
+                std::int8_t const *a[MR];
+#pragma GCC unroll 4
+                for (std::size_t r = 0; r < MR; r++) {
+                    a[r] = A + (i + std::min(r, mr - 1)) * kp;
+                }
+                for (std::size_t j = 0; j < n; j += NR) {
+                    std::size_t const nr = std::min(NR, n - j);
+                    std::uint8_t const *b[NR];
+                    __m512i acc[MR][NR];
+#pragma GCC unroll 4
+                    for (std::size_t c = 0; c < NR; c++) {
+                        b[c] = B + (j + std::min(c, nr - 1)) * kp;
+#pragma GCC unroll 4
+                        for (std::size_t r = 0; r < MR; r++) {
+                            acc[r][c] = _mm512_setzero_si512();
+                        }
+                    }
+                    for (std::size_t p = 0; p < kp; p += 64) {
+                        __m512i bv[NR];
+#pragma GCC unroll 4
+                        for (std::size_t c = 0; c < NR; c++) {
+                            bv[c] = _mm512_loadu_si512(b[c] + p);
+                        }
+#pragma GCC unroll 4
+                        for (std::size_t r = 0; r < MR; r++) {
+                            __m512i const av = _mm512_loadu_si512(a[r] + p);
+#pragma GCC unroll 4
+                            for (std::size_t c = 0; c < NR; c++) {
+                                acc[r][c] = _mm512_dpbusd_epi32(acc[r][c], bv[c], av);
+                            }
+                        }
+                    }
+                    for (std::size_t r = 0; r < mr; r++) {
+                        for (std::size_t c = 0; c < nr; c++) {
+                            C[(i + r) * ldc + j + c] = _mm512_reduce_add_epi32(acc[r][c]);
+                        }
+                    }
+                }
+            }
+        }
+
+        // as above with maddubs (u8 x s8, adjacent pairs summed to int16) and madd (pairs of those to int32);
+        // a smaller tile leaves room in the 16 registers
+        BNN_TARGET_AVX2 inline void int8_gemm_avx2(std::size_t m, std::size_t n, std::size_t kp, std::int8_t const *A,
+                                                   std::uint8_t const *B, std::int32_t *C, std::size_t ldc) {
+            constexpr std::size_t MR = 2, NR = 4;
+            __m256i const ones = _mm256_set1_epi16(1);
+            for (std::size_t i = 0; i < m; i += MR) {
+                std::size_t const mr = std::min(MR, m - i);
+                std::int8_t const *a[MR];
+#pragma GCC unroll 4
+                for (std::size_t r = 0; r < MR; r++) {
+                    a[r] = A + (i + std::min(r, mr - 1)) * kp;
+                }
+                for (std::size_t j = 0; j < n; j += NR) {
+                    std::size_t const nr = std::min(NR, n - j);
+                    std::uint8_t const *b[NR];
+                    __m256i acc[MR][NR];
+#pragma GCC unroll 4
+                    for (std::size_t c = 0; c < NR; c++) {
+                        b[c] = B + (j + std::min(c, nr - 1)) * kp;
+#pragma GCC unroll 4
+                        for (std::size_t r = 0; r < MR; r++) {
+                            acc[r][c] = _mm256_setzero_si256();
+                        }
+                    }
+                    for (std::size_t p = 0; p < kp; p += 32) {
+                        __m256i bv[NR];
+#pragma GCC unroll 4
+                        for (std::size_t c = 0; c < NR; c++) {
+                            bv[c] = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(b[c] + p));
+                        }
+#pragma GCC unroll 4
+                        for (std::size_t r = 0; r < MR; r++) {
+                            __m256i const av = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(a[r] + p));
+#pragma GCC unroll 4
+                            for (std::size_t c = 0; c < NR; c++) {
+                                __m256i const pairs = _mm256_maddubs_epi16(bv[c], av);
+                                acc[r][c] = _mm256_add_epi32(acc[r][c], _mm256_madd_epi16(pairs, ones));
+                            }
+                        }
+                    }
+                    for (std::size_t r = 0; r < mr; r++) {
+                        for (std::size_t c = 0; c < nr; c++) {
+                            C[(i + r) * ldc + j + c] = hsum_avx2(acc[r][c]);
+                        }
+                    }
+                }
+            }
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+        // SSE2 has no byte multiply-add, so it takes the scalar loop
+        struct Int8GemmKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t m, std::size_t n, std::size_t kp, std::int8_t const *A,
+                                              std::uint8_t const *B, std::int32_t *C, std::size_t ldc) {
+#if BNN_X86
+                if constexpr (isa == Isa::AVX512) {
+                    if (has_vnni()) {
+                        int8_gemm_vnni(m, n, kp, A, B, C, ldc);
+                        return;
+                    }
+                }
+                if constexpr (isa == Isa::AVX512 || isa == Isa::AVX2) {
+                    int8_gemm_avx2(m, n, kp, A, B, C, ldc);
+                    return;
+                }
+#endif
+                int8_gemm_scalar(m, n, kp, A, B, C, ldc);
+            }
+        };
+
+    }
+
+    // C(m x n) = A * B^T, where A holds m rows of int8 and B n rows of uint8 within [0, 127], each kp bytes
+    // (a multiple of int8_padding) with zeros past the last value
+    inline void int8_gemm(std::size_t m, std::size_t n, std::size_t kp, std::int8_t const *A,
+                          std::uint8_t const *B, std::int32_t *C, std::size_t ldc) {
+        if (m * n * kp < 2 * detail::int8_parallel_cutoff || ThreadPool::instance().size() == 1) {
+            dispatch<detail::Int8GemmKernel, float>(m, n, kp, A, B, C, ldc);
+            return;
+        }
+        std::size_t const grain = detail::int8_parallel_cutoff / (n * kp) + 1;
+        parallel_for(m, grain, [&](std::size_t begin, std::size_t end) {
+            dispatch<detail::Int8GemmKernel, float>(end - begin, n, kp, A + begin * kp, B, C + begin * ldc, ldc);
+        });
+    }
+
+    // B(j, p) = round(X(p, j) / scale) + zero, clamped to [0, 127], for the k x n values of X (row-major,
+    // leading dimension ldx): the columns of X become rows of B, kp bytes each with zeros past k
+    template<typename T>
+    void quantize_uint8(std::size_t k, std::size_t n, T const *X, std::size_t ldx, T scale, int zero,
+                        std::size_t kp, std::uint8_t *B) {
+        T const inverse = static_cast<T>(1) / scale;
+        T const offset = static_cast<T>(zero) + static_cast<T>(0.5);
+        for (std::size_t j = 0; j < n; j++) {
+            std::fill(B + j * kp + k, B + (j + 1) * kp, std::uint8_t(0));
+        }
+        for (std::size_t p = 0; p < k; p++) {
+            T const *x = X + p * ldx;
+            for (std::size_t j = 0; j < n; j++) {
+                // clamped first, so truncation rounds half up
+                T const q = std::min(std::max(x[j] * inverse + offset, static_cast<T>(0)),
+                                     static_cast<T>(uint8_activation_max) + static_cast<T>(0.5));
+                B[j * kp + p] = static_cast<std::uint8_t>(q);
+            }
+        }
+    }
+
+}
+
+#endif
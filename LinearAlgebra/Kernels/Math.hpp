@@ -0,0 +1,104 @@
+#ifndef BNN_LinearAlgebra_Kernels_Math_hpp
+#define BNN_LinearAlgebra_Kernels_Math_hpp
+
+#include <cmath>
+#include <cstddef>
+#include "Simd.hpp"
+
+/*
+ * Vectorized elementary functions for the kernels, each with a scalar overload for remainders.
+ * exp reduces x = n * ln2 + r with |r| <= ln2 / 2, evaluates a Taylor polynomial for e^r
+ * and scales by 2^n through the exponent bits. Inputs are clamped to the range where 2^n is
+ * a normal number, so results saturate instead of overflowing to inf or NaN; within that range
+ * the error is a few ulp.
+ * Registers are updated in place rather than passed by value, see Expression.hpp.
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+        template<typename T>
+        struct ExpConstants;
+
+        template<>
+        struct ExpConstants<float> {
+            static constexpr float max = 88.0f, min = -87.0f;
+            static constexpr float log2e = 1.44269504088896341f;
+            static constexpr float ln2_hi = 0.693359375f, ln2_lo = -2.12194440e-4f;
+            // adding it rounds to an integer held in the low mantissa bits
+            static constexpr float magic = 12582912.0f;
+            static constexpr int degree = 7;
+        };
+
+        template<>
+        struct ExpConstants<double> {
+            static constexpr double max = 709.0, min = -708.0;
+            static constexpr double log2e = 1.4426950408889634074;
+            static constexpr double ln2_hi = 6.93145751953125e-1, ln2_lo = 1.42860682030941723212e-6;
+            static constexpr double magic = 6755399441055744.0;
+            static constexpr int degree = 12;
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // x = e^x
+        template<typename T, Isa isa>
+        BNN_ALWAYS_INLINE void exp(typename Vec<T, isa>::type &x) {
+            using V = Vec<T, isa>;
+            using C = ExpConstants<T>;
+            x = V::min(V::max(x, V::set1(C::min)), V::set1(C::max));
+            typename V::type const shifted = V::fmadd(x, V::set1(C::log2e), V::set1(C::magic));
+            typename V::type const n = V::sub(shifted, V::set1(C::magic));
+            typename V::type r = V::sub(x, V::mul(n, V::set1(C::ln2_hi)));
+            r = V::sub(r, V::mul(n, V::set1(C::ln2_lo)));
+            // Horner on sum r^k / k!
+            T coefficient = 1;
+            for (int k = 2; k <= C::degree; k++) {
+                coefficient /= static_cast<T>(k);
+            }
+            typename V::type p = V::set1(coefficient);
+            for (int k = C::degree; k > 0; k--) {
+                coefficient *= static_cast<T>(k);
+                p = V::fmadd(p, r, V::set1(coefficient));
+            }
+            x = V::mul(p, V::pow2i(shifted));
+        }
+
+        // x = log(1 + x) for 0 <= x <= 1, through 2 atanh(x / (2 + x)); exact to a few ulp near 0 as well
+        template<typename T, Isa isa>
+        BNN_ALWAYS_INLINE void log1p_unit(typename Vec<T, isa>::type &x) {
+            using V = Vec<T, isa>;
+            // s <= 1/3, so the odd series needs s^(2k+1) / (2k+1) below the precision of T
+            constexpr int terms = sizeof(T) == sizeof(float) ? 8 : 16;
+            typename V::type const s = V::div(x, V::add(V::set1(2), x));
+            typename V::type const s2 = V::mul(s, s);
+            typename V::type p = V::set1(static_cast<T>(1) / static_cast<T>(2 * terms - 1));
+            for (int k = terms - 2; k >= 0; k--) {
+                p = V::fmadd(p, s2, V::set1(static_cast<T>(1) / static_cast<T>(2 * k + 1)));
+            }
+            x = V::mul(V::add(s, s), p);
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        template<typename T>
+        BNN_ALWAYS_INLINE T exp(T x) {
+            return std::exp(x);
+        }
+
+        template<typename T>
+        BNN_ALWAYS_INLINE T log1p_unit(T x) {
+            return std::log1p(x);
+        }
+
+    }
+
+}
+
+#endif
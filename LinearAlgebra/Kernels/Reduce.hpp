@@ -0,0 +1,562 @@
+#ifndef BNN_LinearAlgebra_Kernels_Reduce_hpp
+#define BNN_LinearAlgebra_Kernels_Reduce_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include "Simd.hpp"
+#include "Math.hpp"
+#include "Gemm.hpp"
+#include "Elementwise.hpp"
+#include "../Profiler.hpp"
+#include "../ThreadPool.hpp"
+
+/*
+ * Reductions of row-major storage over the whole block, each row or each column: sums, extrema and the
+ * position of the largest element, L1 and L2 norms, and log-sum-exp.
+ * Sums keep a Kahan-compensated accumulator in every vector lane, then add the lanes and the results of the
+ * tiles pairwise. Whole-block sums split their rows by thread count unless deterministic is set; then the
+ * tiles depend on the shape alone and the result is the same for any number of threads, though not across
+ * instruction sets, whose registers divide a row differently. Row and column reductions compute each output
+ * on one thread in a fixed order, so they are deterministic anyway.
+ * log-sum-exp subtracts the maximum first, so it neither overflows nor underflows for finite inputs.
+ * Extrema compare with >, so argmax gives the first of equal maxima; NaNs are not looked for.
+ */
+
+namespace LinearAlgebra {
+
+    // what a reduction computes over its elements
+    enum class Reduction : int {
+        Sum,
+        Max,
+        Min,
+        // sum of |x|
+        Norm1,
+        // sqrt of the sum of x^2
+        Norm2,
+        // log of the sum of e^x
+        LogSumExp
+    };
+
+}
+
+namespace LinearAlgebra::Kernels {
+
+    namespace detail {
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // what a sum adds up, f(x) or, for log-sum-exp, f(x - shift)
+        struct Plain {
+            template<typename T>
+            static T apply(T x, T) { return x; }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &, P const &) {}
+        };
+
+        struct Absolute {
+            template<typename T>
+            static T apply(T x, T) { return x < 0 ? -x : x; }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &x, P const &) {
+                x = Vec<T, isa>::max(x, Vec<T, isa>::sub(Vec<T, isa>::zero(), x));
+            }
+        };
+
+        struct Square {
+            template<typename T>
+            static T apply(T x, T) { return x * x; }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &x, P const &) { x = Vec<T, isa>::mul(x, x); }
+        };
+
+        struct ShiftedExp {
+            template<typename T>
+            static T apply(T x, T shift) { return exp(x - shift); }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void packet(P &x, P const &shift) {
+                x = Vec<T, isa>::sub(x, shift);
+                exp<T, isa>(x);
+            }
+        };
+
+        // s - c is the running sum: add x to it, Kahan style
+        template<typename T>
+        BNN_ALWAYS_INLINE void kahan_add(T &s, T &c, T x) {
+            T const y = x - c;
+            T const t = s + y;
+            c = (t - s) - y;
+            s = t;
+        }
+
+        template<typename V, typename P>
+        BNN_ALWAYS_INLINE void kahan_add_packet(P &s, P &c, P const &x) {
+            P const y = V::sub(x, c);
+            P const t = V::add(s, y);
+            c = V::sub(V::sub(t, s), y);
+            s = t;
+        }
+
+        // v[0] + ... + v[n - 1] in a balanced tree, overwriting v
+        template<typename T>
+        T pairwise_sum(T *v, std::size_t n) {
+            for (std::size_t step = 1; step < n; step *= 2) {
+                for (std::size_t k = 0; k + step < n; k += 2 * step) {
+                    v[k] += v[k + step];
+                }
+            }
+            return n == 0 ? static_cast<T>(0) : v[0];
+        }
+
+        // sum of F(a(i, j), shift) over rows [i0, i1)
+        template<typename F, Isa isa, typename T>
+        BNN_ALWAYS_INLINE T sum(std::size_t i0, std::size_t i1, std::size_t col, T const *a, std::size_t lda, T shift) {
+            T s = 0, c = 0;
+#if BNN_X86
+            if constexpr (isa != Isa::Scalar) {
+                using V = Vec<T, isa>;
+                constexpr std::size_t W = V::width;
+                if (col >= W) {
+                    typename V::type const sv = V::set1(shift);
+                    typename V::type s0 = V::zero(), s1 = V::zero(), c0 = V::zero(), c1 = V::zero(), x;
+                    for (std::size_t i = i0; i < i1; i++) {
+                        T const *row = a + i * lda;
+                        std::size_t j = 0;
+                        for (; j + 2 * W <= col; j += 2 * W) {
+                            x = V::load(row + j);
+                            F::template packet<isa, T>(x, sv);
+                            kahan_add_packet<V>(s0, c0, x);
+                            x = V::load(row + j + W);
+                            F::template packet<isa, T>(x, sv);
+                            kahan_add_packet<V>(s1, c1, x);
+                        }
+                        for (; j + W <= col; j += W) {
+                            x = V::load(row + j);
+                            F::template packet<isa, T>(x, sv);
+                            kahan_add_packet<V>(s0, c0, x);
+                        }
+                        for (; j < col; j++) {
+                            kahan_add(s, c, F::apply(row[j], shift));
+                        }
+                    }
+                    alignas(64) T lanes[4 * W];
+                    V::store(lanes, s0);
+                    V::store(lanes + W, s1);
+                    V::store(lanes + 2 * W, V::sub(V::zero(), c0));
+                    V::store(lanes + 3 * W, V::sub(V::zero(), c1));
+                    return pairwise_sum(lanes, 4 * W) + (s - c);
+                }
+            }
+#endif
+            for (std::size_t i = i0; i < i1; i++) {
+                for (std::size_t j = 0; j < col; j++) {
+                    kahan_add(s, c, F::apply(a[i * lda + j], shift));
+                }
+            }
+            return s - c;
+        }
+
+        // largest element of row[0, col), or the smallest
+        template<bool greatest, Isa isa, typename T>
+        BNN_ALWAYS_INLINE T extremum(std::size_t col, T const *row) {
+            T ret = row[0];
+            std::size_t j = 0;
+#if BNN_X86
+            if constexpr (isa != Isa::Scalar) {
+                using V = Vec<T, isa>;
+                constexpr std::size_t W = V::width;
+                if (col >= W) {
+                    typename V::type m0 = V::load(row), m1 = m0;
+                    for (j = W; j + 2 * W <= col; j += 2 * W) {
+                        if constexpr (greatest) {
+                            m0 = V::max(m0, V::load(row + j));
+                            m1 = V::max(m1, V::load(row + j + W));
+                        } else {
+                            m0 = V::min(m0, V::load(row + j));
+                            m1 = V::min(m1, V::load(row + j + W));
+                        }
+                    }
+                    alignas(64) T lanes[W];
+                    V::store(lanes, greatest ? V::max(m0, m1) : V::min(m0, m1));
+                    for (std::size_t k = 0; k < W; k++) {
+                        ret = greatest ? std::max(ret, lanes[k]) : std::min(ret, lanes[k]);
+                    }
+                }
+            }
+#endif
+            for (; j < col; j++) {
+                ret = greatest ? std::max(ret, row[j]) : std::min(ret, row[j]);
+            }
+            return ret;
+        }
+
+        // extremum of rows [i0, i1) and the first row holding it
+        template<bool greatest>
+        struct ExtremumKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE std::pair<T, std::size_t> run(std::size_t i0, std::size_t i1, std::size_t col,
+                                                                   T const *a, std::size_t lda) {
+                std::pair<T, std::size_t> ret(a[i0 * lda], i0);
+                for (std::size_t i = i0; i < i1; i++) {
+                    T const m = extremum<greatest, isa>(col, a + i * lda);
+                    if (greatest ? ret.first < m : m < ret.first) {
+                        ret = {m, i};
+                    }
+                }
+                return ret;
+            }
+        };
+
+        template<typename F>
+        struct SumKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE T run(std::size_t i0, std::size_t i1, std::size_t col, T const *a, std::size_t lda,
+                                           T shift) {
+                return sum<F, isa>(i0, i1, col, a, lda, shift);
+            }
+        };
+
+        // R from the sum s, and for log-sum-exp the maximum m that was subtracted before
+        template<Reduction R, typename T>
+        BNN_ALWAYS_INLINE T finish(T s, T m) {
+            if constexpr (R == Reduction::Norm2) {
+                return std::sqrt(s);
+            } else if constexpr (R == Reduction::LogSumExp) {
+                // all -inf, or an inf or NaN that the shift would turn into NaN
+                return std::isfinite(m) ? m + std::log(s) : m;
+            } else {
+                return s;
+            }
+        }
+
+        // R of row[0, col)
+        template<Reduction R, Isa isa, typename T>
+        BNN_ALWAYS_INLINE T reduce_row(std::size_t col, T const *row) {
+            if constexpr (R == Reduction::Max || R == Reduction::Min) {
+                return extremum<R == Reduction::Max, isa>(col, row);
+            } else if constexpr (R == Reduction::LogSumExp) {
+                T const m = extremum<true, isa>(col, row);
+                return finish<R>(std::isfinite(m) ? sum<ShiftedExp, isa>(0, 1, col, row, col, m) : m, m);
+            } else {
+                using F = std::conditional_t<R == Reduction::Sum, Plain,
+                        std::conditional_t<R == Reduction::Norm1, Absolute, Square> >;
+                return finish<R>(sum<F, isa>(0, 1, col, row, col, static_cast<T>(0)), static_cast<T>(0));
+            }
+        }
+
+        // out[i * inc] = R of row i, for rows [i0, i1)
+        template<Reduction R>
+        struct RowKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t i0, std::size_t i1, std::size_t col, T const *a,
+                                              std::size_t lda, T *out, std::size_t inc) {
+                for (std::size_t i = i0; i < i1; i++) {
+                    out[i * inc] = reduce_row<R, isa>(col, a + i * lda);
+                }
+            }
+        };
+
+        // out[j] = largest, or smallest, element of column j for columns [j0, j1), a row at a time
+        template<bool greatest, Isa isa, typename T>
+        BNN_ALWAYS_INLINE void column_extremum(std::size_t row, std::size_t j0, std::size_t j1, T const *a,
+                                               std::size_t lda, T *out) {
+            std::copy(a + j0, a + j1, out + j0);
+            for (std::size_t i = 1; i < row; i++) {
+                T const *src = a + i * lda;
+                std::size_t j = j0;
+#if BNN_X86
+                if constexpr (isa != Isa::Scalar) {
+                    using V = Vec<T, isa>;
+                    for (; j + V::width <= j1; j += V::width) {
+                        V::store(out + j, greatest ? V::max(V::load(out + j), V::load(src + j))
+                                                   : V::min(V::load(out + j), V::load(src + j)));
+                    }
+                }
+#endif
+                for (; j < j1; j++) {
+                    out[j] = greatest ? std::max(out[j], src[j]) : std::min(out[j], src[j]);
+                }
+            }
+        }
+
+        // out[j] = R of column j, for columns [j0, j1). Sums walk down the rows with two registers of columns,
+        // a cache line for AVX2, and their accumulators
+        template<Reduction R>
+        struct ColumnKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t j0, std::size_t j1, T const *a,
+                                              std::size_t lda, T *out) {
+                if constexpr (R == Reduction::Max || R == Reduction::Min) {
+                    column_extremum<R == Reduction::Max, isa>(row, j0, j1, a, lda, out);
+                } else {
+                    using F = std::conditional_t<R == Reduction::Sum, Plain,
+                            std::conditional_t<R == Reduction::Norm1, Absolute,
+                                    std::conditional_t<R == Reduction::Norm2, Square, ShiftedExp> > >;
+                    constexpr bool shifted = R == Reduction::LogSumExp;
+                    // the shifts are the maxima, kept in out until the sums replace them
+                    if constexpr (shifted) {
+                        column_extremum<true, isa>(row, j0, j1, a, lda, out);
+                    }
+                    std::size_t j = j0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        constexpr std::size_t W = V::width;
+                        alignas(64) T sums[2 * W];
+                        for (; j + W <= j1; j += 2 * W) {
+                            bool const pair = j + 2 * W <= j1;
+                            typename V::type const shift0 = shifted ? V::load(out + j) : V::zero();
+                            typename V::type const shift1 = shifted && pair ? V::load(out + j + W) : V::zero();
+                            typename V::type s0 = V::zero(), s1 = V::zero(), c0 = V::zero(), c1 = V::zero(), x;
+                            for (std::size_t i = 0; i < row; i++) {
+                                x = V::load(a + i * lda + j);
+                                F::template packet<isa, T>(x, shift0);
+                                kahan_add_packet<V>(s0, c0, x);
+                                if (pair) {
+                                    x = V::load(a + i * lda + j + W);
+                                    F::template packet<isa, T>(x, shift1);
+                                    kahan_add_packet<V>(s1, c1, x);
+                                }
+                            }
+                            V::store(sums, V::sub(s0, c0));
+                            V::store(sums + W, V::sub(s1, c1));
+                            std::size_t const width = pair ? 2 * W : W;
+                            for (std::size_t k = 0; k < width; k++) {
+                                out[j + k] = finish<R>(sums[k], out[j + k]);
+                            }
+                            if (!pair) {
+                                j += W;
+                                break;
+                            }
+                        }
+                    }
+#endif
+                    for (; j < j1; j++) {
+                        T const shift = shifted ? out[j] : static_cast<T>(0);
+                        T s = 0, c = 0;
+                        for (std::size_t i = 0; i < row; i++) {
+                            kahan_add(s, c, F::apply(a[i * lda + j], shift));
+                        }
+                        out[j] = finish<R>(s - c, out[j]);
+                    }
+                }
+            }
+        };
+
+        // out[i] = column of the first largest element of row i, for rows [i0, i1)
+        struct ArgmaxRowKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t i0, std::size_t i1, std::size_t col, T const *a,
+                                              std::size_t lda, std::size_t *out) {
+                for (std::size_t i = i0; i < i1; i++) {
+                    T const *src = a + i * lda;
+                    T const m = extremum<true, isa>(col, src);
+                    std::size_t const j = static_cast<std::size_t>(std::find(src, src + col, m) - src);
+                    out[i] = j == col ? 0 : j;
+                }
+            }
+        };
+
+        // out[j] = row of the first largest element of column j, for columns [j0, j1). Registers count rows in
+        // T, exactly in runs of argmax_run rows
+        constexpr std::size_t argmax_run = std::size_t(1) << 20;
+
+        struct ArgmaxColumnKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t j0, std::size_t j1, T const *a,
+                                              std::size_t lda, std::size_t *out) {
+                std::size_t j = j0;
+#if BNN_X86
+                if constexpr (isa != Isa::Scalar) {
+                    using V = Vec<T, isa>;
+                    constexpr std::size_t W = V::width;
+                    alignas(64) T value[W], index[W];
+                    T best[W];
+                    for (; j + W <= j1; j += W) {
+                        for (std::size_t r0 = 0; r0 < row; r0 += argmax_run) {
+                            std::size_t const r1 = std::min(row, r0 + argmax_run);
+                            typename V::type m = V::load(a + r0 * lda + j), k = V::zero(), x;
+                            for (std::size_t i = r0 + 1; i < r1; i++) {
+                                x = V::load(a + i * lda + j);
+                                k = V::select_gt(x, m, V::set1(static_cast<T>(i - r0)), k);
+                                m = V::select_gt(x, m, x, m);
+                            }
+                            V::store(value, m);
+                            V::store(index, k);
+                            for (std::size_t l = 0; l < W; l++) {
+                                if (r0 == 0 || best[l] < value[l]) {
+                                    best[l] = value[l];
+                                    out[j + l] = r0 + static_cast<std::size_t>(index[l]);
+                                }
+                            }
+                        }
+                    }
+                }
+#endif
+                for (; j < j1; j++) {
+                    T m = a[j];
+                    out[j] = 0;
+                    for (std::size_t i = 1; i < row; i++) {
+                        if (m < a[i * lda + j]) {
+                            m = a[i * lda + j];
+                            out[j] = i;
+                        }
+                    }
+                }
+            }
+        };
+
+        // rows of a tile over row x col elements, so that a tile holds about elementwise_parallel_cutoff of them
+        inline std::size_t reduce_grain(std::size_t col) {
+            return (elementwise_parallel_cutoff + col - 1) / std::max<std::size_t>(col, 1);
+        }
+
+        template<typename F, typename T>
+        T parallel_sum(std::size_t row, std::size_t col, T const *a, std::size_t lda, T shift, bool deterministic) {
+            auto const tile = [&](std::size_t begin, std::size_t end) {
+                return dispatch<SumKernel<F>, T>(begin, end, col, a, lda, shift);
+            };
+            auto const add = [](T x, T y) { return x + y; };
+            if (deterministic) {
+                return parallel_reduce_ordered(row, reduce_grain(col), static_cast<T>(0), tile, add);
+            }
+            return parallel_reduce(row, reduce_grain(col), static_cast<T>(0), tile, add);
+        }
+
+        // the extremum and the first row holding it
+        template<bool greatest, typename T>
+        std::pair<T, std::size_t> parallel_extremum(std::size_t row, std::size_t col, T const *a, std::size_t lda) {
+            assert(row > 0 && col > 0);
+            return parallel_reduce(row, reduce_grain(col), std::pair<T, std::size_t>(a[0], 0),
+                                   [&](std::size_t begin, std::size_t end) {
+                return dispatch<ExtremumKernel<greatest>, T>(begin, end, col, a, lda);
+            }, [](std::pair<T, std::size_t> const &x, std::pair<T, std::size_t> const &y) {
+                bool const better = greatest ? x.first < y.first : y.first < x.first;
+                return better || (x.first == y.first && y.second < x.second) ? y : x;
+            });
+        }
+
+        // Kernel<R> for the R given at run time
+        template<template<Reduction> class Kernel, typename T, typename ...Args>
+        void dispatch_reduction(Reduction r, Args ...args) {
+            switch (r) {
+                case Reduction::Sum:
+                    return dispatch<Kernel<Reduction::Sum>, T>(args...);
+                case Reduction::Max:
+                    return dispatch<Kernel<Reduction::Max>, T>(args...);
+                case Reduction::Min:
+                    return dispatch<Kernel<Reduction::Min>, T>(args...);
+                case Reduction::Norm1:
+                    return dispatch<Kernel<Reduction::Norm1>, T>(args...);
+                case Reduction::Norm2:
+                    return dispatch<Kernel<Reduction::Norm2>, T>(args...);
+                default:
+                    return dispatch<Kernel<Reduction::LogSumExp>, T>(args...);
+            }
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // r of the row x col block a with leading dimension lda; deterministic fixes the order of a sum
+    // whatever the thread count
+    template<typename T>
+    T reduce_block(Reduction r, std::size_t row, std::size_t col, T const *a, std::size_t lda,
+                   bool deterministic = false) {
+        BNN_PROFILE_SCOPE("reduce", -1, row * col, row * col * sizeof(T));
+        switch (r) {
+            case Reduction::Sum:
+                return detail::parallel_sum<detail::Plain>(row, col, a, lda, static_cast<T>(0), deterministic);
+            case Reduction::Max:
+                return detail::parallel_extremum<true>(row, col, a, lda).first;
+            case Reduction::Min:
+                return detail::parallel_extremum<false>(row, col, a, lda).first;
+            case Reduction::Norm1:
+                return detail::parallel_sum<detail::Absolute>(row, col, a, lda, static_cast<T>(0), deterministic);
+            case Reduction::Norm2:
+                return std::sqrt(detail::parallel_sum<detail::Square>(row, col, a, lda, static_cast<T>(0), deterministic));
+            default: {
+                T const m = detail::parallel_extremum<true>(row, col, a, lda).first;
+                return detail::finish<Reduction::LogSumExp>(
+                        std::isfinite(m) ? detail::parallel_sum<detail::ShiftedExp>(row, col, a, lda, m, deterministic) : m, m);
+            }
+        }
+    }
+
+    // out[i * inc] = r of row i
+    template<typename T>
+    void reduce_rows(Reduction r, std::size_t row, std::size_t col, T const *a, std::size_t lda, T *out,
+                     std::size_t inc) {
+        BNN_PROFILE_SCOPE("reduce.rows", -1, row * col, (row * col + row) * sizeof(T));
+        assert(col > 0 || r == Reduction::Sum || r == Reduction::Norm1 || r == Reduction::Norm2);
+        parallel_for(row, detail::reduce_grain(col), [&](std::size_t begin, std::size_t end) {
+            detail::dispatch_reduction<detail::RowKernel, T>(r, begin, end, col, a, lda, out, inc);
+        });
+    }
+
+    // out[j * inc] = r of column j; strided results go through a buffer
+    template<typename T>
+    void reduce_cols(Reduction r, std::size_t row, std::size_t col, T const *a, std::size_t lda, T *out,
+                     std::size_t inc) {
+        BNN_PROFILE_SCOPE("reduce.cols", -1, row * col, (row * col + col) * sizeof(T));
+        assert(row > 0 || r == Reduction::Sum || r == Reduction::Norm1 || r == Reduction::Norm2);
+        T *const dst = inc == 1 ? out : detail::pack_buffer<T, 7>(col);
+        // bands a multiple of 64 elements wide, as in evaluate
+        std::size_t const line = 64;
+        std::size_t const grain = (detail::elementwise_parallel_cutoff + row * line - 1) / std::max<std::size_t>(row * line, 1);
+        std::size_t const bands = (col + line - 1) / line;
+        parallel_for(bands, grain, [&](std::size_t begin, std::size_t end) {
+            detail::dispatch_reduction<detail::ColumnKernel, T>(r, row, begin * line, std::min(col, end * line), a, lda,
+                                                               dst);
+        });
+        if (inc != 1) {
+            for (std::size_t j = 0; j < col; j++) {
+                out[j * inc] = dst[j];
+            }
+        }
+    }
+
+    // row and column of the first largest element
+    template<typename T>
+    std::pair<std::size_t, std::size_t> argmax(std::size_t row, std::size_t col, T const *a, std::size_t lda) {
+        BNN_PROFILE_SCOPE("argmax", -1, row * col, row * col * sizeof(T));
+        auto const [m, i] = detail::parallel_extremum<true>(row, col, a, lda);
+        T const *src = a + i * lda;
+        std::size_t const j = static_cast<std::size_t>(std::find(src, src + col, m) - src);
+        return {i, j == col ? 0 : j};
+    }
+
+    // out[i] = column of the first largest element of row i
+    template<typename T>
+    void argmax_rows(std::size_t row, std::size_t col, T const *a, std::size_t lda, std::size_t *out) {
+        BNN_PROFILE_SCOPE("argmax.rows", -1, row * col, row * col * sizeof(T));
+        assert(col > 0);
+        parallel_for(row, detail::reduce_grain(col), [&](std::size_t begin, std::size_t end) {
+            dispatch<detail::ArgmaxRowKernel, T>(begin, end, col, a, lda, out);
+        });
+    }
+
+    // out[j] = row of the first largest element of column j, e.g. the class predicted for sample j
+    template<typename T>
+    void argmax_cols(std::size_t row, std::size_t col, T const *a, std::size_t lda, std::size_t *out) {
+        BNN_PROFILE_SCOPE("argmax.cols", -1, row * col, row * col * sizeof(T));
+        assert(row > 0);
+        std::size_t const line = 64;
+        std::size_t const grain = (detail::elementwise_parallel_cutoff + row * line - 1) / std::max<std::size_t>(row * line, 1);
+        std::size_t const bands = (col + line - 1) / line;
+        parallel_for(bands, grain, [&](std::size_t begin, std::size_t end) {
+            dispatch<detail::ArgmaxColumnKernel, T>(row, begin * line, std::min(col, end * line), a, lda, out);
+        });
+    }
+
+}
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef BNN_LinearAlgebra_Kernels_Simd_hpp
+#define BNN_LinearAlgebra_Kernels_Simd_hpp
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BNN_X86 1
+#include <immintrin.h>
+#else
+#define BNN_X86 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BNN_ALWAYS_INLINE __attribute__((always_inline)) inline
+#define BNN_RESTRICT __restrict__
+#else
+#define BNN_ALWAYS_INLINE inline
+#define BNN_RESTRICT
+#endif
+
+#if BNN_X86
+#define BNN_TARGET_AVX2 __attribute__((target("avx2,fma,f16c,popcnt")))
+#define BNN_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,fma,f16c,popcnt")))
+// AVX-512 with the byte instructions and VNNI, for the int8 kernels; see has_vnni
+#define BNN_TARGET_VNNI __attribute__((target("avx512f,avx512dq,avx512bw,avx512vnni,avx2,fma,f16c,popcnt")))
+#endif
+
+/*
+ * Instruction set detection and thin vector wrappers.
+ * Kernels are written once against Vec<T, Isa> as always-inline templates and
+ * instantiated from small target-attributed entry points, so one binary carries
+ * every variant and picks one at run time.
+ *
+ * Besides arithmetic, each Vec has select_gt(a, b, x, y) = a > b ? x : y, and pow2i(v) = 2^n
+ * for v = n + 1.5 * 2^23 (float) or n + 1.5 * 2^52 (double), i.e. an integer n held in the low
+ * mantissa bits; see Math.hpp.
+ *
+ * A kernel is a struct with
+ *     template<Isa isa, typename T> static BNN_ALWAYS_INLINE R run(Args...);
+ * and is called through dispatch<Kernel, T>(args...).
+ */
+
+namespace LinearAlgebra::Kernels {
+
+    enum class Isa : int {
+        Scalar = 0,
+        SSE = 1,
+        AVX2 = 2,
+        AVX512 = 3
+    };
+
+    inline char const *isa_name(Isa isa) {
+        switch (isa) {
+            case Isa::SSE:
+                return "sse";
+            case Isa::AVX2:
+                return "avx2";
+            case Isa::AVX512:
+                return "avx512";
+            default:
+                return "scalar";
+        }
+    }
+
+    // best instruction set supported by this cpu and os
+    inline Isa detected_isa() {
+        static Isa const isa = [] {
+#if BNN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+                __builtin_cpu_supports("f16c") && __builtin_cpu_supports("popcnt")) {
+                return Isa::AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c") &&
+                __builtin_cpu_supports("popcnt")) {
+                return Isa::AVX2;
+            }
+            if (__builtin_cpu_supports("sse2")) {
+                return Isa::SSE;
+            }
+#endif
+            return Isa::Scalar;
+        }();
+        return isa;
+    }
+
+    // instruction set used by the kernels; BNN_ISA=scalar|sse|avx2|avx512 may lower it
+    inline Isa active_isa() {
+        static Isa const isa = [] {
+            Isa const best = detected_isa();
+            char const *env = std::getenv("BNN_ISA");
+            if (env == nullptr) {
+                return best;
+            }
+            Isa wanted = best;
+            if (std::strcmp(env, "scalar") == 0) wanted = Isa::Scalar;
+            else if (std::strcmp(env, "sse") == 0) wanted = Isa::SSE;
+            else if (std::strcmp(env, "avx2") == 0) wanted = Isa::AVX2;
+            else if (std::strcmp(env, "avx512") == 0) wanted = Isa::AVX512;
+            return static_cast<int>(wanted) < static_cast<int>(best) ? wanted : best;
+        }();
+        return isa;
+    }
+
+    // whether the AVX-512 kernels may also use the byte instructions and VNNI (vpdpbusd), which not every
+    // AVX-512 cpu has
+    inline bool has_vnni() {
+#if BNN_X86
+        static bool const vnni = active_isa() == Isa::AVX512 && __builtin_cpu_supports("avx512bw") &&
+                                 __builtin_cpu_supports("avx512vnni");
+        return vnni;
+#else
+        return false;
+#endif
+    }
+
+    template<typename T, Isa isa>
+    struct Vec;
+
+#if BNN_X86
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+    template<>
+    struct Vec<float, Isa::SSE> {
+        using type = __m128;
+        static constexpr std::size_t width = 4;
+        static type zero() { return _mm_setzero_ps(); }
+        static type set1(float a) { return _mm_set1_ps(a); }
+        static type load(float const *p) { return _mm_loadu_ps(p); }
+        static void store(float *p, type a) { _mm_storeu_ps(p, a); }
+        static type add(type a, type b) { return _mm_add_ps(a, b); }
+        static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+        static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+        static type div(type a, type b) { return _mm_div_ps(a, b); }
+        static type fmadd(type a, type b, type c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static type max(type a, type b) { return _mm_max_ps(a, b); }
+        static type min(type a, type b) { return _mm_min_ps(a, b); }
+        static type sqrt(type a) { return _mm_sqrt_ps(a); }
+        static type select_gt(type a, type b, type x, type y) {
+            __m128 const m = _mm_cmpgt_ps(a, b);
+            return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y));
+        }
+        static type pow2i(type n) {
+            return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(n), _mm_set1_epi32(127)), 23));
+        }
+    };
+
+    template<>
+    struct Vec<double, Isa::SSE> {
+        using type = __m128d;
+        static constexpr std::size_t width = 2;
+        static type zero() { return _mm_setzero_pd(); }
+        static type set1(double a) { return _mm_set1_pd(a); }
+        static type load(double const *p) { return _mm_loadu_pd(p); }
+        static void store(double *p, type a) { _mm_storeu_pd(p, a); }
+        static type add(type a, type b) { return _mm_add_pd(a, b); }
+        static type sub(type a, type b) { return _mm_sub_pd(a, b); }
+        static type mul(type a, type b) { return _mm_mul_pd(a, b); }
+        static type div(type a, type b) { return _mm_div_pd(a, b); }
+        static type fmadd(type a, type b, type c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static type max(type a, type b) { return _mm_max_pd(a, b); }
+        static type min(type a, type b) { return _mm_min_pd(a, b); }
+        static type sqrt(type a) { return _mm_sqrt_pd(a); }
+        static type select_gt(type a, type b, type x, type y) {
+            __m128d const m = _mm_cmpgt_pd(a, b);
+            return _mm_or_pd(_mm_and_pd(m, x), _mm_andnot_pd(m, y));
+        }
+        static type pow2i(type n) {
+            return _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(_mm_castpd_si128(n), _mm_set1_epi64x(1023)), 52));
+        }
+    };
+
+    template<>
+    struct Vec<float, Isa::AVX2> {
+        using type = __m256;
+        static constexpr std::size_t width = 8;
+        BNN_TARGET_AVX2 static type zero() { return _mm256_setzero_ps(); }
+        BNN_TARGET_AVX2 static type set1(float a) { return _mm256_set1_ps(a); }
+        BNN_TARGET_AVX2 static type load(float const *p) { return _mm256_loadu_ps(p); }
+        BNN_TARGET_AVX2 static void store(float *p, type a) { _mm256_storeu_ps(p, a); }
+        BNN_TARGET_AVX2 static type add(type a, type b) { return _mm256_add_ps(a, b); }
+        BNN_TARGET_AVX2 static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+        BNN_TARGET_AVX2 static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+        BNN_TARGET_AVX2 static type div(type a, type b) { return _mm256_div_ps(a, b); }
+        BNN_TARGET_AVX2 static type fmadd(type a, type b, type c) { return _mm256_fmadd_ps(a, b, c); }
+        BNN_TARGET_AVX2 static type max(type a, type b) { return _mm256_max_ps(a, b); }
+        BNN_TARGET_AVX2 static type min(type a, type b) { return _mm256_min_ps(a, b); }
+        BNN_TARGET_AVX2 static type sqrt(type a) { return _mm256_sqrt_ps(a); }
+        BNN_TARGET_AVX2 static type select_gt(type a, type b, type x, type y) {
+            return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_GT_OQ));
+        }
+        BNN_TARGET_AVX2 static type pow2i(type n) {
+            return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_castps_si256(n), _mm256_set1_epi32(127)), 23));
+        }
+    };
+
+    template<>
+    struct Vec<double, Isa::AVX2> {
+        using type = __m256d;
+        static constexpr std::size_t width = 4;
+        BNN_TARGET_AVX2 static type zero() { return _mm256_setzero_pd(); }
+        BNN_TARGET_AVX2 static type set1(double a) { return _mm256_set1_pd(a); }
+        BNN_TARGET_AVX2 static type load(double const *p) { return _mm256_loadu_pd(p); }
+        BNN_TARGET_AVX2 static void store(double *p, type a) { _mm256_storeu_pd(p, a); }
+        BNN_TARGET_AVX2 static type add(type a, type b) { return _mm256_add_pd(a, b); }
+        BNN_TARGET_AVX2 static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+        BNN_TARGET_AVX2 static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+        BNN_TARGET_AVX2 static type div(type a, type b) { return _mm256_div_pd(a, b); }
+        BNN_TARGET_AVX2 static type fmadd(type a, type b, type c) { return _mm256_fmadd_pd(a, b, c); }
+        BNN_TARGET_AVX2 static type max(type a, type b) { return _mm256_max_pd(a, b); }
+        BNN_TARGET_AVX2 static type min(type a, type b) { return _mm256_min_pd(a, b); }
+        BNN_TARGET_AVX2 static type sqrt(type a) { return _mm256_sqrt_pd(a); }
+        BNN_TARGET_AVX2 static type select_gt(type a, type b, type x, type y) {
+            return _mm256_blendv_pd(y, x, _mm256_cmp_pd(a, b, _CMP_GT_OQ));
+        }
+        BNN_TARGET_AVX2 static type pow2i(type n) {
+            return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(n), _mm256_set1_epi64x(1023)), 52));
+        }
+    };
+
+    template<>
+    struct Vec<float, Isa::AVX512> {
+        using type = __m512;
+        static constexpr std::size_t width = 16;
+        BNN_TARGET_AVX512 static type zero() { return _mm512_setzero_ps(); }
+        BNN_TARGET_AVX512 static type set1(float a) { return _mm512_set1_ps(a); }
+        BNN_TARGET_AVX512 static type load(float const *p) { return _mm512_loadu_ps(p); }
+        BNN_TARGET_AVX512 static void store(float *p, type a) { _mm512_storeu_ps(p, a); }
+        BNN_TARGET_AVX512 static type add(type a, type b) { return _mm512_add_ps(a, b); }
+        BNN_TARGET_AVX512 static type sub(type a, type b) { return _mm512_sub_ps(a, b); }
+        BNN_TARGET_AVX512 static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+        BNN_TARGET_AVX512 static type div(type a, type b) { return _mm512_div_ps(a, b); }
+        BNN_TARGET_AVX512 static type fmadd(type a, type b, type c) { return _mm512_fmadd_ps(a, b, c); }
+        BNN_TARGET_AVX512 static type max(type a, type b) { return _mm512_max_ps(a, b); }
+        BNN_TARGET_AVX512 static type min(type a, type b) { return _mm512_min_ps(a, b); }
+        BNN_TARGET_AVX512 static type sqrt(type a) { return _mm512_sqrt_ps(a); }
+        BNN_TARGET_AVX512 static type select_gt(type a, type b, type x, type y) {
+            return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), y, x);
+        }
+        BNN_TARGET_AVX512 static type pow2i(type n) {
+            return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_castps_si512(n), _mm512_set1_epi32(127)), 23));
+        }
+    };
+
+    template<>
+    struct Vec<double, Isa::AVX512> {
+        using type = __m512d;
+        static constexpr std::size_t width = 8;
+        BNN_TARGET_AVX512 static type zero() { return _mm512_setzero_pd(); }
+        BNN_TARGET_AVX512 static type set1(double a) { return _mm512_set1_pd(a); }
+        BNN_TARGET_AVX512 static type load(double const *p) { return _mm512_loadu_pd(p); }
+        BNN_TARGET_AVX512 static void store(double *p, type a) { _mm512_storeu_pd(p, a); }
+        BNN_TARGET_AVX512 static type add(type a, type b) { return _mm512_add_pd(a, b); }
+        BNN_TARGET_AVX512 static type sub(type a, type b) { return _mm512_sub_pd(a, b); }
+        BNN_TARGET_AVX512 static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+        BNN_TARGET_AVX512 static type div(type a, type b) { return _mm512_div_pd(a, b); }
+        BNN_TARGET_AVX512 static type fmadd(type a, type b, type c) { return _mm512_fmadd_pd(a, b, c); }
+        BNN_TARGET_AVX512 static type max(type a, type b) { return _mm512_max_pd(a, b); }
+        BNN_TARGET_AVX512 static type min(type a, type b) { return _mm512_min_pd(a, b); }
+        BNN_TARGET_AVX512 static type sqrt(type a) { return _mm512_sqrt_pd(a); }
+        BNN_TARGET_AVX512 static type select_gt(type a, type b, type x, type y) {
+            return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_GT_OQ), y, x);
+        }
+        BNN_TARGET_AVX512 static type pow2i(type n) {
+            return _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(n), _mm512_set1_epi64(1023)), 52));
+        }
+    };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+    // scalar types that have vector kernels
+    template<typename T>
+    constexpr bool has_vec_v = std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+    namespace detail {
+#if BNN_X86
+        template<typename F, typename T, typename ...Args>
+        decltype(auto) run_sse(Args ...args) {
+            return F::template run<Isa::SSE, T>(args...);
+        }
+
+        template<typename F, typename T, typename ...Args>
+        BNN_TARGET_AVX2 decltype(auto) run_avx2(Args ...args) {
+            return F::template run<Isa::AVX2, T>(args...);
+        }
+
+        template<typename F, typename T, typename ...Args>
+        BNN_TARGET_AVX512 decltype(auto) run_avx512(Args ...args) {
+            return F::template run<Isa::AVX512, T>(args...);
+        }
+#endif
+    }
+
+    // runs F::run<isa, T>(args...) with the best instruction set available for T
+    template<typename F, typename T, typename ...Args>
+    decltype(auto) dispatch(Args ...args) {
+#if BNN_X86
+        if constexpr (has_vec_v<T>) {
+            switch (active_isa()) {
+                case Isa::AVX512:
+                    return detail::run_avx512<F, T>(args...);
+                case Isa::AVX2:
+                    return detail::run_avx2<F, T>(args...);
+                case Isa::SSE:
+                    return detail::run_sse<F, T>(args...);
+                default:
+                    break;
+            }
+        }
+#endif
+        return F::template run<Isa::Scalar, T>(args...);
+    }
+
+}
+
+#endif
@@ -6,55 +6,153 @@
 #include <cassert>
 #include <iostream>
 #include <random>
+#include <type_traits>
+#include "Arena.hpp"
+#include "Expression.hpp"
+#include "MatrixView.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "Kernels/Gemm.hpp"
+#include "Kernels/Elementwise.hpp"
 #include "../Ops/Operators/Operator.hpp"
 
 namespace LinearAlgebra {
 
+    // extent of a Matrix dimension known only at run time
+    inline constexpr std::size_t Dynamic = static_cast<std::size_t>(-1);
+
+    // Matrix<T> is sized at run time; Matrix<T, R, C> has its size fixed at compile time (FixedMatrix.hpp)
+    template<typename T, std::size_t R = Dynamic, std::size_t C = Dynamic>
+    class Matrix;
+
+    // op over whole matrices: map for a unary operator, zip for a binomial one, evaluated into a new Matrix;
+    // namespace-level templates so that several Matrix types can share a translation unit
+    template<typename Op, typename E, enable_if_expression_t<E> = 0>
+    auto compute(Op const &op, E &&e) {
+        return Matrix<value_t<E> >(map(op, std::forward<E>(e)));
+    }
+
+    template<typename Op, typename L, typename R, enable_if_expressions_t<L, R> = 0>
+    auto compute(Op const &op, L &&lhs, R &&rhs) {
+        return Matrix<value_t<L> >(zip(op, std::forward<L>(lhs), std::forward<R>(rhs)));
+    }
+
+    // op folded over every element of e from identity, vectorized and threaded like an assignment;
+    // op must be associative and commutative
+    template<typename Op, typename E, enable_if_expression_t<E> = 0>
+    value_t<E> reduce(Op const &op, value_t<E> identity, E const &e) {
+        return Kernels::reduce(op, identity, e, e.get_row(), e.get_col());
+    }
+
     template<typename T>
-    class Matrix {
+    class Matrix<T, Dynamic, Dynamic> : public Expression<Matrix<T> > {
         // pointer that stores matrix
         T *mat;
-        // size of matrix
-        std::size_t row, col;
+        // size of matrix, and distance between the starts of consecutive rows
+        std::size_t row, col, ld;
+        // number of elements mat can hold
+        std::size_t capacity;
+        // arena active when the matrix was created, nullptr for the heap
+        Arena *arena;
+
+        // plain scalars get 64-byte aligned storage, from the arena when there is one
+        static constexpr bool raw_storage = std::is_trivial_v<T>;
+
+        // rows of at least padding_threshold bytes are padded to whole cache lines so each starts aligned;
+        // narrower matrices (vectors in particular) stay dense
+        static constexpr std::size_t padding_threshold = 8 * storage_alignment;
+
+        // make room for size elements; the contents are not kept
+        void reserve(std::size_t size) {
+            if (size <= capacity) {
+                return;
+            }
+            release();
+            if constexpr (raw_storage) {
+                if (arena != nullptr) {
+                    mat = static_cast<T *>(arena->allocate(size * sizeof(T)));
+                }
+                if (mat == nullptr) {
+                    mat = static_cast<T *>(::operator new(size * sizeof(T), std::align_val_t(storage_alignment)));
+                    heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+                }
+            } else {
+                mat = new T[size];
+                heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+            }
+            capacity = size;
+        }
+
+        void release() {
+            if (mat != nullptr && (arena == nullptr || !arena->owns(mat))) {
+                if constexpr (raw_storage) {
+                    ::operator delete(mat, std::align_val_t(storage_alignment));
+                } else {
+                    delete[] mat;
+                }
+            }
+            mat = nullptr;
+            capacity = 0;
+        }
+
+        // set the shape, keeping the buffer when it is large enough
+        void reshape(std::size_t row, std::size_t col) {
+            std::size_t const ld = padded(col);
+            reserve(row * ld);
+            this->row = row, this->col = col, this->ld = ld;
+        }
 
     public:
+        using value_type = T;
+
+        // leading dimension a matrix with col columns gets
+        static std::size_t padded(std::size_t col) {
+            constexpr std::size_t line = sizeof(T) < storage_alignment ? storage_alignment / sizeof(T) : 1;
+            if (!raw_storage || col * sizeof(T) < padding_threshold) {
+                return col;
+            }
+            return (col + line - 1) / line * line;
+        }
+
         // constructors
-        Matrix() : row(0), col(0), mat(nullptr) {}
+        Matrix() : row(0), col(0), ld(0), mat(nullptr), capacity(0), arena(Arena::current()) {}
 
         Matrix(std::size_t row, std::size_t col)
-                : row(row), col(col), mat(new T[row * col]) {}
+                : row(0), col(0), ld(0), mat(nullptr), capacity(0), arena(Arena::current()) {
+            reshape(row, col);
+        }
 
         Matrix(std::size_t row, std::size_t col, std::random_device &rd, T mean = 0, T stdv = 1)
-                : row(row), col(col), mat(new T[row * col]) {
+                : Matrix(row, col) {
             assert(row != 0 && col != 0);
             std::default_random_engine e1(rd());
             std::normal_distribution<T> normal_dist(mean, stdv);
-            for(std::size_t i = 0; i < row * col; i++) {
-                mat[i] = static_cast<T>(normal_dist(e1));
+            for(std::size_t i = 0; i < row; i++) {
+                for(std::size_t j = 0; j < col; j++) {
+                    mat[i * ld + j] = static_cast<T>(normal_dist(e1));
+                }
             }
         }
 
         explicit Matrix(std::size_t row, std::size_t col, T constant)
-                : row(row), col(col), mat(new T[row * col]) {
+                : Matrix(row, col) {
             assert(row != 0 && col != 0);
-            for(std::size_t i = 0; i < row * col; i++) {
-                mat[i] = constant;
-            }
+            fill(constant);
         }
 
         explicit Matrix(std::size_t row, std::size_t col, T *arr)
-                : row(row), col(col), mat(new T[row * col]) {
+                : Matrix(row, col) {
             assert(row != 0 && col != 0);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                mat[i] = arr[i];
+            // arr is dense
+            for (std::size_t i = 0; i < row; i++) {
+                std::copy(arr + i * col, arr + (i + 1) * col, mat + i * ld);
             }
         }
 
         // TODO : PLEASE USE STATIC CONSTRUCTORS. Below is the example.
         static Matrix<T> Constant(std::size_t row, std::size_t col, T constant) {
             Matrix<T> M(row, col);
-            std::fill(M.mat, M.mat + row * col, constant);
+            M.fill(constant);
             return M;
         }
         static Matrix<T> Zeros(std::size_t row, std::size_t col) {
@@ -66,228 +164,127 @@ namespace LinearAlgebra {
 
         // copy constructor
         Matrix(Matrix const &matrix)
-                : row(matrix.row), col(matrix.col), mat(new T[matrix.row * matrix.col]) {
-            std::copy(matrix.mat, matrix.mat + matrix.row * matrix.col, mat);
+                : Matrix(matrix.row, matrix.col) {
+            copy_from(matrix);
         }
 
         // move constructor
         Matrix(Matrix &&matrix) noexcept
-                : row(matrix.row), col(matrix.col), mat(matrix.mat) {
+                : row(matrix.row), col(matrix.col), ld(matrix.ld), mat(matrix.mat), capacity(matrix.capacity),
+                  arena(matrix.arena) {
             matrix.mat = nullptr;
+            matrix.capacity = 0;
         }
 
-        // copy assignment
+        // copy assignment, reuses the buffer when it is large enough
         Matrix &operator=(Matrix const &matrix) {
             if (&matrix != this) {
-                row = matrix.row, col = matrix.col;
-                delete[] mat;
-                mat = new T[row * col];
-                std::copy(matrix.mat, matrix.mat + row * col, mat);
+                reshape(matrix.row, matrix.col);
+                copy_from(matrix);
             }
             return *this;
         }
 
-        // move assignment
-        Matrix &operator=(Matrix &&matrix) noexcept {
-            row = matrix.row, col = matrix.col;
+        // move assignment; storage from another allocator is copied so that each matrix keeps its own
+        Matrix &operator=(Matrix &&matrix) {
+            if (arena != matrix.arena) {
+                return *this = static_cast<Matrix const &>(matrix);
+            }
+            row = matrix.row, col = matrix.col, ld = matrix.ld;
             std::swap(mat, matrix.mat);
+            std::swap(capacity, matrix.capacity);
             return *this;
         }
 
-    public:
-        // compute function
-        template<typename FuncOut, std::size_t size, typename ...Ts>
-        friend FuncOut compute(Operators::OperatorBase<FuncOut, size> const &op, Ts &&...Is) {
-            return op(std::forward<Ts>(Is)...);
-        }
-
-    protected:
-        // elementary functions made virtual
-        virtual Matrix add(Matrix const &matrix) const {
-            assert(row == matrix.row && col == matrix.col);
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] + matrix.mat[i];
-            }
-            return M;
-        }
-
-        virtual Matrix add(T const &scalar) const {
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] + scalar;
-            }
-            return M;
-        }
-
-        virtual Matrix subtract(Matrix const &matrix) const {
-            assert(row == matrix.row && col == matrix.col);
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] - matrix.mat[i];
-            }
-            return M;
-        }
-
-        virtual Matrix subtract(T const &scalar) const {
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] - scalar;
+        void copy_from(Matrix const &matrix) {
+            for (std::size_t i = 0; i < row; i++) {
+                std::copy(matrix.mat + i * matrix.ld, matrix.mat + i * matrix.ld + col, mat + i * ld);
             }
-            return M;
         }
 
+    protected:
+        // matrix product, the one operation that is always materialized
         virtual Matrix multiply(Matrix const &matrix) const {
             assert(col == matrix.row);
             //Matrix<T> M(row, matrix.col, static_cast<T>(0));
             auto M = Matrix<T>::Zeros(row, matrix.col);
-            for (std::size_t i = 0; i < row; i++) {
-                for (std::size_t j = 0; j < col; j++) {
-                    for (std::size_t k = 0; k < matrix.col; k++) {
-                        M.mat[i * matrix.col + k] += mat[i * col + j] * matrix.mat[j * matrix.col + k];
-                    }
-                }
-            }
-            return M;
-        }
-
-        virtual Matrix multiply(T const &scalar) const {
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] * scalar;
-            }
-            return M;
-        }
-
-        virtual Matrix elementwise_multiply(Matrix const &matrix) const {
-            assert(row == matrix.row && col == matrix.col);
-            Matrix<T> M(row, col);
-            std::size_t size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] * matrix.mat[i];
-            }
+            Kernels::gemm(row, matrix.col, col, mat, ld, matrix.mat, matrix.ld, M.mat, M.ld);
             return M;
         }
 
-        virtual Matrix divide(T const &scalar) const {
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] / scalar;
-            }
-            return M;
-        }
-
-        virtual Matrix elementwise_divide(Matrix const &matrix) const {
-            assert(row == matrix.row && col == matrix.col);
-            Matrix<T> M(row, col);
-            std::size_t size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = mat[i] / matrix.mat[i];
-            }
-            return M;
+        // one fused pass over an elementwise expression; operands may alias *this
+        template<typename E>
+        void evaluate(Expression<E> const &expression) {
+            E const &e = expression.self();
+            reshape(e.get_row(), e.get_col());
+            Kernels::evaluate(e, row, col, mat, ld);
         }
 
     public:
-        // operators
-        Matrix operator-() const {
-            Matrix<T> M(row, col);
-            std::size_t const size = row * col;
-            for (std::size_t i = 0; i < size; i++) {
-                M.mat[i] = -mat[i];
-            }
-            return M;
-        }
-
-        friend Matrix<T> operator+(Matrix<T> const &A, Matrix<T> const &B) {
-            return A.add(B);
+        // evaluate an elementwise expression
+        template<typename E>
+        Matrix(Expression<E> const &expression) : Matrix() {
+            evaluate(expression);
         }
 
-        Matrix &operator+=(Matrix<T> &&A) {
-            return *this = *this + A;
-        }
-
-        friend Matrix<T> operator+(Matrix<T> const &A, T const &b) {
-            return A.add(b);
+        template<typename E>
+        Matrix &operator=(Expression<E> const &expression) {
+            evaluate(expression);
+            return *this;
         }
 
-        friend Matrix<T> operator+(T const &a, Matrix const &B) {
-            return B.add(a);
+        // operators; elementwise ones live in Expression.hpp and are evaluated lazily
+        template<typename E>
+        Matrix &operator+=(Expression<E> const &A) {
+            return *this = *this + A.self();
         }
 
-        Matrix &operator+=(T &&a) {
+        Matrix &operator+=(T const &a) {
             return *this = *this + a;
         }
 
-        friend Matrix<T> operator-(Matrix<T> const &A, Matrix<T> const &B) {
-            return A.subtract(B);
-        }
-
-        Matrix &operator-=(Matrix<T> &&A) {
-            return *this = *this - A;
-        }
-
-        friend Matrix<T> operator-(Matrix<T> const &A, T const &b) {
-            return A.subtract(b);
+        template<typename E>
+        Matrix &operator-=(Expression<E> const &A) {
+            return *this = *this - A.self();
         }
 
-        Matrix &operator-=(T &&a) {
+        Matrix &operator-=(T const &a) {
             return *this = *this - a;
         }
 
-        friend Matrix<T> operator-(T const &a, Matrix<T> const &B) {
-            return -(B.subtract(a));
-        }
-
         friend Matrix<T> operator*(Matrix<T> const &A, Matrix<T> const &B) {
             return A.multiply(B);
         }
 
-        Matrix &operator*=(Matrix &&A) {
+        Matrix &operator*=(Matrix const &A) {
             return *this = *this * A;
         }
 
-        friend Matrix<T> operator*(Matrix<T> const &A, T const &b) {
-            return A.multiply(b);
-        }
-
-        friend Matrix<T> operator*(T const &a, Matrix<T> const &B) {
-            return B.multiply(a);
-        }
-
-        Matrix &operator*=(T &&a) {
+        Matrix &operator*=(T const &a) {
             return *this = *this * a;
         }
 
-        friend Matrix<T> operator/(Matrix<T> const &A, T const &b) {
-            return A.divide(b);
-        }
-
-        Matrix operator/=(T &&a) {
+        Matrix &operator/=(T const &a) {
             return *this = *this / a;
         }
 
         // basic operations only for matrix
-        friend Matrix<T> elementwise_multiplied(Matrix<T> const &A, Matrix<T> const &B) {
-            return A.elementwise_multiply(B);
-        }
-
         virtual Matrix &elementwise_multiply(Matrix<T> &&A) {
             return *this = elementwise_multiplied(*this, A);
         }
 
         virtual Matrix transposed() const {
+            BNN_PROFILE_SCOPE("transposed", -1, 0, 2 * row * col * sizeof(T));
             Matrix M(col, row);
-            for(std::size_t j = 0; j < col; j++) {
-                for(std::size_t i = 0; i < row; i++) {
-                    M.mat[j * row + i] = mat[i * col + j];
+            // bands of rows of M on the shared pool once the copy is large enough
+            std::size_t const grain = (Kernels::detail::elementwise_parallel_cutoff + row - 1) / std::max<std::size_t>(row, 1);
+            parallel_for(col, grain, [&](std::size_t begin, std::size_t end) {
+                for(std::size_t j = begin; j < end; j++) {
+                    for(std::size_t i = 0; i < row; i++) {
+                        M.mat[j * M.ld + i] = mat[i * ld + j];
+                    }
                 }
-            }
+            });
             return M;
         }
         [[deprecated]] virtual Matrix &transpose() {
@@ -296,43 +293,110 @@ namespace LinearAlgebra {
 
         // get max and min element
         T const get_max() const {
-            auto max = mat[0];
-            for(std::size_t i = 1; i < row * col; i++) {
-                if(max < mat[i]) {
-                    max = mat[i];
-                }
-            }
-            return max;
+            return LinearAlgebra::max(view());
         }
         T const get_min() const {
-            auto min = mat[0];
-            for(std::size_t i = 1; i < row * col; i++) {
-                if(min < mat[i]) {
-                    min = mat;
-                }
-            }
-            return min;
+            return LinearAlgebra::min(view());
         }
 
         // index
         T constexpr &operator()(std::size_t r, std::size_t c) const {
-            return mat[r * col + c];
+            return mat[r * ld + c];
         }
         T &operator()(std::size_t r, std::size_t c) {
-            return mat[r * col + c];
+            return mat[r * ld + c];
         }
 
+        // packet of elements (r, c) .. (r, c + width - 1) for vectorized evaluation
+        static constexpr bool vectorizable = true;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+        template<Kernels::Isa isa>
+        BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c, typename Kernels::Vec<T, isa>::type &out) const {
+            out = Kernels::Vec<T, isa>::load(mat + r * ld + c);
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
         // out stream operator
         friend std::ostream &operator<<(std::ostream &os, Matrix<T> const &matrix) {
             for (std::size_t i = 0; i < matrix.row; i++) {
                 for (std::size_t j = 0; j < matrix.col; j++) {
-                    os << matrix.mat[i * matrix.col + j] << ' ';
+                    os << matrix.mat[i * matrix.ld + j] << ' ';
                 }
                 os << '\n';
             }
             return os;
         }
 
+        // change the shape, keeping the buffer when it is large enough; the contents are unspecified
+        void resize(std::size_t row, std::size_t col) {
+            reshape(row, col);
+        }
+
+        void fill(T const &value) {
+            for (std::size_t i = 0; i < row; i++) {
+                std::fill(mat + i * ld, mat + i * ld + col, value);
+            }
+        }
+
+        // raw row-major storage, get_ld() elements per row
+        T *data() {
+            return mat;
+        }
+        T const *data() const {
+            return mat;
+        }
+
+        // non-owning views, valid until the matrix is resized or destroyed
+        MatrixView<T> view() {
+            return MatrixView<T>(mat, row, col, ld);
+        }
+        MatrixView<T const> view() const {
+            return MatrixView<T const>(mat, row, col, ld);
+        }
+        operator MatrixView<T>() {
+            return view();
+        }
+        operator MatrixView<T const>() const {
+            return view();
+        }
+
+        MatrixView<T> block(std::size_t r, std::size_t c, std::size_t rows, std::size_t cols) {
+            return view().block(r, c, rows, cols);
+        }
+        MatrixView<T const> block(std::size_t r, std::size_t c, std::size_t rows, std::size_t cols) const {
+            return view().block(r, c, rows, cols);
+        }
+        MatrixView<T> row_block(std::size_t first, std::size_t count) {
+            return view().row_block(first, count);
+        }
+        MatrixView<T const> row_block(std::size_t first, std::size_t count) const {
+            return view().row_block(first, count);
+        }
+        MatrixView<T> col_block(std::size_t first, std::size_t count) {
+            return view().col_block(first, count);
+        }
+        MatrixView<T const> col_block(std::size_t first, std::size_t count) const {
+            return view().col_block(first, count);
+        }
+        MatrixView<T> row_view(std::size_t r) {
+            return view().row_view(r);
+        }
+        MatrixView<T const> row_view(std::size_t r) const {
+            return view().row_view(r);
+        }
+        MatrixView<T> col_view(std::size_t c) {
+            return view().col_view(c);
+        }
+        MatrixView<T const> col_view(std::size_t c) const {
+            return view().col_view(c);
+        }
+
         // get row
         constexpr std::size_t get_row() const {
             return row;
@@ -341,12 +405,40 @@ namespace LinearAlgebra {
         constexpr std::size_t get_col() const {
             return col;
         }
+        // get leading dimension
+        constexpr std::size_t get_ld() const {
+            return ld;
+        }
 
         // destructor
         virtual ~Matrix() {
-            delete[] mat;
+            release();
         }
     };
 
+    template<typename X>
+    struct is_matrix : std::false_type {};
+    template<typename T>
+    struct is_matrix<Matrix<T> > : std::true_type {};
+
+    template<typename X>
+    struct is_fixed_matrix : std::false_type {};
+    template<typename T, std::size_t R, std::size_t C>
+    struct is_fixed_matrix<Matrix<T, R, C> > : std::bool_constant<R != Dynamic && C != Dynamic> {};
+
+    // products involving anything else than two Matrix<T> or two fixed-size matrices
+    // are carried out on dynamic copies
+    template<typename L, typename R, std::enable_if_t<is_expression_v<L> && is_expression_v<R> &&
+                                                      !(is_matrix<std::decay_t<L> >::value &&
+                                                        is_matrix<std::decay_t<R> >::value) &&
+                                                      !(is_fixed_matrix<std::decay_t<L> >::value &&
+                                                        is_fixed_matrix<std::decay_t<R> >::value), int> = 0>
+    Matrix<value_t<L> > operator*(L &&lhs, R &&rhs) {
+        return Matrix<value_t<L> >(lhs) * Matrix<value_t<R> >(rhs);
+    }
+
 }
+
+#include "FixedMatrix.hpp"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,297 @@
+#ifndef BNN_LinearAlgebra_MatrixView_hpp
+#define BNN_LinearAlgebra_MatrixView_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Expression.hpp"
+#include "Kernels/Gemm.hpp"
+#include "Kernels/Elementwise.hpp"
+#include "Kernels/Blas.hpp"
+#include "Kernels/Reduce.hpp"
+
+namespace LinearAlgebra {
+
+    /*
+     * Non-owning, row-major window into someone else's storage: element (r, c) is ptr[r * ld + c].
+     * A view behaves like a pointer: copying or assigning one rebinds it, and the elements it
+     * covers are written with assign() or the compound operators.
+     * MatrixView<T const> is the read-only flavour, and every MatrixView<T> converts to it.
+     */
+    template<typename T>
+    class MatrixView : public Expression<MatrixView<T> > {
+        T *ptr;
+        // size of the window, and distance between the starts of consecutive rows
+        std::size_t row, col, ld;
+
+    public:
+        using value_type = std::remove_const_t<T>;
+
+        // constructors
+        MatrixView() : ptr(nullptr), row(0), col(0), ld(0) {}
+
+        MatrixView(T *ptr, std::size_t row, std::size_t col, std::size_t ld)
+                : ptr(ptr), row(row), col(col), ld(ld) {
+            assert(ld >= col || row <= 1);
+        }
+
+        MatrixView(T *ptr, std::size_t row, std::size_t col)
+                : MatrixView(ptr, row, col, col) {}
+
+        MatrixView(MatrixView const &) = default;
+        MatrixView &operator=(MatrixView const &) = default;
+
+        template<typename U, std::enable_if_t<std::is_same_v<U const, T> && !std::is_same_v<U, T>, int> = 0>
+        MatrixView(MatrixView<U> const &view)
+                : MatrixView(view.data(), view.get_row(), view.get_col(), view.get_ld()) {}
+
+        // write an expression into the covered elements; operands may only alias it element for element
+        template<typename E>
+        MatrixView const &assign(Expression<E> const &expression) const {
+            static_assert(!std::is_const_v<T>, "In MatrixView: cannot assign through a read-only view!");
+            E const &e = expression.self();
+            assert(e.get_row() == row && e.get_col() == col);
+            Kernels::evaluate(e, row, col, ptr, ld);
+            return *this;
+        }
+
+        template<typename E>
+        MatrixView const &operator+=(Expression<E> const &A) const {
+            return assign(*this + A.self());
+        }
+
+        template<typename E>
+        MatrixView const &operator-=(Expression<E> const &A) const {
+            return assign(*this - A.self());
+        }
+
+        MatrixView const &operator*=(value_type const &a) const {
+            return assign(*this * a);
+        }
+
+        // slicing, all zero-copy
+        MatrixView block(std::size_t r, std::size_t c, std::size_t rows, std::size_t cols) const {
+            assert(r + rows <= row && c + cols <= col);
+            return MatrixView(ptr + r * ld + c, rows, cols, ld);
+        }
+        MatrixView row_block(std::size_t first, std::size_t count) const {
+            return block(first, 0, count, col);
+        }
+        MatrixView col_block(std::size_t first, std::size_t count) const {
+            return block(0, first, row, count);
+        }
+        MatrixView row_view(std::size_t r) const {
+            return block(r, 0, 1, col);
+        }
+        MatrixView col_view(std::size_t c) const {
+            return block(0, c, row, 1);
+        }
+
+        MatrixView view() const {
+            return *this;
+        }
+
+        // index
+        T &operator()(std::size_t r, std::size_t c) const {
+            return ptr[r * ld + c];
+        }
+
+        static constexpr bool vectorizable = true;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+        template<Kernels::Isa isa>
+        BNN_ALWAYS_INLINE void packet(std::size_t r, std::size_t c, typename Kernels::Vec<value_type, isa>::type &out) const {
+            out = Kernels::Vec<value_type, isa>::load(ptr + r * ld + c);
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        T *data() const {
+            return ptr;
+        }
+
+        // rows are packed back to back, so the elements form one run
+        bool is_contiguous() const {
+            return ld == col || row <= 1;
+        }
+
+        std::size_t get_row() const {
+            return row;
+        }
+        std::size_t get_col() const {
+            return col;
+        }
+        std::size_t get_ld() const {
+            return ld;
+        }
+    };
+
+    template<typename X>
+    using const_view_t = MatrixView<value_t<X> const>;
+
+    template<typename ...X>
+    using enable_if_views_t = std::enable_if_t<(is_expression_v<X> && ...), int>;
+
+    // BLAS-style products on anything with a view(): Matrix, MatrixView and their slices.
+    // They accumulate into an existing output and read transposed operands in place.
+
+    // C = alpha * op(A) * op(B) + beta * C; A and B may hold bfloat16 or float16 when C holds float
+    template<typename A, typename B, typename C, enable_if_views_t<C> = 0>
+    void gemm(Transpose transA, Transpose transB, value_t<C> alpha, A const &a, B const &b,
+              value_t<C> beta, C &&c) {
+        const_view_t<A> const va = a.view();
+        const_view_t<B> const vb = b.view();
+        auto vc = c.view();
+        std::size_t const m = transA == Transpose::NoTrans ? va.get_row() : va.get_col();
+        std::size_t const k = transA == Transpose::NoTrans ? va.get_col() : va.get_row();
+        std::size_t const n = transB == Transpose::NoTrans ? vb.get_col() : vb.get_row();
+        assert(k == (transB == Transpose::NoTrans ? vb.get_row() : vb.get_col()));
+        assert(vc.get_row() == m && vc.get_col() == n);
+        if constexpr (std::is_same_v<value_t<A>, value_t<C> > && std::is_same_v<value_t<B>, value_t<C> >) {
+            if (n == 1 && vb.is_contiguous() && vc.is_contiguous()) {
+                Kernels::gemv(transA, va.get_row(), va.get_col(), alpha, va.data(), va.get_ld(), vb.data(), beta,
+                              vc.data());
+                return;
+            }
+        }
+        Kernels::gemm(transA, transB, m, n, k, alpha, va.data(), va.get_ld(), vb.data(), vb.get_ld(),
+                      beta, vc.data(), vc.get_ld());
+    }
+
+    // y = alpha * op(A) * x + beta * y, where x and y are row or column vectors
+    template<typename A, typename X, typename Y, enable_if_views_t<A, X, Y> = 0>
+    void gemv(Transpose transA, value_t<Y> alpha, A const &a, X const &x, value_t<Y> beta, Y &&y) {
+        using T = value_t<Y>;
+        static_assert(std::is_same_v<value_t<A>, T> && std::is_same_v<value_t<X>, T>,
+                      "In gemv: A, x and y must hold the same type!");
+        const_view_t<A> const va = a.view();
+        const_view_t<X> const vx = x.view();
+        auto vy = y.view();
+        std::size_t const n = transA == Transpose::NoTrans ? va.get_col() : va.get_row();
+        std::size_t const m = transA == Transpose::NoTrans ? va.get_row() : va.get_col();
+        assert(vx.get_row() * vx.get_col() == n && vy.get_row() * vy.get_col() == m);
+        if (vx.is_contiguous() && vy.is_contiguous()) {
+            Kernels::gemv(transA, va.get_row(), va.get_col(), alpha, va.data(), va.get_ld(), vx.data(), beta, vy.data());
+            return;
+        }
+        // strided vectors go through gemm as single columns
+        std::size_t const incx = vx.get_col() == 1 ? vx.get_ld() : 1;
+        std::size_t const incy = vy.get_col() == 1 ? vy.get_ld() : 1;
+        for (std::size_t i = 0; i < m; i++) {
+            vy.data()[i * incy] = beta == static_cast<T>(0) ? static_cast<T>(0) : beta * vy.data()[i * incy];
+        }
+        Kernels::gemm(transA, Transpose::NoTrans, m, 1, n, alpha, va.data(), va.get_ld(), vx.data(), incx,
+                      static_cast<T>(1), vy.data(), incy);
+    }
+
+    // A += alpha * x * y^T, where x and y are row or column vectors
+    template<typename X, typename Y, typename A, enable_if_views_t<X, Y, A> = 0>
+    void ger(value_t<A> alpha, X const &x, Y const &y, A &&a) {
+        static_assert(std::is_same_v<value_t<X>, value_t<A> > && std::is_same_v<value_t<Y>, value_t<A> >,
+                      "In ger: x, y and A must hold the same type!");
+        const_view_t<X> const vx = x.view();
+        const_view_t<Y> const vy = y.view();
+        auto va = a.view();
+        assert(vx.get_row() * vx.get_col() == va.get_row() && vy.get_row() * vy.get_col() == va.get_col());
+        if (vx.is_contiguous() && vy.is_contiguous()) {
+            Kernels::ger(va.get_row(), va.get_col(), alpha, vx.data(), vy.data(), va.data(), va.get_ld());
+            return;
+        }
+        std::size_t const incx = vx.get_col() == 1 ? vx.get_ld() : 1;
+        std::size_t const incy = vy.get_col() == 1 ? vy.get_ld() : 1;
+        Kernels::gemm(Transpose::NoTrans, Transpose::Trans, va.get_row(), va.get_col(), 1, alpha,
+                      vx.data(), incx, vy.data(), incy, static_cast<value_t<A> >(1), va.data(), va.get_ld());
+    }
+
+
+    // reductions on anything with a view(); deterministic sums give the same result for any thread count
+
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> sum(A const &a, bool deterministic = false) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::Sum, va.get_row(), va.get_col(), va.data(), va.get_ld(), deterministic);
+    }
+
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> max(A const &a) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::Max, va.get_row(), va.get_col(), va.data(), va.get_ld());
+    }
+
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> min(A const &a) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::Min, va.get_row(), va.get_col(), va.data(), va.get_ld());
+    }
+
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> norm1(A const &a, bool deterministic = false) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::Norm1, va.get_row(), va.get_col(), va.data(), va.get_ld(), deterministic);
+    }
+
+    // the Frobenius norm
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> norm2(A const &a, bool deterministic = false) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::Norm2, va.get_row(), va.get_col(), va.data(), va.get_ld(), deterministic);
+    }
+
+    template<typename A, enable_if_views_t<A> = 0>
+    value_t<A> log_sum_exp(A const &a, bool deterministic = false) {
+        const_view_t<A> const va = a.view();
+        return Kernels::reduce_block(Reduction::LogSumExp, va.get_row(), va.get_col(), va.data(), va.get_ld(),
+                                     deterministic);
+    }
+
+    // row and column of the first largest element
+    template<typename A, enable_if_views_t<A> = 0>
+    std::pair<std::size_t, std::size_t> argmax(A const &a) {
+        const_view_t<A> const va = a.view();
+        return Kernels::argmax(va.get_row(), va.get_col(), va.data(), va.get_ld());
+    }
+
+    // y(i) = r of row i of A, where y is a row or column vector
+    template<typename A, typename Y, enable_if_views_t<A, Y> = 0>
+    void reduce_rows(Reduction r, A const &a, Y &&y) {
+        static_assert(std::is_same_v<value_t<A>, value_t<Y> >, "In reduce_rows: A and y must hold the same type!");
+        const_view_t<A> const va = a.view();
+        auto vy = y.view();
+        assert(vy.get_row() * vy.get_col() == va.get_row());
+        Kernels::reduce_rows(r, va.get_row(), va.get_col(), va.data(), va.get_ld(), vy.data(),
+                             vy.get_col() == 1 ? vy.get_ld() : 1);
+    }
+
+    // y(j) = r of column j of A, where y is a row or column vector
+    template<typename A, typename Y, enable_if_views_t<A, Y> = 0>
+    void reduce_cols(Reduction r, A const &a, Y &&y) {
+        static_assert(std::is_same_v<value_t<A>, value_t<Y> >, "In reduce_cols: A and y must hold the same type!");
+        const_view_t<A> const va = a.view();
+        auto vy = y.view();
+        assert(vy.get_row() * vy.get_col() == va.get_col());
+        Kernels::reduce_cols(r, va.get_row(), va.get_col(), va.data(), va.get_ld(), vy.data(),
+                             vy.get_col() == 1 ? vy.get_ld() : 1);
+    }
+
+    // out[i] = column of the first largest element of row i
+    template<typename A, enable_if_views_t<A> = 0>
+    void argmax_rows(A const &a, std::size_t *out) {
+        const_view_t<A> const va = a.view();
+        Kernels::argmax_rows(va.get_row(), va.get_col(), va.data(), va.get_ld(), out);
+    }
+
+    // out[j] = row of the first largest element of column j
+    template<typename A, enable_if_views_t<A> = 0>
+    void argmax_cols(A const &a, std::size_t *out) {
+        const_view_t<A> const va = a.view();
+        Kernels::argmax_cols(va.get_row(), va.get_col(), va.data(), va.get_ld(), out);
+    }
+
+}
+
+#endif
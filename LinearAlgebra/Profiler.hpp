@@ -0,0 +1,226 @@
+#ifndef BNN_LinearAlgebra_Profiler_hpp
+#define BNN_LinearAlgebra_Profiler_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Arena.hpp"
+
+/*
+ * Instrumentation of the training hot path, compiled in when BNN_PROFILE is defined and out to nothing otherwise.
+ * BNN_PROFILE_SCOPE(name, layer, flops, bytes) times the rest of the enclosing block as one span: a static name
+ * such as "gemm" or "forward.activation", the weight layer it belongs to (-1 for none), the floating point
+ * operations and bytes it covers, and the Matrix heap blocks taken meanwhile (by any thread). Spans nest, so a
+ * layer's span includes the gemm span inside it.
+ * Nothing is recorded until Profiler::instance().start(); each thread then appends to a log of its own, without
+ * locking. summary() and write_trace() read every log and must not run while spans are being recorded;
+ * write_trace() writes the Chrome trace_event format, for chrome://tracing or ui.perfetto.dev.
+ */
+
+namespace LinearAlgebra {
+
+    class Profiler {
+        using Clock = std::chrono::steady_clock;
+
+    public:
+        struct Span {
+            char const *name;
+            int layer;
+            // nanoseconds since the profiler was created
+            std::int64_t start, duration;
+            double flops, bytes;
+            std::size_t allocations;
+        };
+
+    private:
+        // the spans of one thread, numbered in the order threads first recorded
+        struct Log {
+            std::size_t thread;
+            std::vector<Span> spans;
+        };
+
+        std::atomic<bool> recording;
+        Clock::time_point const epoch;
+        mutable std::mutex mutex;
+        std::vector<std::shared_ptr<Log> > logs;
+
+        Profiler() : recording(false), epoch(Clock::now()) {}
+
+        Log &log() {
+            thread_local std::shared_ptr<Log> mine;
+            if (!mine) {
+                std::lock_guard<std::mutex> lock(mutex);
+                mine = std::make_shared<Log>(Log{logs.size(), {}});
+                logs.push_back(mine);
+            }
+            return *mine;
+        }
+
+    public:
+        Profiler(Profiler const &) = delete;
+        Profiler &operator=(Profiler const &) = delete;
+
+        static Profiler &instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // whether BNN_PROFILE_SCOPE records anything in this build
+        static constexpr bool compiled() {
+#ifdef BNN_PROFILE
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void start() {
+            recording.store(true, std::memory_order_relaxed);
+        }
+        void stop() {
+            recording.store(false, std::memory_order_relaxed);
+        }
+        bool active() const {
+            return recording.load(std::memory_order_relaxed);
+        }
+
+        // drop every span recorded so far
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto const &log : logs) {
+                log->spans.clear();
+            }
+        }
+
+        std::int64_t now() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+        }
+
+        void record(Span const &span) {
+            log().spans.push_back(span);
+        }
+
+        // every span of every thread, with the thread it ran on
+        std::vector<std::pair<std::size_t, Span> > spans() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::pair<std::size_t, Span> > ret;
+            for (auto const &log : logs) {
+                for (Span const &span : log->spans) {
+                    ret.emplace_back(log->thread, span);
+                }
+            }
+            return ret;
+        }
+
+        // one line per name and layer, slowest first: calls, total time, throughput and heap blocks per call;
+        // nested spans count towards their parents too
+        void summary(std::ostream &os) const {
+            struct Total {
+                std::size_t calls = 0, allocations = 0;
+                double seconds = 0, flops = 0, bytes = 0;
+            };
+            std::map<std::pair<std::string, int>, Total> totals;
+            for (auto const &[thread, span] : spans()) {
+                Total &t = totals[{span.name, span.layer}];
+                t.calls++;
+                t.seconds += static_cast<double>(span.duration) / 1e9;
+                t.flops += span.flops;
+                t.bytes += span.bytes;
+                t.allocations += span.allocations;
+            }
+            std::vector<std::pair<std::pair<std::string, int>, Total> > rows(totals.begin(), totals.end());
+            std::stable_sort(rows.begin(), rows.end(), [](auto const &a, auto const &b) {
+                return a.second.seconds > b.second.seconds;
+            });
+            char line[160];
+            std::snprintf(line, sizeof line, "%-24s %5s %9s %12s %9s %9s %12s\n", "span", "layer", "calls", "total ms",
+                          "GFLOP/s", "GB/s", "allocs/call");
+            os << line;
+            for (auto const &[key, t] : rows) {
+                std::string const layer = key.second < 0 ? "-" : std::to_string(key.second);
+                double const seconds = std::max(t.seconds, 1e-12);
+                std::snprintf(line, sizeof line, "%-24s %5s %9zu %12.3f %9.2f %9.2f %12.2f\n", key.first.c_str(),
+                              layer.c_str(), t.calls, t.seconds * 1e3, t.flops / seconds / 1e9, t.bytes / seconds / 1e9,
+                              static_cast<double>(t.allocations) / static_cast<double>(t.calls));
+                os << line;
+            }
+        }
+
+        // write every span as a complete ("X") trace event to path; false when the file cannot be written
+        bool write_trace(std::string const &path) const {
+            std::FILE *file = std::fopen(path.c_str(), "w");
+            if (file == nullptr) {
+                return false;
+            }
+            std::fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+            bool first = true;
+            for (auto const &[thread, span] : spans()) {
+                std::fprintf(file, "%s\n  {\"name\": \"%s\", \"cat\": \"bnn\", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, "
+                                   "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"layer\": %d, \"flops\": %.0f, "
+                                   "\"bytes\": %.0f, \"allocations\": %zu}}",
+                             first ? "" : ",", span.name, thread, static_cast<double>(span.start) / 1e3,
+                             static_cast<double>(span.duration) / 1e3, span.layer, span.flops, span.bytes,
+                             span.allocations);
+                first = false;
+            }
+            std::fprintf(file, "\n]}\n");
+            return std::fclose(file) == 0;
+        }
+
+        // records the time from construction to destruction as one span, while the profiler is active
+        class Scope {
+            char const *name;
+            int layer;
+            double flops, bytes;
+            std::int64_t start;
+            std::size_t allocations;
+            bool active;
+
+        public:
+            Scope(char const *name, int layer, double flops, double bytes)
+                    : name(name), layer(layer), flops(flops), bytes(bytes), start(0), allocations(0),
+                      active(instance().active()) {
+                if (active) {
+                    allocations = heap_allocations();
+                    start = instance().now();
+                }
+            }
+
+            Scope(Scope const &) = delete;
+            Scope &operator=(Scope const &) = delete;
+
+            ~Scope() {
+                if (active) {
+                    Profiler &profiler = instance();
+                    profiler.record({name, layer, start, profiler.now() - start, flops, bytes,
+                                     heap_allocations() - allocations});
+                }
+            }
+        };
+    };
+
+}
+
+#define BNN_PROFILE_CONCAT_(a, b) a##b
+#define BNN_PROFILE_CONCAT(a, b) BNN_PROFILE_CONCAT_(a, b)
+
+#ifdef BNN_PROFILE
+#define BNN_PROFILE_SCOPE(name, layer, flops, bytes)                                                          \
+    ::LinearAlgebra::Profiler::Scope BNN_PROFILE_CONCAT(bnn_profile_scope_, __LINE__)(                        \
+            name, static_cast<int>(layer), static_cast<double>(flops), static_cast<double>(bytes))
+#else
+// the arguments are not evaluated
+#define BNN_PROFILE_SCOPE(name, layer, flops, bytes) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef BNN_LinearAlgebra_ThreadPool_hpp
+#define BNN_LinearAlgebra_ThreadPool_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Persistent work-stealing pool shared by the library.
+ * run(tasks, f) calls f(0) ... f(tasks - 1) across the pool's threads and the caller, and returns
+ * once all of them are done; the threads live as long as the pool, so a call costs a wake-up
+ * rather than a spawn. Every thread starts on its own contiguous share of the tasks and, once
+ * that runs dry, steals the upper half of whatever another thread has left.
+ * A run() issued from inside a task executes serially on that thread, so kernels called from
+ * parallel code never oversubscribe the cores.
+ *
+ * parallel_for and parallel_reduce split a loop into tiles for the shared pool, and keep loops
+ * shorter than their grain serial.
+ */
+
+namespace LinearAlgebra {
+
+    class ThreadPool {
+        struct Job {
+            void (*invoke)(void *, std::size_t);
+            void *context;
+            std::size_t tasks;
+        };
+
+        // tasks [begin, end) not yet taken from one thread's share, the caller's being slots[0]
+        struct alignas(64) Slot {
+            std::mutex lock;
+            std::size_t begin = 0, end = 0;
+        };
+
+        std::vector<std::thread> threads;
+        std::unique_ptr<Slot[]> slots;
+        // serializes run() calls from outside the pool, and resizing
+        std::mutex submitting;
+        std::mutex mutex;
+        std::condition_variable wake, finished;
+        Job job;
+        std::atomic<std::size_t> remaining;
+        // workers that picked up the current job and have not let go of it yet
+        std::size_t busy;
+        std::size_t generation;
+        bool stopping;
+
+        static bool &inside() {
+            thread_local bool flag = false;
+            return flag;
+        }
+
+        bool pop(std::size_t self, std::size_t &task) {
+            std::lock_guard<std::mutex> lock(slots[self].lock);
+            if (slots[self].begin == slots[self].end) {
+                return false;
+            }
+            task = slots[self].begin++;
+            return true;
+        }
+
+        bool steal(std::size_t self, std::size_t &task) {
+            std::size_t const count = size();
+            for (std::size_t i = 1; i < count; i++) {
+                Slot &victim = slots[(self + i) % count];
+                std::size_t first, last;
+                {
+                    std::lock_guard<std::mutex> lock(victim.lock);
+                    if (victim.begin == victim.end) {
+                        continue;
+                    }
+                    last = victim.end;
+                    first = last - (last - victim.begin + 1) / 2;
+                    victim.end = first;
+                }
+                // only the owner refills its own slot, and it is empty here
+                std::lock_guard<std::mutex> lock(slots[self].lock);
+                slots[self].begin = first + 1;
+                slots[self].end = last;
+                task = first;
+                return true;
+            }
+            return false;
+        }
+
+        void drain(std::size_t self, Job const &current) {
+            std::size_t task;
+            while (pop(self, task) || steal(self, task)) {
+                current.invoke(current.context, task);
+                if (remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+
+        void work(std::size_t self, std::size_t seen) {
+            inside() = true;
+            for (;;) {
+                Job current;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&] { return stopping || generation != seen; });
+                    if (stopping) {
+                        return;
+                    }
+                    seen = generation;
+                    current = job;
+                    busy++;
+                }
+                drain(self, current);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0) {
+                    finished.notify_all();
+                }
+            }
+        }
+
+        void start(std::size_t threads) {
+            slots.reset(new Slot[std::max<std::size_t>(threads, 1)]);
+            for (std::size_t i = 1; i < threads; i++) {
+                this->threads.emplace_back([this, i, seen = generation] { work(i, seen); });
+            }
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+            stopping = false;
+        }
+
+    public:
+        // threads counts the caller, so threads - 1 are started
+        explicit ThreadPool(std::size_t threads)
+                : job{nullptr, nullptr, 0}, remaining(0), busy(0), generation(0), stopping(false) {
+            start(threads);
+        }
+
+        ThreadPool(ThreadPool const &) = delete;
+        ThreadPool &operator=(ThreadPool const &) = delete;
+
+        ~ThreadPool() {
+            stop();
+        }
+
+        // BNN_THREADS if set, one per hardware thread otherwise
+        static std::size_t default_threads() {
+            if (char const *env = std::getenv("BNN_THREADS")) {
+                long const threads = std::strtol(env, nullptr, 10);
+                if (threads > 0) {
+                    return static_cast<std::size_t>(threads);
+                }
+            }
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // the pool every part of the library shares
+        static ThreadPool &instance() {
+            static ThreadPool pool(default_threads());
+            return pool;
+        }
+
+        // threads that run tasks, the caller included
+        std::size_t size() const {
+            return threads.size() + 1;
+        }
+
+        // restart with another number of threads; waits for a run in progress
+        void resize(std::size_t threads) {
+            std::lock_guard<std::mutex> submit(submitting);
+            stop();
+            start(std::max<std::size_t>(threads, 1));
+        }
+
+        template<typename F>
+        void run(std::size_t tasks, F &&f) {
+            if (tasks <= 1 || threads.empty() || inside()) {
+                for (std::size_t i = 0; i < tasks; i++) {
+                    f(i);
+                }
+                return;
+            }
+            using Function = std::remove_reference_t<F>;
+            std::lock_guard<std::mutex> submit(submitting);
+            Job const current{[](void *context, std::size_t i) { (*static_cast<Function *>(context))(i); },
+                              const_cast<void *>(static_cast<void const *>(&f)), tasks};
+            {
+                // a worker that woke late for the previous job may still hold it
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&] { return busy == 0; });
+                std::size_t const count = size();
+                for (std::size_t i = 0; i < count; i++) {
+                    std::lock_guard<std::mutex> slot(slots[i].lock);
+                    slots[i].begin = tasks * i / count;
+                    slots[i].end = tasks * (i + 1) / count;
+                }
+                job = current;
+                remaining = tasks;
+                generation++;
+            }
+            wake.notify_all();
+            inside() = true;
+            drain(0, current);
+            inside() = false;
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return remaining == 0; });
+        }
+    };
+
+    // threads of the shared pool, the calling one included
+    inline void set_threads(std::size_t threads) {
+        ThreadPool::instance().resize(threads);
+    }
+    inline std::size_t get_threads() {
+        return ThreadPool::instance().size();
+    }
+
+    namespace detail {
+        // a few tiles per thread leave room for stealing to even out the load
+        constexpr std::size_t tiles_per_thread = 4;
+        constexpr std::size_t max_tiles = 256;
+
+        inline std::size_t tile_count(std::size_t count, std::size_t grain) {
+            std::size_t const wanted = std::min(tiles_per_thread * ThreadPool::instance().size(), max_tiles);
+            return std::max<std::size_t>(1, std::min((count + grain - 1) / std::max<std::size_t>(grain, 1), wanted));
+        }
+    }
+
+    // f(begin, end) over tiles of [0, count) holding at least grain items each
+    template<typename F>
+    void parallel_for(std::size_t count, std::size_t grain, F &&f) {
+        std::size_t const tiles = count < 2 * grain ? 1 : detail::tile_count(count, grain);
+        if (tiles == 1) {
+            f(std::size_t(0), count);
+            return;
+        }
+        ThreadPool::instance().run(tiles, [&](std::size_t t) {
+            f(count * t / tiles, count * (t + 1) / tiles);
+        });
+    }
+
+    // combine(... combine(combine(identity, f(tile 0)), f(tile 1)) ...) over the same tiles as parallel_for,
+    // in tile order, so a given count, grain and thread count always give the same result
+    template<typename R, typename F, typename C>
+    R parallel_reduce(std::size_t count, std::size_t grain, R identity, F &&f, C &&combine) {
+        std::size_t const tiles = count < 2 * grain ? 1 : detail::tile_count(count, grain);
+        if (tiles == 1) {
+            return combine(identity, f(std::size_t(0), count));
+        }
+        R partial[detail::max_tiles];
+        ThreadPool::instance().run(tiles, [&](std::size_t t) {
+            partial[t] = f(count * t / tiles, count * (t + 1) / tiles);
+        });
+        R ret = identity;
+        for (std::size_t t = 0; t < tiles; t++) {
+            ret = combine(ret, partial[t]);
+        }
+        return ret;
+    }
+
+    // the same with tiles that depend on count and grain alone, combined pairwise, so the result does not
+    // depend on the thread count either
+    template<typename R, typename F, typename C>
+    R parallel_reduce_ordered(std::size_t count, std::size_t grain, R identity, F &&f, C &&combine) {
+        std::size_t const tiles = count < 2 * grain ? 1 : std::min((count + grain - 1) / std::max<std::size_t>(grain, 1),
+                                                                   detail::max_tiles);
+        if (tiles == 1) {
+            return combine(identity, f(std::size_t(0), count));
+        }
+        R partial[detail::max_tiles];
+        ThreadPool::instance().run(tiles, [&](std::size_t t) {
+            partial[t] = f(count * t / tiles, count * (t + 1) / tiles);
+        });
+        for (std::size_t step = 1; step < tiles; step *= 2) {
+            for (std::size_t t = 0; t + step < tiles; t += 2 * step) {
+                partial[t] = combine(partial[t], partial[t + step]);
+            }
+        }
+        return combine(identity, partial[0]);
+    }
+
+}
+
+#endif
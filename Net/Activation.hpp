@@ -0,0 +1,359 @@
+#ifndef BNN_Net_Activation_hpp
+#define BNN_Net_Activation_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/MatrixView.hpp"
+#include "../LinearAlgebra/Kernels/Gemm.hpp"
+#include "../LinearAlgebra/Kernels/Math.hpp"
+
+/*
+ * Built-in activation functions with vectorized, in-place kernels.
+ * Each one has a forward pass a = f(z), which may overwrite z, and a fused backward pass
+ * g = g * f'(z) that reads the stored output a instead of recomputing anything from z.
+ * Matrices hold one sample per column; softmax normalizes each column.
+ * Custom activations are the network's own CustomActivation functions, built from elementwise operators
+ * or from functions of a whole matrix.
+ */
+
+namespace Net {
+
+    enum class Activation {
+        Identity,
+        ReLU,
+        Sigmoid,
+        Tanh,
+        Softmax,
+        // user supplied function and derivative, see NeuralNet and CustomActivation
+        Custom
+    };
+
+    namespace Activations {
+
+        using LinearAlgebra::Kernels::Isa;
+        using LinearAlgebra::Kernels::Vec;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // elementwise functions: forward and backward on one element and on one register in place
+
+        struct Identity {
+            template<typename T>
+            static T forward(T z) { return z; }
+            template<typename T>
+            static T backward(T, T g) { return g; }
+
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void forward(P &) {}
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void backward(P const &, P &) {}
+        };
+
+        struct ReLU {
+            template<typename T>
+            static T forward(T z) { return z > 0 ? z : 0; }
+            template<typename T>
+            static T backward(T a, T g) { return a > 0 ? g : 0; }
+
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void forward(P &z) {
+                z = Vec<T, isa>::max(z, Vec<T, isa>::zero());
+            }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void backward(P const &a, P &g) {
+                using V = Vec<T, isa>;
+                g = V::select_gt(a, V::zero(), g, V::zero());
+            }
+        };
+
+        // 1 / (1 + e^-z), derivative a (1 - a)
+        struct Sigmoid {
+            template<typename T>
+            static T forward(T z) { return 1 / (1 + LinearAlgebra::Kernels::detail::exp(-z)); }
+            template<typename T>
+            static T backward(T a, T g) { return g * a * (1 - a); }
+
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void forward(P &z) {
+                using V = Vec<T, isa>;
+                typename V::type const one = V::set1(1);
+                z = V::sub(V::zero(), z);
+                LinearAlgebra::Kernels::detail::exp<T, isa>(z);
+                z = V::div(one, V::add(one, z));
+            }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void backward(P const &a, P &g) {
+                using V = Vec<T, isa>;
+                g = V::mul(g, V::mul(a, V::sub(V::set1(1), a)));
+            }
+        };
+
+        // 1 - 2 / (e^2z + 1), which saturates cleanly at +-1; derivative 1 - a^2
+        struct Tanh {
+            template<typename T>
+            static T forward(T z) { return 1 - 2 / (LinearAlgebra::Kernels::detail::exp(2 * z) + 1); }
+            template<typename T>
+            static T backward(T a, T g) { return g * (1 - a * a); }
+
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void forward(P &z) {
+                using V = Vec<T, isa>;
+                typename V::type const one = V::set1(1);
+                z = V::add(z, z);
+                LinearAlgebra::Kernels::detail::exp<T, isa>(z);
+                z = V::sub(one, V::div(V::set1(2), V::add(z, one)));
+            }
+            template<Isa isa, typename T, typename P>
+            static BNN_ALWAYS_INLINE void backward(P const &a, P &g) {
+                using V = Vec<T, isa>;
+                g = V::mul(g, V::sub(V::set1(1), V::mul(a, a)));
+            }
+        };
+
+        // a(i, j) = F(z(i, j)) over a row x col block
+        template<typename F>
+        struct ForwardKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T const *z, std::size_t ldz,
+                                              T *a, std::size_t lda) {
+                for (std::size_t i = 0; i < row; i++) {
+                    T const *src = z + i * ldz;
+                    T *dst = a + i * lda;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type p = V::load(src + j);
+                            F::template forward<isa, T>(p);
+                            V::store(dst + j, p);
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        dst[j] = F::forward(src[j]);
+                    }
+                }
+            }
+        };
+
+        // g(i, j) = g(i, j) * F'(z(i, j)), written in terms of a = F(z)
+        template<typename F>
+        struct BackwardKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T const *a, std::size_t lda,
+                                              T *g, std::size_t ldg) {
+                for (std::size_t i = 0; i < row; i++) {
+                    T const *out = a + i * lda;
+                    T *grad = g + i * ldg;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const p = V::load(out + j);
+                            typename V::type q = V::load(grad + j);
+                            F::template backward<isa, T>(p, q);
+                            V::store(grad + j, q);
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        grad[j] = F::backward(out[j], grad[j]);
+                    }
+                }
+            }
+        };
+
+        // column-wise softmax, vectorized across columns since those are contiguous;
+        // scratch holds 2 * col elements
+        struct SoftmaxForwardKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T const *z, std::size_t ldz,
+                                              T *a, std::size_t lda, T *scratch) {
+                T *max = scratch, *sum = scratch + col;
+                std::copy(z, z + col, max);
+                std::fill(sum, sum + col, static_cast<T>(0));
+                for (std::size_t i = 1; i < row; i++) {
+                    for (std::size_t j = 0; j < col; j++) {
+                        max[j] = std::max(max[j], z[i * ldz + j]);
+                    }
+                }
+                for (std::size_t i = 0; i < row; i++) {
+                    T const *src = z + i * ldz;
+                    T *dst = a + i * lda;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type p = V::sub(V::load(src + j), V::load(max + j));
+                            LinearAlgebra::Kernels::detail::exp<T, isa>(p);
+                            V::store(dst + j, p);
+                            V::store(sum + j, V::add(V::load(sum + j), p));
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        dst[j] = LinearAlgebra::Kernels::detail::exp(src[j] - max[j]);
+                        sum[j] += dst[j];
+                    }
+                }
+                for (std::size_t j = 0; j < col; j++) {
+                    sum[j] = 1 / sum[j];
+                }
+                for (std::size_t i = 0; i < row; i++) {
+                    T *dst = a + i * lda;
+                    for (std::size_t j = 0; j < col; j++) {
+                        dst[j] *= sum[j];
+                    }
+                }
+            }
+        };
+
+        // g = a * (g - sum_i(g * a)) per column, the softmax Jacobian applied to g
+        struct SoftmaxBackwardKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T const *a, std::size_t lda,
+                                              T *g, std::size_t ldg, T *scratch) {
+                T *dot = scratch;
+                std::fill(dot, dot + col, static_cast<T>(0));
+                for (std::size_t i = 0; i < row; i++) {
+                    for (std::size_t j = 0; j < col; j++) {
+                        dot[j] += g[i * ldg + j] * a[i * lda + j];
+                    }
+                }
+                for (std::size_t i = 0; i < row; i++) {
+                    for (std::size_t j = 0; j < col; j++) {
+                        g[i * ldg + j] = a[i * lda + j] * (g[i * ldg + j] - dot[j]);
+                    }
+                }
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+        template<typename F, typename T>
+        void forward(LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> a) {
+            LinearAlgebra::Kernels::dispatch<ForwardKernel<F>, T>(z.get_row(), z.get_col(), z.data(), z.get_ld(),
+                                                                  a.data(), a.get_ld());
+        }
+
+        template<typename F, typename T>
+        void backward(LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T> g) {
+            LinearAlgebra::Kernels::dispatch<BackwardKernel<F>, T>(a.get_row(), a.get_col(), a.data(), a.get_ld(),
+                                                                   g.data(), g.get_ld());
+        }
+
+    }
+
+    // a = f(z); a and z may be the same matrix
+    template<typename T>
+    void activate(Activation activation, LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> a) {
+        assert(z.get_row() == a.get_row() && z.get_col() == a.get_col());
+        switch (activation) {
+            case Activation::Identity:
+                if (z.data() != a.data()) {
+                    a.assign(z);
+                }
+                break;
+            case Activation::ReLU:
+                Activations::forward<Activations::ReLU>(z, a);
+                break;
+            case Activation::Sigmoid:
+                Activations::forward<Activations::Sigmoid>(z, a);
+                break;
+            case Activation::Tanh:
+                Activations::forward<Activations::Tanh>(z, a);
+                break;
+            case Activation::Softmax: {
+                T *scratch = LinearAlgebra::Kernels::detail::pack_buffer<T, 2>(2 * z.get_col());
+                LinearAlgebra::Kernels::dispatch<Activations::SoftmaxForwardKernel, T>(
+                        z.get_row(), z.get_col(), z.data(), z.get_ld(), a.data(), a.get_ld(), scratch);
+                break;
+            }
+            default:
+                assert(false && "In activate: Custom activations are CustomActivation functions!");
+        }
+    }
+
+    // g = g * f'(z), given the output a = f(z)
+    template<typename T>
+    void activate_backward(Activation activation, LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T> g) {
+        assert(g.get_row() == a.get_row() && g.get_col() == a.get_col());
+        switch (activation) {
+            case Activation::Identity:
+                break;
+            case Activation::ReLU:
+                Activations::backward<Activations::ReLU>(a, g);
+                break;
+            case Activation::Sigmoid:
+                Activations::backward<Activations::Sigmoid>(a, g);
+                break;
+            case Activation::Tanh:
+                Activations::backward<Activations::Tanh>(a, g);
+                break;
+            case Activation::Softmax: {
+                T *scratch = LinearAlgebra::Kernels::detail::pack_buffer<T, 2>(2 * a.get_col());
+                LinearAlgebra::Kernels::dispatch<Activations::SoftmaxBackwardKernel, T>(
+                        a.get_row(), a.get_col(), a.data(), a.get_ld(), g.data(), g.get_ld(), scratch);
+                break;
+            }
+            default:
+                assert(false && "In activate_backward: Custom activations are CustomActivation functions!");
+        }
+    }
+
+    // a Custom activation on a whole layer: a = f(z), where a may be z itself; or for its derivative,
+    // g = g * f'(z). Every matrix has the same shape
+    template<typename T>
+    using CustomActivation = std::function<void(LinearAlgebra::MatrixView<T const>, LinearAlgebra::MatrixView<T>)>;
+
+    // f and f' as Operators::UnaryOperator on one element, run through LinearAlgebra::map in one fused loop
+    // over the thread pool, and on whole registers when their functors are vectorizable
+    template<typename T, typename F>
+    CustomActivation<T> custom_activation(Operators::UnaryOperator<F> f) {
+        return [f](LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> a) {
+            a.assign(LinearAlgebra::map(f, z));
+        };
+    }
+
+    template<typename T, typename F>
+    CustomActivation<T> custom_derivative(Operators::UnaryOperator<F> df) {
+        return [df](LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> g) {
+            g.assign(elementwise_multiplied(g, LinearAlgebra::map(df, z)));
+        };
+    }
+
+    // f and f' as functions of a whole matrix returning a new one; empty stays empty
+    template<typename T>
+    CustomActivation<T> custom_activation(std::function<LinearAlgebra::Matrix<T>(LinearAlgebra::Matrix<T> const &)> f) {
+        if (!f) {
+            return nullptr;
+        }
+        return [f = std::move(f)](LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> a) {
+            a.assign(f(LinearAlgebra::Matrix<T>(z)));
+        };
+    }
+
+    template<typename T>
+    CustomActivation<T> custom_derivative(std::function<LinearAlgebra::Matrix<T>(LinearAlgebra::Matrix<T> const &)> df) {
+        if (!df) {
+            return nullptr;
+        }
+        return [df = std::move(df)](LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T> g) {
+            g.assign(elementwise_multiplied(g, df(LinearAlgebra::Matrix<T>(z))));
+        };
+    }
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef BNN_Net_Binary_hpp
+#define BNN_Net_Binary_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include "../LinearAlgebra/BitMatrix.hpp"
+#include "../LinearAlgebra/MatrixView.hpp"
+
+/*
+ * Binarized weight layers, as in XNOR-Net.
+ * A binarized layer multiplies by sign(w) scaled per output by the mean |w| of that output's weights,
+ * the scale that best approximates w in the least squares sense, and may binarize its input to
+ * sign(a) as well. sign(0) is +1, matching BitMatrix.
+ * Training keeps real-valued latent weights and differentiates straight through the signs: the
+ * gradient with respect to the binarized weights is applied to the latent ones, which stay clipped
+ * to [-1, 1], and the gradient with respect to a binarized input is passed on where |a| <= 1 and
+ * cancelled beyond, where sign no longer follows a.
+ */
+
+namespace Net {
+
+    enum class Binarization {
+        // real weights and inputs
+        None,
+        // sign weights times a scale per output, real inputs
+        Weights,
+        // sign weights and sign inputs, multiplied with XNOR and popcount
+        Full
+    };
+
+    // scale(o) = mean |w(:, o)| for the weights w(in x out) of a layer, scale a column of out
+    template<typename T>
+    void binary_scale(LinearAlgebra::MatrixView<T const> w, LinearAlgebra::MatrixView<T> scale) {
+        assert(scale.get_row() == w.get_col() && scale.get_col() == 1);
+        for (std::size_t o = 0; o < w.get_col(); o++) {
+            scale(o, 0) = 0;
+        }
+        for (std::size_t r = 0; r < w.get_row(); r++) {
+            for (std::size_t o = 0; o < w.get_col(); o++) {
+                scale(o, 0) += std::abs(w(r, o));
+            }
+        }
+        for (std::size_t o = 0; o < w.get_col(); o++) {
+            scale(o, 0) /= static_cast<T>(w.get_row());
+        }
+    }
+
+    // b = sign(w) * scale(o) column by column, with scale from binary_scale
+    template<typename T>
+    void binarize_weights(LinearAlgebra::MatrixView<T const> w, LinearAlgebra::MatrixView<T> scale,
+                          LinearAlgebra::MatrixView<T> b) {
+        assert(b.get_row() == w.get_row() && b.get_col() == w.get_col());
+        binary_scale(w, scale);
+        for (std::size_t r = 0; r < w.get_row(); r++) {
+            T const *p = w.data() + r * w.get_ld();
+            T *q = b.data() + r * b.get_ld();
+            for (std::size_t o = 0; o < w.get_col(); o++) {
+                q[o] = p[o] < 0 ? -scale(o, 0) : scale(o, 0);
+            }
+        }
+    }
+
+    // b = sign(a), as +-1
+    template<typename T>
+    void binarize(LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T> b) {
+        assert(b.get_row() == a.get_row() && b.get_col() == a.get_col());
+        for (std::size_t r = 0; r < a.get_row(); r++) {
+            T const *p = a.data() + r * a.get_ld();
+            T *q = b.data() + r * b.get_ld();
+            for (std::size_t c = 0; c < a.get_col(); c++) {
+                q[c] = p[c] < 0 ? T(-1) : T(1);
+            }
+        }
+    }
+
+    // g = g * (|a| <= 1): the gradient with respect to sign(a) taken on to a
+    template<typename T>
+    void straight_through(LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T> g) {
+        assert(g.get_row() == a.get_row() && g.get_col() == a.get_col());
+        for (std::size_t r = 0; r < a.get_row(); r++) {
+            T const *p = a.data() + r * a.get_ld();
+            T *q = g.data() + r * g.get_ld();
+            for (std::size_t c = 0; c < a.get_col(); c++) {
+                q[c] = std::abs(p[c]) <= 1 ? q[c] : T(0);
+            }
+        }
+    }
+
+    // w = clamp(w, -1, 1), keeping latent weights where a step can still flip their sign
+    template<typename T>
+    void clip_latent(LinearAlgebra::MatrixView<T> w) {
+        for (std::size_t r = 0; r < w.get_row(); r++) {
+            T *p = w.data() + r * w.get_ld();
+            for (std::size_t c = 0; c < w.get_col(); c++) {
+                p[c] = std::min(std::max(p[c], T(-1)), T(1));
+            }
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef BNN_Net_Checkpoint_hpp
+#define BNN_Net_Checkpoint_hpp
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Activation.hpp"
+#include "Loss.hpp"
+#include "../Data/MappedFile.hpp"
+#include "../LinearAlgebra/FlatBuffer.hpp"
+
+/*
+ * Binary checkpoints of a network's weights.
+ * A file is a Header, layers_count layer sizes, layers_count - 1 activation ids, one Slot per
+ * weight and bias matrix (weights[0], bias[0], weights[1], ...), zero padding up to a 64-byte
+ * boundary, and then the parameters exactly as they sit in the network's FlatBuffer, row padding
+ * included. Everything is in the byte order of the machine that wrote it, which the header checks.
+ * Reading maps the file instead of copying it, so the parameters can be used in place and the
+ * pages are shared by every process that maps the same file.
+ */
+
+namespace Net {
+
+    namespace Checkpoints {
+
+        constexpr char magic[8] = {'B', 'N', 'N', 'C', 'K', 'P', 'T', '\0'};
+        // bump on any change to the layout below
+        constexpr std::uint32_t version = 1;
+        constexpr std::uint32_t byte_order = 0x01020304;
+        constexpr std::size_t alignment = 64;
+
+        struct Header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            // sizeof the parameter type
+            std::uint32_t scalar_size;
+            std::uint32_t loss;
+            std::uint64_t layers_count;
+            // parameters, in elements, and where they start, in bytes from the start of the file
+            std::uint64_t parameter_count;
+            std::uint64_t parameter_offset;
+        };
+
+        // one matrix, at offset elements into the parameters, with rows ld elements apart
+        struct Slot {
+            std::uint64_t offset, row, col, ld;
+        };
+
+        inline std::size_t parameter_offset(std::size_t layers_count) {
+            std::size_t const end = sizeof(Header) + layers_count * sizeof(std::uint64_t) +
+                                    (layers_count - 1) * sizeof(std::uint32_t) +
+                                    2 * (layers_count - 1) * sizeof(Slot);
+            return (end + alignment - 1) / alignment * alignment;
+        }
+
+    }
+
+    // write a checkpoint of parameters, laid out as weights[0], bias[0], weights[1], ... for layers_count
+    // layers; goes through a temporary file renamed over path, so a reader never sees half a checkpoint.
+    // Returns false when the file cannot be written.
+    template<typename T>
+    bool save_checkpoint(std::string const &path, std::size_t layers_count, std::size_t const *layer_size,
+                         Activation const *activations, Loss loss, LinearAlgebra::FlatBuffer<T> const &parameters) {
+        using namespace Checkpoints;
+        assert(layers_count >= 2 && parameters.count() == 2 * (layers_count - 1));
+        std::size_t const offset = parameter_offset(layers_count);
+        std::vector<unsigned char> head(offset, 0);
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.byte_order = byte_order;
+        header.scalar_size = sizeof(T);
+        header.loss = static_cast<std::uint32_t>(loss);
+        header.layers_count = layers_count;
+        header.parameter_count = parameters.size();
+        header.parameter_offset = offset;
+        unsigned char *p = head.data();
+        std::memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        for (std::size_t i = 0; i < layers_count; i++, p += sizeof(std::uint64_t)) {
+            std::uint64_t const size = layer_size[i];
+            std::memcpy(p, &size, sizeof(size));
+        }
+        for (std::size_t i = 0; i + 1 < layers_count; i++, p += sizeof(std::uint32_t)) {
+            std::uint32_t const id = static_cast<std::uint32_t>(activations[i]);
+            std::memcpy(p, &id, sizeof(id));
+        }
+        for (std::size_t i = 0; i < parameters.count(); i++, p += sizeof(Slot)) {
+            LinearAlgebra::MatrixView<T const> const view = parameters.view(i);
+            Slot const slot{static_cast<std::uint64_t>(view.data() - parameters.data()),
+                            view.get_row(), view.get_col(), view.get_ld()};
+            std::memcpy(p, &slot, sizeof(slot));
+        }
+
+        std::string const temporary = path + ".tmp";
+        std::FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        bool ok = std::fwrite(head.data(), 1, head.size(), file) == head.size() &&
+                  std::fwrite(parameters.data(), sizeof(T), parameters.size(), file) == parameters.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /*
+     * A checkpoint file mapped read-only. Check valid() before anything else: it is false when the
+     * file is missing, truncated, of another version or byte order, or holds another scalar type.
+     * Copies share the mapping, and views stay valid while any copy, or anything it was handed to,
+     * is alive.
+     */
+    template<typename T>
+    class Checkpoint {
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        std::shared_ptr<Data::MappedFile const> mapping;
+        Checkpoints::Header header;
+        std::vector<nnint> sizes;
+        std::vector<Activation> activations;
+        std::vector<Checkpoints::Slot> slots;
+        T const *parameters;
+
+        bool parse() {
+            using namespace Checkpoints;
+            unsigned char const *p = mapping->data();
+            std::size_t const length = mapping->size();
+            if (length < sizeof(Header)) {
+                return false;
+            }
+            std::memcpy(&header, p, sizeof(header));
+            if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+                header.byte_order != byte_order || header.scalar_size != sizeof(T) ||
+                header.layers_count < 2 || header.layers_count > length ||
+                header.parameter_offset != parameter_offset(header.layers_count) || header.parameter_offset > length ||
+                header.parameter_count > (length - header.parameter_offset) / sizeof(T)) {
+                return false;
+            }
+            p += sizeof(Header);
+            for (nnint i = 0; i < header.layers_count; i++, p += sizeof(std::uint64_t)) {
+                std::uint64_t size;
+                std::memcpy(&size, p, sizeof(size));
+                sizes.push_back(size);
+            }
+            for (nnint i = 0; i + 1 < header.layers_count; i++, p += sizeof(std::uint32_t)) {
+                std::uint32_t id;
+                std::memcpy(&id, p, sizeof(id));
+                if (id > static_cast<std::uint32_t>(Activation::Custom)) {
+                    return false;
+                }
+                activations.push_back(static_cast<Activation>(id));
+            }
+            for (nnint i = 0; i < 2 * (header.layers_count - 1); i++, p += sizeof(Slot)) {
+                Slot slot;
+                std::memcpy(&slot, p, sizeof(slot));
+                // weights are (in x out), biases (out x 1), with rows as save_checkpoint pads them, and every
+                // one lies inside the parameters; checked so that no sum or product can wrap
+                nnint const layer = i / 2;
+                std::uint64_t const count = header.parameter_count;
+                bool const shaped = i % 2 == 0 ? slot.row == sizes[layer] && slot.col == sizes[layer + 1]
+                                               : slot.row == sizes[layer + 1] && slot.col == 1;
+                if (!shaped || slot.row == 0 || slot.col == 0 || slot.row > count || slot.col > count ||
+                    slot.ld != LinearAlgebra::Matrix<T>::padded(slot.col) || slot.ld > count ||
+                    slot.offset > count - slot.col || slot.row - 1 > (count - slot.offset - slot.col) / slot.ld) {
+                    return false;
+                }
+                slots.push_back(slot);
+            }
+            parameters = reinterpret_cast<T const *>(mapping->data() + header.parameter_offset);
+            return header.loss <= static_cast<std::uint32_t>(Loss::Custom);
+        }
+
+        ConstView slot(nnint i) const {
+            assert(valid() && i < slots.size());
+            Checkpoints::Slot const &s = slots[i];
+            return ConstView(parameters + s.offset, s.row, s.col, s.ld);
+        }
+
+    public:
+        explicit Checkpoint(std::string const &path)
+                : mapping(std::make_shared<Data::MappedFile const>(path)), header{}, parameters(nullptr) {
+            if (!mapping->valid() || !parse()) {
+                mapping.reset();
+                parameters = nullptr;
+            }
+        }
+
+        bool valid() const {
+            return parameters != nullptr;
+        }
+
+        nnint layers_count() const {
+            return sizes.size();
+        }
+        nnint const *layer_size() const {
+            return sizes.data();
+        }
+        // activation of each weight layer, layers_count - 1 of them
+        Activation const *layer_activation() const {
+            return activations.data();
+        }
+        Loss loss() const {
+            return static_cast<Loss>(header.loss);
+        }
+
+        // (layer_size[i] x layer_size[i + 1]) weights and (layer_size[i + 1] x 1) bias of weight layer i,
+        // straight out of the mapped file
+        ConstView weights(nnint i) const {
+            return slot(2 * i);
+        }
+        ConstView bias(nnint i) const {
+            return slot(2 * i + 1);
+        }
+
+        // keeps the file mapped for as long as views into it are used elsewhere
+        std::shared_ptr<void const> keep_alive() const {
+            return mapping;
+        }
+    };
+
+}
+
+#endif
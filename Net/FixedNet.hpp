@@ -0,0 +1,201 @@
+#ifndef BNN_Net_FixedNet_hpp
+#define BNN_Net_FixedNet_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Activation.hpp"
+#include "Binary.hpp"
+#include "NeuralNet.hpp"
+#include "../LinearAlgebra/Matrix.hpp"
+
+namespace Net {
+
+    namespace Fixed {
+
+        // activations of a FixedNet layer, applied in place to a whole fixed-size matrix, and the built-in
+        // Activation each one matches
+        struct Identity {
+            static constexpr Activation activation = Activation::Identity;
+
+            template<typename T, std::size_t R, std::size_t C>
+            static void apply(LinearAlgebra::Matrix<T, R, C> &) {}
+        };
+
+        struct ReLU {
+            static constexpr Activation activation = Activation::ReLU;
+
+            template<typename T, std::size_t R, std::size_t C>
+            static void apply(LinearAlgebra::Matrix<T, R, C> &a) {
+                T *x = a.data();
+                for (std::size_t i = 0; i < R * C; i++) {
+                    x[i] = x[i] > 0 ? x[i] : static_cast<T>(0);
+                }
+            }
+        };
+
+        struct Sigmoid {
+            static constexpr Activation activation = Activation::Sigmoid;
+
+            template<typename T, std::size_t R, std::size_t C>
+            static void apply(LinearAlgebra::Matrix<T, R, C> &a) {
+                T *x = a.data();
+                for (std::size_t i = 0; i < R * C; i++) {
+                    x[i] = 1 / (1 + std::exp(-x[i]));
+                }
+            }
+        };
+
+        struct Tanh {
+            static constexpr Activation activation = Activation::Tanh;
+
+            template<typename T, std::size_t R, std::size_t C>
+            static void apply(LinearAlgebra::Matrix<T, R, C> &a) {
+                T *x = a.data();
+                for (std::size_t i = 0; i < R * C; i++) {
+                    x[i] = std::tanh(x[i]);
+                }
+            }
+        };
+
+        // over each column, shifted by its maximum
+        struct Softmax {
+            static constexpr Activation activation = Activation::Softmax;
+
+            template<typename T, std::size_t R, std::size_t C>
+            static void apply(LinearAlgebra::Matrix<T, R, C> &a) {
+                for (std::size_t j = 0; j < C; j++) {
+                    T m = a(0, j), sum = 0;
+                    for (std::size_t i = 1; i < R; i++) {
+                        m = std::max(m, a(i, j));
+                    }
+                    for (std::size_t i = 0; i < R; i++) {
+                        a(i, j) = std::exp(a(i, j) - m);
+                        sum += a(i, j);
+                    }
+                    for (std::size_t i = 0; i < R; i++) {
+                        a(i, j) /= sum;
+                    }
+                }
+            }
+        };
+
+        // a weight layer from in units to out, followed by the activation F
+        template<std::size_t in, std::size_t out, typename F>
+        struct Layer {
+            static_assert(in != 0 && out != 0, "In Layer: a layer needs at least one unit on each side!");
+            static constexpr std::size_t inputs = in, outputs = out;
+            using Function = F;
+
+            // weights (out x in) and bias
+            template<typename T>
+            struct Parameters {
+                LinearAlgebra::Matrix<T, out, in> weights;
+                LinearAlgebra::Matrix<T, out, 1> bias;
+            };
+        };
+
+    }
+
+    /*
+     * A trained network whose shape and activations are template arguments, e.g.
+     *     FixedNet<double, Fixed::Layer<3, 6, Fixed::ReLU>, Fixed::Layer<6, 5, Fixed::Sigmoid> >
+     * Every weight and bias is a Matrix<T, R, C> stored inline, so predict takes no heap, each layer is a
+     * fixed-size product and its activation is inlined into the same constant-bound loops.
+     * It only predicts, with the weights of a NeuralNet of the same shape and no binarized layer.
+     */
+    template<typename T, typename ...Layers>
+    class FixedNet {
+        static_assert(sizeof...(Layers) != 0, "In FixedNet: a network needs at least one weight layer!");
+
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        template<nnint i>
+        using LayerAt = std::tuple_element_t<i, std::tuple<Layers...> >;
+
+        static constexpr nnint weight_layers = sizeof...(Layers);
+
+        static constexpr bool chained() {
+            nnint const in[] = {Layers::inputs...}, out[] = {Layers::outputs...};
+            for (nnint i = 0; i + 1 < weight_layers; i++) {
+                if (out[i] != in[i + 1]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        static_assert(chained(), "In FixedNet: every layer must take as many inputs as the one before has outputs!");
+
+        static constexpr nnint inputs = LayerAt<0>::inputs, outputs = LayerAt<weight_layers - 1>::outputs;
+
+        std::tuple<typename Layers::template Parameters<T>...> parameters;
+
+        // layer i of net, whose weights are (in x out)
+        template<nnint i>
+        void load(NeuralNet<T> const &net) {
+            ConstView const w = net.weights[i];
+            assert(w.get_row() == LayerAt<i>::inputs && w.get_col() == LayerAt<i>::outputs);
+            assert(net.layer_activation[i] == LayerAt<i>::Function::activation);
+            auto &p = std::get<i>(parameters);
+            for (nnint r = 0; r < LayerAt<i>::outputs; r++) {
+                for (nnint c = 0; c < LayerAt<i>::inputs; c++) {
+                    p.weights(r, c) = w(c, r);
+                }
+            }
+            p.bias = ConstView(net.bias[i]);
+        }
+
+        template<nnint ...I>
+        void load(NeuralNet<T> const &net, std::index_sequence<I...>) {
+            (load<I>(net), ...);
+        }
+
+        template<nnint i, nnint C>
+        LinearAlgebra::Matrix<T, outputs, C> forward(LinearAlgebra::Matrix<T, LayerAt<i>::inputs, C> const &in) const {
+            auto const &p = std::get<i>(parameters);
+            LinearAlgebra::Matrix<T, LayerAt<i>::outputs, C> out = p.weights * in;
+            for (nnint r = 0; r < LayerAt<i>::outputs; r++) {
+                for (nnint c = 0; c < C; c++) {
+                    out(r, c) += p.bias(r, 0);
+                }
+            }
+            LayerAt<i>::Function::apply(out);
+            if constexpr (i + 1 == weight_layers) {
+                return out;
+            } else {
+                return forward<i + 1>(out);
+            }
+        }
+
+    public:
+        // the weights of net, whose layers must have the sizes and activations given
+        explicit FixedNet(NeuralNet<T> const &net) {
+            assert(net.layers_count == weight_layers + 1);
+            for (nnint i = 0; i < weight_layers; i++) {
+                assert(net.layer_binarization[i] == Binarization::None);
+            }
+            load(net, std::make_index_sequence<weight_layers>());
+        }
+
+        static constexpr nnint input_size() {
+            return inputs;
+        }
+        static constexpr nnint output_size() {
+            return outputs;
+        }
+
+        // outputs for C cases, one per column
+        template<nnint C>
+        LinearAlgebra::Matrix<T, outputs, C> predict(LinearAlgebra::Matrix<T, inputs, C> const &input) const {
+            return forward<0>(input);
+        }
+    };
+
+}
+
+#endif
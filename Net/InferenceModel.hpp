@@ -0,0 +1,175 @@
+#ifndef BNN_Net_InferenceModel_hpp
+#define BNN_Net_InferenceModel_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Activation.hpp"
+#include "Binary.hpp"
+#include "Checkpoint.hpp"
+#include "NeuralNet.hpp"
+#include "../LinearAlgebra/BitMatrix.hpp"
+#include "../LinearAlgebra/Matrix.hpp"
+
+namespace Net {
+
+    /*
+     * A frozen copy of a trained NeuralNet that only predicts.
+     * It keeps the weights, the biases and the activations, and nothing the training needs.
+     * Built from a network it copies the weights transposed to (out x in), so each layer is one plain
+     * gemm; built from a checkpoint it reads them in place from the mapped file, with no copy at all.
+     * Binarized layers of a network keep only their weights packed to bits and a scale per output, and
+     * multiply with XNOR and popcount (Full) or with adds and subtracts (Weights).
+     * predict is const and keeps the activations of a call in scratch owned by the calling thread, so
+     * any number of threads can predict with one model at once; Custom activations are then called
+     * concurrently too.
+     */
+    template<typename T>
+    class InferenceModel {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        using View = LinearAlgebra::MatrixView<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        std::vector<nnint> layer_size;
+        std::vector<Activation> layer_activation;
+        // op(weights[i]) is (layer_size[i + 1] x layer_size[i]), bias[i] a column of layer_size[i + 1]
+        std::vector<ConstView> weights, bias;
+        LinearAlgebra::Transpose transpose;
+        // for binarized layers instead of weights: the signs of each output's weights and their scale
+        std::vector<Binarization> layer_binarization;
+        std::vector<LinearAlgebra::BitMatrix> signs;
+        std::vector<ConstView> scale;
+        // what weights and bias point into: copies of the network's, or the mapped checkpoint
+        std::vector<Matrix> storage;
+        std::shared_ptr<void const> mapping;
+        CustomActivation<T> inner_function, outer_function;
+        nnint widest;
+
+        // out = weights * in + bias * ones^T
+        void product(nnint i, ConstView in, View out) const {
+            if (layer_binarization[i] == Binarization::None) {
+                for (nnint r = 0; r < out.get_row(); r++) {
+                    std::fill(out.data() + r * out.get_ld(), out.data() + r * out.get_ld() + out.get_col(), bias[i](r, 0));
+                }
+                gemm(transpose, LinearAlgebra::Transpose::NoTrans, static_cast<T>(1), weights[i], in, static_cast<T>(1), out);
+                return;
+            }
+            if (layer_binarization[i] == Binarization::Full) {
+                // the input signs of this call, in scratch owned by the calling thread
+                thread_local LinearAlgebra::BitMatrix input;
+                input.pack(in);
+                xnor_gemm(signs[i], input, scale[i], out);
+            } else {
+                sign_gemm(signs[i], scale[i], in, out);
+            }
+            for (nnint r = 0; r < out.get_row(); r++) {
+                T *o = out.data() + r * out.get_ld();
+                for (nnint c = 0; c < out.get_col(); c++) {
+                    o[c] += bias[i](r, 0);
+                }
+            }
+        }
+
+        // activations of layer i + 1 into out, from the activations of layer i
+        void layer(nnint i, ConstView in, View out) const {
+            product(i, in, out);
+            if (layer_activation[i] == Activation::Custom) {
+                (i + 2 < layer_size.size() ? inner_function : outer_function)(out, out);
+            } else {
+                activate<T>(layer_activation[i], out, out);
+            }
+        }
+
+    public:
+        explicit InferenceModel(NeuralNet<T> const &net)
+                : layer_size(net.layer_size, net.layer_size + net.layers_count),
+                  layer_activation(net.layer_activation, net.layer_activation + net.layers_count - 1),
+                  transpose(LinearAlgebra::Transpose::NoTrans),
+                  layer_binarization(net.layer_binarization, net.layer_binarization + net.layers_count - 1),
+                  signs(net.layers_count - 1), scale(net.layers_count - 1),
+                  inner_function(net.inner_function), outer_function(net.outer_function),
+                  widest(*std::max_element(net.layer_size, net.layer_size + net.layers_count)) {
+            storage.reserve(2 * (layer_size.size() - 1));
+            for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+                ConstView const w = net.weights[i];
+                if (layer_binarization[i] != Binarization::None) {
+                    Matrix &s = storage.emplace_back(layer_size[i + 1], 1);
+                    binary_scale(w, s.view());
+                    scale[i] = s.view();
+                    signs[i].pack(w);
+                    weights.emplace_back();
+                    bias.push_back(storage.emplace_back(net.bias[i]).view());
+                    continue;
+                }
+                Matrix &t = storage.emplace_back(layer_size[i + 1], layer_size[i]);
+                for (nnint r = 0; r < layer_size[i + 1]; r++) {
+                    for (nnint c = 0; c < layer_size[i]; c++) {
+                        t(r, c) = w(c, r);
+                    }
+                }
+                weights.push_back(t.view());
+                bias.push_back(storage.emplace_back(net.bias[i]).view());
+            }
+        }
+
+        // straight from the weights of a valid checkpoint without Custom activations, which stays mapped
+        // for as long as the model lives
+        explicit InferenceModel(Checkpoint<T> const &checkpoint)
+                : layer_size(checkpoint.layer_size(), checkpoint.layer_size() + checkpoint.layers_count()),
+                  layer_activation(checkpoint.layer_activation(),
+                                   checkpoint.layer_activation() + checkpoint.layers_count() - 1),
+                  transpose(LinearAlgebra::Transpose::Trans),
+                  layer_binarization(checkpoint.layers_count() - 1, Binarization::None),
+                  signs(checkpoint.layers_count() - 1), scale(checkpoint.layers_count() - 1),
+                  mapping(checkpoint.keep_alive()),
+                  widest(*std::max_element(layer_size.begin(), layer_size.end())) {
+            assert(checkpoint.valid());
+            for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+                assert(layer_activation[i] != Activation::Custom);
+                weights.push_back(checkpoint.weights(i));
+                bias.push_back(checkpoint.bias(i));
+            }
+        }
+
+        // views into storage must not outlive it, so models move but do not copy
+        InferenceModel(InferenceModel const &) = delete;
+        InferenceModel &operator=(InferenceModel const &) = delete;
+        InferenceModel(InferenceModel &&) = default;
+        InferenceModel &operator=(InferenceModel &&) = default;
+
+        nnint input_size() const {
+            return layer_size.front();
+        }
+        nnint output_size() const {
+            return layer_size.back();
+        }
+
+        // output = the network applied to input, both holding one sample per column
+        void predict(ConstView input, View output) const {
+            assert(input.get_row() == input_size() && input.get_col() != 0);
+            assert(output.get_row() == output_size() && output.get_col() == input.get_col());
+            nnint const batch = input.get_col(), ld = Matrix::padded(batch);
+            // hidden layers alternate between two buffers of this thread
+            T *scratch[2] = {LinearAlgebra::Kernels::detail::pack_buffer<T, 3>(widest * ld),
+                             LinearAlgebra::Kernels::detail::pack_buffer<T, 4>(widest * ld)};
+            ConstView in = input;
+            for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+                View const out = i + 2 < layer_size.size() ? View(scratch[i % 2], layer_size[i + 1], batch, ld) : output;
+                layer(i, in, out);
+                in = out;
+            }
+        }
+
+        Matrix predict(ConstView input) const {
+            Matrix ret(output_size(), input.get_col());
+            predict(input, ret);
+            return ret;
+        }
+    };
+
+}
+
+#endif
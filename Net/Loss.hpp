@@ -0,0 +1,246 @@
+#ifndef BNN_Net_Loss_hpp
+#define BNN_Net_Loss_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/MatrixView.hpp"
+#include "../LinearAlgebra/Kernels/Gemm.hpp"
+#include "../LinearAlgebra/Kernels/Math.hpp"
+
+/*
+ * Output losses fused with the output stage.
+ * One pass over a batch (one sample per column) returns the loss summed over the batch and
+ * writes its gradient. The cross-entropies work from the logits z with
+ *     BCE(z, t) = max(z, 0) - z t + log(1 + e^-|z|)
+ *     CE(z, t)  = sum_i t_i (logsumexp(z) - z_i)
+ * so they never take the log of a saturated probability, and their gradient with respect to z
+ * is simply a - t (for CE the targets of a column must sum to 1).
+ * Loss::Custom is NeuralNet::error and derror, or a CustomLoss built from elementwise operators.
+ */
+
+namespace Net {
+
+    enum class Loss {
+        // 1/2 sum (a - t)^2 on the output of any activation; the gradient then goes through it
+        MeanSquaredError,
+        // sigmoid output with binary cross-entropy
+        SigmoidCrossEntropy,
+        // softmax output with categorical cross-entropy
+        SoftmaxCrossEntropy,
+        // the overridable NeuralNet::error and NeuralNet::derror
+        Custom
+    };
+
+    namespace Losses {
+
+        using LinearAlgebra::Kernels::Isa;
+        using LinearAlgebra::Kernels::Vec;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        template<typename T, Isa isa>
+        BNN_ALWAYS_INLINE T horizontal_sum(typename Vec<T, isa>::type const &v) {
+            using V = Vec<T, isa>;
+            alignas(64) T lanes[V::width];
+            V::store(lanes, v);
+            T ret = 0;
+            for (std::size_t l = 0; l < V::width; l++) {
+                ret += lanes[l];
+            }
+            return ret;
+        }
+
+        // g = a - t, returns 1/2 sum (a - t)^2
+        struct MeanSquaredErrorKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE T run(std::size_t row, std::size_t col, T const *a, std::size_t lda,
+                                           T const *t, std::size_t ldt, T *g, std::size_t ldg) {
+                T ret = 0;
+                for (std::size_t i = 0; i < row; i++) {
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type sum = V::zero();
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const d = V::sub(V::load(a + i * lda + j), V::load(t + i * ldt + j));
+                            V::store(g + i * ldg + j, d);
+                            sum = V::fmadd(d, d, sum);
+                        }
+                        ret += horizontal_sum<T, isa>(sum);
+                    }
+#endif
+                    for (; j < col; j++) {
+                        T const d = a[i * lda + j] - t[i * ldt + j];
+                        g[i * ldg + j] = d;
+                        ret += d * d;
+                    }
+                }
+                return ret / 2;
+            }
+        };
+
+        // g = a - t with a = sigmoid(z), returns the binary cross-entropy from the logits
+        struct SigmoidCrossEntropyKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE T run(std::size_t row, std::size_t col, T const *z, std::size_t ldz,
+                                           T const *a, std::size_t lda, T const *t, std::size_t ldt,
+                                           T *g, std::size_t ldg) {
+                T ret = 0;
+                for (std::size_t i = 0; i < row; i++) {
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type sum = V::zero();
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const zv = V::load(z + i * ldz + j);
+                            typename V::type const tv = V::load(t + i * ldt + j);
+                            V::store(g + i * ldg + j, V::sub(V::load(a + i * lda + j), tv));
+                            // log(1 + e^-|z|)
+                            typename V::type soft = V::sub(V::zero(), V::max(zv, V::sub(V::zero(), zv)));
+                            LinearAlgebra::Kernels::detail::exp<T, isa>(soft);
+                            LinearAlgebra::Kernels::detail::log1p_unit<T, isa>(soft);
+                            sum = V::add(sum, V::add(V::sub(V::max(zv, V::zero()), V::mul(zv, tv)), soft));
+                        }
+                        ret += horizontal_sum<T, isa>(sum);
+                    }
+#endif
+                    for (; j < col; j++) {
+                        T const zv = z[i * ldz + j], tv = t[i * ldt + j];
+                        g[i * ldg + j] = a[i * lda + j] - tv;
+                        ret += std::max(zv, static_cast<T>(0)) - zv * tv +
+                               LinearAlgebra::Kernels::detail::log1p_unit(LinearAlgebra::Kernels::detail::exp(-std::abs(zv)));
+                    }
+                }
+                return ret;
+            }
+        };
+
+        // g = a - t with a = softmax(z) per column, returns the cross-entropy from the logits;
+        // scratch holds 2 * col elements
+        struct SoftmaxCrossEntropyKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE T run(std::size_t row, std::size_t col, T const *z, std::size_t ldz,
+                                           T const *a, std::size_t lda, T const *t, std::size_t ldt,
+                                           T *g, std::size_t ldg, T *scratch) {
+                // logsumexp of every column, vectorized across columns
+                T *lse = scratch, *sum = scratch + col;
+                std::copy(z, z + col, lse);
+                std::fill(sum, sum + col, static_cast<T>(0));
+                for (std::size_t i = 1; i < row; i++) {
+                    for (std::size_t j = 0; j < col; j++) {
+                        lse[j] = std::max(lse[j], z[i * ldz + j]);
+                    }
+                }
+                for (std::size_t i = 0; i < row; i++) {
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type e = V::sub(V::load(z + i * ldz + j), V::load(lse + j));
+                            LinearAlgebra::Kernels::detail::exp<T, isa>(e);
+                            V::store(sum + j, V::add(V::load(sum + j), e));
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        sum[j] += LinearAlgebra::Kernels::detail::exp(z[i * ldz + j] - lse[j]);
+                    }
+                }
+                for (std::size_t j = 0; j < col; j++) {
+                    lse[j] += std::log(sum[j]);
+                }
+                T ret = 0;
+                for (std::size_t i = 0; i < row; i++) {
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type acc = V::zero();
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const tv = V::load(t + i * ldt + j);
+                            V::store(g + i * ldg + j, V::sub(V::load(a + i * lda + j), tv));
+                            acc = V::fmadd(tv, V::sub(V::load(lse + j), V::load(z + i * ldz + j)), acc);
+                        }
+                        ret += horizontal_sum<T, isa>(acc);
+                    }
+#endif
+                    for (; j < col; j++) {
+                        T const tv = t[i * ldt + j];
+                        g[i * ldg + j] = a[i * lda + j] - tv;
+                        ret += tv * (lse[j] - z[i * ldz + j]);
+                    }
+                }
+                return ret;
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // loss of output a (and logits z for the cross-entropies) against answer t, summed over the batch;
+    // g receives dL/da for MeanSquaredError and dL/dz for the cross-entropies
+    template<typename T>
+    T loss_and_gradient(Loss loss, LinearAlgebra::MatrixView<T const> z, LinearAlgebra::MatrixView<T const> a,
+                        LinearAlgebra::MatrixView<T const> t, LinearAlgebra::MatrixView<T> g) {
+        using LinearAlgebra::Kernels::dispatch;
+        assert(a.get_row() == t.get_row() && a.get_col() == t.get_col());
+        assert(g.get_row() == t.get_row() && g.get_col() == t.get_col());
+        std::size_t const row = a.get_row(), col = a.get_col();
+        switch (loss) {
+            case Loss::MeanSquaredError:
+                return dispatch<Losses::MeanSquaredErrorKernel, T>(row, col, a.data(), a.get_ld(), t.data(), t.get_ld(),
+                                                                   g.data(), g.get_ld());
+            case Loss::SigmoidCrossEntropy:
+                return dispatch<Losses::SigmoidCrossEntropyKernel, T>(row, col, z.data(), z.get_ld(), a.data(), a.get_ld(),
+                                                                      t.data(), t.get_ld(), g.data(), g.get_ld());
+            case Loss::SoftmaxCrossEntropy: {
+                T *scratch = LinearAlgebra::Kernels::detail::pack_buffer<T, 2>(2 * col);
+                return dispatch<Losses::SoftmaxCrossEntropyKernel, T>(row, col, z.data(), z.get_ld(), a.data(), a.get_ld(),
+                                                                      t.data(), t.get_ld(), g.data(), g.get_ld(), scratch);
+            }
+            default:
+                assert(false && "In loss_and_gradient: Custom losses are NeuralNet::error and derror!");
+                return 0;
+        }
+    }
+
+    // Loss::Custom on a whole batch: the loss of outputs a against answers t summed over every element,
+    // and its gradient with respect to a into g
+    template<typename T>
+    struct CustomLoss {
+        std::function<T(LinearAlgebra::MatrixView<T const>, LinearAlgebra::MatrixView<T const>)> error;
+        std::function<void(LinearAlgebra::MatrixView<T const>, LinearAlgebra::MatrixView<T const>,
+                           LinearAlgebra::MatrixView<T>)> derror;
+    };
+
+    // l(a, t) and dl/da (a, t) as Operators::BinomialOperator on one element, summed with LinearAlgebra::reduce
+    // and written with zip, each in one fused loop
+    template<typename T, typename L, typename DL>
+    CustomLoss<T> custom_loss(Operators::BinomialOperator<L> l, Operators::BinomialOperator<DL> dl) {
+        CustomLoss<T> ret;
+        ret.error = [l](LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T const> t) {
+            return LinearAlgebra::reduce(Operators::binomial(Operators::Plus()), static_cast<T>(0), LinearAlgebra::zip(l, a, t));
+        };
+        ret.derror = [dl](LinearAlgebra::MatrixView<T const> a, LinearAlgebra::MatrixView<T const> t,
+                          LinearAlgebra::MatrixView<T> g) {
+            g.assign(LinearAlgebra::zip(dl, a, t));
+        };
+        return ret;
+    }
+
+}
+
+#endif
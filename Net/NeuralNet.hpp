@@ -2,7 +2,19 @@
 #define BNN_NeuralNet_hpp
 
 #include <functional>
+#include <string>
+#include <vector>
+#include "Activation.hpp"
+#include "Binary.hpp"
+#include "Checkpoint.hpp"
+#include "Loss.hpp"
+#include "../Data/BatchLoader.hpp"
+#include "../LinearAlgebra/Arena.hpp"
+#include "../LinearAlgebra/FlatBuffer.hpp"
 #include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/Profiler.hpp"
+#include "../LinearAlgebra/ThreadPool.hpp"
+#include "../Optimizer/SGD.hpp"
 #include <memory>
 
 namespace Net {
@@ -36,60 +48,441 @@ namespace Net {
         T alpha;
     };
 
+    // how learn spreads over several threads, see NeuralNet::set_threads
+    enum class Parallelism {
+        Synchronous,
+        // lock-free updates from every worker; needs a stateless optimizer (SGD without momentum, not the
+        // default), full precision and no binarized layer
+        Hogwild
+    };
+
+    // what the products of a network read its weights as, see NeuralNet::set_precision
+    enum class Precision {
+        Full,
+        BFloat16,
+        Float16
+    };
+
+    template<typename T>
+    class InferenceModel;
+
+    template<typename T>
+    class QuantizedModel;
+
+    template<typename T, typename ...Layers>
+    class FixedNet;
+
     template<typename T>
     class NeuralNet {
+        // read the trained weights and activations
+        friend class InferenceModel<T>;
+        friend class QuantizedModel<T>;
+        template<typename, typename ...>
+        friend class FixedNet;
+
         using Matrix = LinearAlgebra::Matrix<T>;
+        using View = LinearAlgebra::MatrixView<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
         using FunctionType = std::function<Matrix(Matrix const &)>;
         using nnint = std::size_t;
 
         std::unique_ptr<NetConfigs<T> > netConfigs;
 
-        // (input, hidden and output) layers, weights, layers before passing activation function
-        Matrix *layers, *weights, *z;
-        Matrix *wm, *bm;
+        // (hidden and output) layers, layers before passing activation function
+        // the input layer is never copied: layers[0] stays empty and input points at the caller's data
+        Matrix *layers, *z;
+        ConstView input;
 
-        // bias for each layer except the output
-        Matrix *bias;
+        // weights and bias for each layer except the output, views into parameters
+        View *weights, *bias;
 
         // Function applied to layers except output layer
-        FunctionType inner_function;
+        CustomActivation<T> inner_function;
         // Function applied to output layer
-        FunctionType outer_function;
+        CustomActivation<T> outer_function;
         // derivatives of functions above
-        FunctionType dinner_function;
-        FunctionType douter_function;
+        CustomActivation<T> dinner_function;
+        CustomActivation<T> douter_function;
+        // activation of the output of each weight layer; only Custom ones call the functions above
+        // and keep z, built-in ones run in place on the layer and differentiate from its value
+        Activation *layer_activation;
+        // binarization of each weight layer, see set_binarization
+        Binarization *layer_binarization;
+        // what a binarized weight layer multiplies by: its sign weights scaled per output, the scales, and for
+        // Full its weights and input packed to bits, with the input signs kept as reals for the gradient
+        struct Binarized {
+            Matrix weights, scale, input;
+            LinearAlgebra::BitMatrix weight_bits, input_bits;
+        };
+        Binarized *binarized;
+        // loss on the output layer; the cross-entropies keep the output logits in z
+        Loss loss;
+        T last_loss;
+        // Loss::Custom from operators, see set_custom_loss; empty for the virtual error and derror
+        CustomLoss<T> custom_loss;
 
         // number of layers, size of each layer
         // number of weights and z is layers_count - 1
         nnint layers_count, *layer_size;
 
-        // learning rate
+        // learning rate of the default optimizer
         T alpha;
 
+        // every weight and bias in one buffer, laid out as weights[0], bias[0], weights[1], ...,
+        // and the gradients of the loss, averaged over the batch, in one more with the same layout
+        LinearAlgebra::FlatBuffer<T> parameters, gradients;
+        View *wm, *bm;
+        // updates parameters from gradients once per step, SGD with momentum 0.9 by default
+        std::unique_ptr<Optimizer::OptimizerBase<T> > optimizer;
+
+        // parameters rounded to 16 bits after every update, which the products read instead of the
+        // full precision master copy the optimizer keeps; shared with the replicas
+        Precision precision;
+        std::shared_ptr<LinearAlgebra::FlatCopy<LinearAlgebra::bfloat16> > bf16_parameters;
+        std::shared_ptr<LinearAlgebra::FlatCopy<LinearAlgebra::float16> > fp16_parameters;
+
+        // number of samples per update, and a column of that many ones for broadcasting the bias
+        nnint batch_size;
+        Matrix ones;
+        // number of samples the gradients of the current pass are averaged over
+        nnint samples;
+
+        // extra workers for parallel training, sharing the weights of this network, and the loss each
+        // worker (this one first) had in the current step
+        std::vector<std::unique_ptr<NeuralNet> > replicas;
+        std::vector<T> worker_loss;
+        Parallelism parallelism;
+
+        // training workspace, sized from layer_size and batch_size outside of any step:
+        // error signal of each weight layer, packed batches, and an arena for every temporary a step makes
+        Matrix *deltas;
+        Matrix batch_input, batch_answer;
+        LinearAlgebra::Arena workspace;
+        // heap blocks taken by Matrix storage during the last step, and whether the arena has seen a full step
+        nnint step_allocations;
+        bool warmed_up;
+
+        // where and how often (in epochs, 0 for never) learn saves the weights, and epochs learnt so far
+        std::string checkpoint_path;
+        nnint checkpoint_every, epochs;
+
+        void reserve_workspace() {
+            nnint total = 0;
+            for (nnint i = 0; i < layers_count; i++) {
+                total += layer_size[i];
+            }
+            for (nnint i = 1; i < layers_count; i++) {
+                layers[i].resize(layer_size[i], batch_size);
+            }
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                if (keeps_logits(i)) {
+                    z[i].resize(layer_size[i + 1], batch_size);
+                }
+                deltas[i].resize(layer_size[i + 1], batch_size);
+                if (layer_binarization[i] != Binarization::None) {
+                    binarized[i].weights.resize(layer_size[i], layer_size[i + 1]);
+                    binarized[i].scale.resize(layer_size[i + 1], 1);
+                }
+                if (layer_binarization[i] == Binarization::Full) {
+                    binarized[i].input.resize(layer_size[i], batch_size);
+                }
+            }
+            ones = Matrix::Ones(batch_size, 1);
+            batch_input.resize(layer_size[0], batch_size);
+            batch_answer.resize(layer_size[layers_count - 1], batch_size);
+            // activations and their derivatives return new matrices and take copies, a few per layer
+            workspace.reserve(8 * total * batch_size * sizeof(T));
+            warmed_up = false;
+        }
+
+        // one forward/backward pass filling gradients, averaged over samples, and returning the loss;
+        // everything it allocates comes from the workspace arena
+        T pass(ConstView input, ConstView answer, nnint samples) {
+            nnint const before = LinearAlgebra::heap_allocations();
+            T ret;
+            {
+                LinearAlgebra::Arena::Scope scope(workspace);
+                this->samples = samples;
+                forward(input);
+                backward(answer);
+                ret = loss != Loss::Custom ? last_loss
+                                           : custom_loss.error ? custom_loss.error(result(), answer) : error(answer);
+            }
+            step_allocations = LinearAlgebra::heap_allocations() - before;
+#ifdef BNN_CHECK_ALLOCATIONS
+            // steady-state steps must not touch the heap
+            assert(!warmed_up || step_allocations == 0);
+#endif
+            warmed_up = true;
+            workspace.reset();
+            return ret;
+        }
+
+        // called after every epoch of learn
+        T end_epoch(T loss) {
+            epochs++;
+            if (checkpoint_every != 0 && epochs % checkpoint_every == 0) {
+                // a failed write leaves the previous checkpoint in place
+                save(checkpoint_path);
+            }
+            return loss;
+        }
+
+        NeuralNet &worker(nnint k) {
+            return k == 0 ? *this : *replicas[k - 1];
+        }
+
+        // the batch split column-wise across the workers, each one's gradients summed into this one's
+        T parallel_pass(ConstView input, ConstView answer) {
+            LinearAlgebra::ThreadPool &pool = LinearAlgebra::ThreadPool::instance();
+            nnint const batch = input.get_col(), shards = std::min(replicas.size() + 1, batch);
+            // the heap counter is process-wide, so every worker's own count would include the others'
+            nnint const before = LinearAlgebra::heap_allocations();
+            pool.run(shards, [&](nnint k) {
+                nnint const first = batch * k / shards, count = batch * (k + 1) / shards - first;
+                worker_loss[k] = worker(k).pass(input.col_block(first, count), answer.col_block(first, count), batch);
+            });
+            // pairwise tree: after the round with stride s, worker k holds the sum over workers k .. k + 2s - 1
+            for (nnint s = 1; s < shards; s *= 2) {
+                pool.run((shards + 2 * s - 1) / (2 * s), [&](nnint pair) {
+                    nnint const k = 2 * s * pair;
+                    if (k + s < shards) {
+                        worker(k).gradients.flat() += worker(k + s).gradients.flat();
+                        worker_loss[k] += worker_loss[k + s];
+                    }
+                });
+            }
+            step_allocations = LinearAlgebra::heap_allocations() - before;
+            return worker_loss[0];
+        }
+
+        // one update from one batch
+        T step(ConstView input, ConstView answer) {
+            BNN_PROFILE_SCOPE("step", -1, 0, 0);
+            T const ret = replicas.empty() ? pass(input, answer, input.get_col()) : parallel_pass(input, answer);
+            // every gradient is taken with the weights of the forward pass, then all of them move at once
+            BNN_PROFILE_SCOPE("update", -1, 0, 3 * parameters.size() * sizeof(T));
+            optimizer->step(parameters, gradients);
+            updated();
+            return ret;
+        }
+
+        // whether nothing but the optimizer writes to what the passes read, and the optimizer writes nothing
+        // but the weights, as Hogwild needs
+        bool hogwild_safe() const {
+            if (!optimizer->stateless()) {
+                return false;
+            }
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                if (layer_binarization[i] != Binarization::None) {
+                    return false;
+                }
+            }
+            return precision == Precision::Full;
+        }
+
+        // every worker takes whole batches in turn and updates the shared weights as soon as it has
+        // its gradients, without waiting for or locking out the others
+        T learn_hogwild(ConstView input, ConstView answer) {
+            // clipping latent weights or rounding a 16-bit copy would rewrite what the other workers read,
+            // and every worker would read and write the same momentum or moments
+            assert(hogwild_safe());
+            nnint const test_case_count = input.get_col();
+            nnint const batches = (test_case_count + batch_size - 1) / batch_size;
+            nnint const workers = std::min(replicas.size() + 1, batches);
+            LinearAlgebra::ThreadPool::instance().run(workers, [&](nnint k) {
+                NeuralNet &net = worker(k);
+                T sum = 0;
+                for (nnint b = k; b < batches; b += workers) {
+                    nnint const first = b * batch_size, batch = std::min(batch_size, test_case_count - first);
+                    sum += net.pass(input.col_block(first, batch), answer.col_block(first, batch), batch);
+                    optimizer->step(parameters, net.gradients);
+                }
+                worker_loss[k] = sum;
+            });
+            // once, on this thread, after the workers are done
+            updated();
+            T ret = 0;
+            for (nnint k = 0; k < workers; k++) {
+                ret += worker_loss[k];
+            }
+            return ret / test_case_count;
+        }
+
+        // f(weights[i]) with the weights as the products read them: binarized, or in their precision
+        template<typename F>
+        void with_weights(nnint i, F &&f) const {
+            if (layer_binarization[i] != Binarization::None) {
+                f(ConstView(binarized[i].weights));
+                return;
+            }
+            switch (precision) {
+                case Precision::BFloat16:
+                    f(bf16_parameters->view(2 * i));
+                    break;
+                case Precision::Float16:
+                    f(fp16_parameters->view(2 * i));
+                    break;
+                default:
+                    f(ConstView(weights[i]));
+            }
+        }
+
+        // after every update of the weights: keep the latent weights of binarized layers within [-1, 1] and
+        // round the 16-bit copy
+        void updated() {
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                if (layer_binarization[i] != Binarization::None) {
+                    clip_latent(weights[i]);
+                }
+            }
+            round_parameters();
+        }
+
+        // bring the 16-bit copy up to date with the weights, in one pass
+        void round_parameters() {
+            if (precision == Precision::BFloat16) {
+                bf16_parameters->copy_from(parameters);
+            } else if (precision == Precision::Float16) {
+                fp16_parameters->copy_from(parameters);
+            }
+        }
+
+        // point weights and bias into parameters, and give this network gradients of the same layout
+        void share(LinearAlgebra::FlatBuffer<T> &parameters) {
+            gradients = LinearAlgebra::FlatBuffer<T>::zeros_like(parameters);
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                weights[i] = parameters.view(2 * i);
+                bias[i] = parameters.view(2 * i + 1);
+                wm[i] = gradients.view(2 * i);
+                bm[i] = gradients.view(2 * i + 1);
+            }
+        }
+
+        struct Replica {};
+
+        // a worker for parallel training: the weights of master, everything else its own
+        NeuralNet(NeuralNet &master, Replica)
+                : layers_count(master.layers_count), layer_size(new nnint[master.layers_count]),
+                  inner_function(master.inner_function), outer_function(master.outer_function),
+                  dinner_function(master.dinner_function), douter_function(master.douter_function),
+                  layer_activation(new Activation[master.layers_count - 1]),
+                  layer_binarization(new Binarization[master.layers_count - 1]),
+                  binarized(new Binarized[master.layers_count - 1]), loss(master.loss), last_loss(0),
+                  custom_loss(master.custom_loss), layers(new Matrix[master.layers_count]), weights(new View[master.layers_count - 1]),
+                  z(new Matrix[master.layers_count - 1]), bias(new View[master.layers_count - 1]),
+                  alpha(master.alpha), wm(new View[master.layers_count - 1]),
+                  bm(new View[master.layers_count - 1]), precision(master.precision),
+                  bf16_parameters(master.bf16_parameters), fp16_parameters(master.fp16_parameters),
+                  batch_size(master.batch_size), samples(0), parallelism(Parallelism::Synchronous),
+                  deltas(new Matrix[master.layers_count - 1]), step_allocations(0), warmed_up(false),
+                  checkpoint_every(0), epochs(0) {
+            std::copy(master.layer_size, master.layer_size + layers_count, layer_size);
+            std::copy(master.layer_activation, master.layer_activation + layers_count - 1, layer_activation);
+            std::copy(master.layer_binarization, master.layer_binarization + layers_count - 1, layer_binarization);
+            share(master.parameters);
+            reserve_workspace();
+        }
+
     protected:
         virtual void init(nnint const *layer_size) {
             std::copy(layer_size, layer_size + layers_count, this->layer_size);
             std::random_device rd;
-            for (nnint i = 0; i < layers_count; i++) {
-                layers[i] = Matrix(layer_size[i], 1);
+            std::vector<std::pair<nnint, nnint> > shapes;
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                shapes.emplace_back(layer_size[i], layer_size[i + 1]);
+                shapes.emplace_back(layer_size[i + 1], 1);
             }
+            // biases start at zero
+            parameters = LinearAlgebra::FlatBuffer<T>(shapes);
+            share(parameters);
             for (nnint i = 0; i < layers_count - 1; i++) {
-                wm[i] = weights[i] = Matrix(layer_size[i], layer_size[i + 1], rd, 0, 0.3);
-                z[i] = Matrix(layer_size[i + 1], 1);
-                bm[i] = bias[i] = Matrix(layer_size[i + 1], 1);
+                weights[i].assign(Matrix(layer_size[i], layer_size[i + 1], rd, 0, 0.3));
+            }
+            if (!optimizer) {
+                optimizer = std::make_unique<Optimizer::SGD<T> >(alpha, static_cast<T>(0.9));
+            }
+            optimizer->bind(parameters);
+            reserve_workspace();
+        }
+
+        // weight layer i writes z before activating, rather than activating in place
+        bool keeps_logits(nnint i) const {
+            return layer_activation[i] == Activation::Custom ||
+                   (i + 2 == layers_count && (loss == Loss::SigmoidCrossEntropy || loss == Loss::SoftmaxCrossEntropy));
+        }
+
+        // activations feeding weight layer i
+        ConstView activation(nnint i) const {
+            return i == 0 ? input : layers[i].view();
+        }
+
+        // multiply-adds of a product of weight layer i over batch samples, and the bytes of its operands, for
+        // the profiler
+        double multiply_adds(nnint i, nnint batch) const {
+            return static_cast<double>(layer_size[i] * layer_size[i + 1] * batch);
+        }
+        double product_bytes(nnint i, nnint batch) const {
+            return static_cast<double>((layer_size[i] * layer_size[i + 1] + (layer_size[i] + layer_size[i + 1]) * batch) *
+                                       sizeof(T));
+        }
+
+        // the binarized weights of layer i, and for Full its binarized input, from the latent weights and
+        // activations of this pass
+        void binarize_layer(nnint i) {
+            if (layer_binarization[i] == Binarization::None) {
+                return;
+            }
+            Binarized &b = binarized[i];
+            binarize_weights(ConstView(weights[i]), b.scale.view(), b.weights.view());
+            if (layer_binarization[i] == Binarization::Full) {
+                ConstView const a = activation(i);
+                b.input.resize(a.get_row(), a.get_col());
+                binarize(a, b.input.view());
+                b.weight_bits.pack(weights[i]);
+                b.input_bits.pack(a);
             }
         }
 
         // forward propagation
-        virtual void forward(Matrix input) {
-            assert(input.get_row() == layer_size[0] && input.get_col() == 1);
+        // input holds one sample per column and must stay alive until the matching backward
+        virtual void forward(ConstView input) {
+            assert(input.get_row() == layer_size[0] && input.get_col() != 0);
             //std::cout << "FORWARD : input is :\n" << input << '\n';
-            layers[0] = input;
-            for (nnint i = 0; i < layers_count - 2; i++) {
-                layers[i + 1] = inner_function(z[i] = (weights[i].transposed() * layers[i] + bias[i]));
+            BNN_PROFILE_SCOPE("forward", -1, 0, 0);
+            nnint const batch = input.get_col();
+            if (ones.get_row() != batch) {
+                ones.resize(batch, 1);
+                ones.fill(static_cast<T>(1));
+            }
+            this->input = input;
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                bool const custom = layer_activation[i] == Activation::Custom;
+                Matrix &out = keeps_logits(i) ? z[i] : layers[i + 1];
+                out.resize(layer_size[i + 1], batch);
+                {
+                    BNN_PROFILE_SCOPE("forward.product", i, 2 * multiply_adds(i, batch), product_bytes(i, batch));
+                    // z = weights^T * layer + bias * ones^T, reading weights in place
+                    binarize_layer(i);
+                    if (layer_binarization[i] == Binarization::Full) {
+                        Binarized const &b = binarized[i];
+                        xnor_gemm(b.weight_bits, b.input_bits, b.scale, out);
+                    } else {
+                        with_weights(i, [&](auto const &w) {
+                            gemm(LinearAlgebra::Transpose::Trans, LinearAlgebra::Transpose::NoTrans,
+                                 static_cast<T>(1), w, activation(i), static_cast<T>(0), out);
+                        });
+                    }
+                    ger(static_cast<T>(1), bias[i], ones, out);
+                }
+                BNN_PROFILE_SCOPE("forward.activation", i, 0, 2 * layer_size[i + 1] * batch * sizeof(T));
+                layers[i + 1].resize(layer_size[i + 1], batch);
+                if (custom) {
+                    (i + 2 < layers_count ? inner_function : outer_function)(z[i], layers[i + 1]);
+                } else {
+                    activate<T>(layer_activation[i], out, layers[i + 1]);
+                }
             }
-            layers[layers_count - 1] = outer_function(
-                    z[layers_count - 2] = (weights[layers_count - 2].transposed() * layers[layers_count - 2] + bias[layers_count - 2]));
             //std::cout << "FORWARD : output is :\n" << layers[layers_count - 1] << '\n';
         }
 
@@ -98,59 +491,187 @@ namespace Net {
             return layers[layers_count - 1];
         }
 
-        // error function
-        virtual T const error(Matrix trueValue) const {
+        // error function for Loss::Custom
+        virtual T const error(ConstView trueValue) const {
             /*T sum = 0;
             for (nnint i = 0; i < layer_size[layers_count - 1]; i++) {
                 sum += (layers[layers_count - 1](i, 0) - trueValue(i, 0)) * (layers[layers_count - 1](i, 0) - trueValue(i, 0));
             }
             return sum / 2;*/
-            // TODO : error function must be a choice of clients!
+            // summed over every sample (column) of the batch
             T ret = 0;
             for (nnint i = 0; i < layer_size[layers_count - 1]; i++) {
-                T t = trueValue(i, 0);
-                T y = layers[layers_count-1](i, 0);
-                ret += (t-1) * log(1 - y) - t * log(y);
+                for (nnint j = 0; j < trueValue.get_col(); j++) {
+                    T t = trueValue(i, j);
+                    T y = layers[layers_count-1](i, j);
+                    ret += (t-1) * log(1 - y) - t * log(y);
+                }
             }
             return ret;
         }
 
-        //derivative of error function
-        virtual Matrix const derror(Matrix trueValue) const {
+        //derivative of error function for Loss::Custom
+        virtual Matrix const derror(ConstView trueValue) const {
             return layers[layers_count - 1] - trueValue;
         }
 
+        // gradients of the weights and bias feeding layer i + 1, averaged over the batch
+        // wm = layer * delta^T / samples, bm = delta * ones / samples
+        void gradient(nnint i, Matrix const &delta) {
+            BNN_PROFILE_SCOPE("backward.gradient", i, 2 * multiply_adds(i, delta.get_col()),
+                              product_bytes(i, delta.get_col()));
+            T const scale = static_cast<T>(1) / static_cast<T>(samples);
+            // a binarized layer passes the gradient of its sign weights straight on to the latent ones
+            ConstView const a = layer_binarization[i] == Binarization::Full ? binarized[i].input.view() : activation(i);
+            gemm(LinearAlgebra::Transpose::NoTrans, LinearAlgebra::Transpose::Trans,
+                 scale, a, delta, static_cast<T>(0), wm[i]);
+            gemv(LinearAlgebra::Transpose::NoTrans, scale, delta, ones, static_cast<T>(0), bm[i]);
+        }
+
+        // delta = delta * f'(z) for the activation of weight layer i
+        void differentiate(nnint i, Matrix &delta) {
+            BNN_PROFILE_SCOPE("backward.activation", i, 0, 3 * delta.get_row() * delta.get_col() * sizeof(T));
+            if (layer_activation[i] == Activation::Custom) {
+                (i + 2 < layers_count ? dinner_function : douter_function)(z[i], delta);
+            } else {
+                activate_backward<T>(layer_activation[i], layers[i + 1], delta);
+            }
+        }
+
         // back propagation
-        virtual void backward(Matrix trueValue) {
-            Matrix delta = elementwise_multiplied(derror(trueValue), douter_function(z[layers_count - 2]));
+        // trueValue holds one sample per column, matching the last forward
+        virtual void backward(ConstView trueValue) {
+            nnint const last = layers_count - 2;
+            BNN_PROFILE_SCOPE("backward", -1, 0, 0);
+            if (loss == Loss::Custom) {
+                if (custom_loss.derror) {
+                    deltas[last].resize(layer_size[last + 1], trueValue.get_col());
+                    custom_loss.derror(layers[last + 1], trueValue, deltas[last]);
+                } else {
+                    deltas[last] = derror(trueValue);
+                }
+                differentiate(last, deltas[last]);
+            } else {
+                BNN_PROFILE_SCOPE("backward.loss", last, 0, 3 * layer_size[last + 1] * trueValue.get_col() * sizeof(T));
+                // loss and output gradient in one pass; the cross-entropies already give it with respect to z
+                deltas[last].resize(layer_size[last + 1], trueValue.get_col());
+                last_loss = loss_and_gradient<T>(loss, keeps_logits(last) ? z[last].view() : ConstView(),
+                                                 layers[last + 1], trueValue, deltas[last]);
+                if (loss == Loss::MeanSquaredError) {
+                    differentiate(last, deltas[last]);
+                }
+            }
             for (nnint i = layers_count - 2; i > 0; i--) {
-                wm[i] = (wm[i] * 0.9) + (layers[i] * delta.transposed());
-                bm[i] = (bm[i] * 0.9) + (delta);
+                gradient(i, deltas[i]);
+                {
+                    BNN_PROFILE_SCOPE("backward.delta", i, 2 * multiply_adds(i, deltas[i].get_col()),
+                                      product_bytes(i, deltas[i].get_col()));
+                    deltas[i - 1].resize(layer_size[i], deltas[i].get_col());
+                    with_weights(i, [&](auto const &w) {
+                        gemm(LinearAlgebra::Transpose::NoTrans, LinearAlgebra::Transpose::NoTrans,
+                             static_cast<T>(1), w, deltas[i], static_cast<T>(0), deltas[i - 1]);
+                    });
+                    if (layer_binarization[i] == Binarization::Full) {
+                        straight_through(activation(i), deltas[i - 1].view());
+                    }
+                }
+                differentiate(i - 1, deltas[i - 1]);
+            }
+            gradient(0, deltas[0]);
+        }
 
-                weights[i] -= alpha * wm[i];
-                bias[i] -= alpha * bm[i];
-                delta = elementwise_multiplied(weights[i] * delta, dinner_function(z[i - 1]));
+        // activations for every weight layer, or all Custom when none are given
+        static std::vector<Activation> activations_of(nnint layers_count, Activation const *activations) {
+            std::vector<Activation> ret(layers_count - 1, Activation::Custom);
+            if (activations != nullptr) {
+                std::copy(activations, activations + layers_count - 1, ret.begin());
             }
-            wm[0] = (wm[0] * 0.9) + (layers[0] * delta.transposed());
-            bm[0] = (bm[0] * 0.9) + (delta);
-            weights[0] -= alpha * wm[0];
-            bias[0] -= alpha * bm[0];
+            return ret;
         }
 
-    public:
-        // constructor
-        NeuralNet(nnint layers_count, nnint const *layer_size, FunctionType inner_function,
-                  FunctionType outer_function, FunctionType dinner_function,
-                  FunctionType douter_function, T alpha = 0.01)
+        static std::vector<Activation> activations_of(nnint layers_count, Activation inner, Activation outer) {
+            std::vector<Activation> ret(layers_count - 1, inner);
+            ret.back() = outer;
+            return ret;
+        }
+
+        NeuralNet(nnint layers_count, nnint const *layer_size, std::vector<Activation> const &activations,
+                  CustomActivation<T> inner_function, CustomActivation<T> outer_function,
+                  CustomActivation<T> dinner_function, CustomActivation<T> douter_function, Loss loss, T alpha,
+                  nnint batch_size)
                 : layers_count(layers_count), layer_size(new nnint[layers_count]),
                   inner_function(std::move(inner_function)), outer_function(std::move(outer_function)),
                   dinner_function(std::move(dinner_function)), douter_function(std::move(douter_function)),
-                  layers(new Matrix[layers_count]), weights(new Matrix[layers_count - 1]),
-                  z(new Matrix[layers_count - 1]), bias(new Matrix[layers_count - 1]),
-                  alpha(alpha), wm(new Matrix[layers_count - 1]), bm(new Matrix[layers_count - 1]) {
+                  layer_activation(new Activation[layers_count - 1]),
+                  layer_binarization(new Binarization[layers_count - 1]),
+                  binarized(new Binarized[layers_count - 1]), loss(loss), last_loss(0),
+                  layers(new Matrix[layers_count]), weights(new View[layers_count - 1]),
+                  z(new Matrix[layers_count - 1]), bias(new View[layers_count - 1]),
+                  alpha(alpha), wm(new View[layers_count - 1]), bm(new View[layers_count - 1]),
+                  precision(Precision::Full), batch_size(batch_size), samples(0),
+                  parallelism(Parallelism::Synchronous),
+                  deltas(new Matrix[layers_count - 1]), step_allocations(0), warmed_up(false),
+                  checkpoint_every(0), epochs(0) {
+            assert(batch_size != 0);
+            std::copy(activations.begin(), activations.end(), layer_activation);
+            std::fill(layer_binarization, layer_binarization + layers_count - 1, Binarization::None);
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                assert(layer_activation[i] != Activation::Custom ||
+                       (i + 2 < layers_count ? this->inner_function && this->dinner_function
+                                             : this->outer_function && this->douter_function));
+            }
+            assert(loss != Loss::SigmoidCrossEntropy || layer_activation[layers_count - 2] == Activation::Sigmoid);
+            assert(loss != Loss::SoftmaxCrossEntropy || layer_activation[layers_count - 2] == Activation::Softmax);
             init(layer_size);
         }
 
+    public:
+        // constructor with user supplied activations and derivatives;
+        // by default error and derror are the loss, or MeanSquaredError can be picked
+        NeuralNet(nnint layers_count, nnint const *layer_size, FunctionType inner_function,
+                  FunctionType outer_function, FunctionType dinner_function,
+                  FunctionType douter_function, T alpha = 0.01, nnint batch_size = 1, Loss loss = Loss::Custom)
+                : NeuralNet(layers_count, layer_size, activations_of(layers_count, nullptr),
+                            custom_activation<T>(std::move(inner_function)), custom_activation<T>(std::move(outer_function)),
+                            custom_derivative<T>(std::move(dinner_function)), custom_derivative<T>(std::move(douter_function)),
+                            loss, alpha, batch_size) {}
+
+        // the same with activations and derivatives on one element, as Operators::UnaryOperator, e.g.
+        // Operators::unary(f); they run inlined in one fused loop per layer rather than as whole-matrix calls
+        template<typename F, typename G, typename DF, typename DG>
+        NeuralNet(nnint layers_count, nnint const *layer_size, Operators::UnaryOperator<F> inner_function,
+                  Operators::UnaryOperator<G> outer_function, Operators::UnaryOperator<DF> dinner_function,
+                  Operators::UnaryOperator<DG> douter_function, T alpha = 0.01, nnint batch_size = 1,
+                  Loss loss = Loss::Custom)
+                : NeuralNet(layers_count, layer_size, activations_of(layers_count, nullptr),
+                            custom_activation<T>(std::move(inner_function)), custom_activation<T>(std::move(outer_function)),
+                            custom_derivative<T>(std::move(dinner_function)), custom_derivative<T>(std::move(douter_function)),
+                            loss, alpha, batch_size) {}
+
+        // constructors with built-in activations, one for hidden layers and one for the output,
+        // or one per weight layer (layers_count - 1 of them); the cross-entropy losses need the
+        // matching output activation
+        NeuralNet(nnint layers_count, nnint const *layer_size, Activation inner, Activation outer,
+                  Loss loss = Loss::MeanSquaredError, T alpha = 0.01, nnint batch_size = 1)
+                : NeuralNet(layers_count, layer_size, activations_of(layers_count, inner, outer),
+                            nullptr, nullptr, nullptr, nullptr, loss, alpha, batch_size) {}
+
+        NeuralNet(nnint layers_count, nnint const *layer_size, Activation const *activations,
+                  Loss loss = Loss::MeanSquaredError, T alpha = 0.01, nnint batch_size = 1)
+                : NeuralNet(layers_count, layer_size, activations_of(layers_count, activations),
+                            nullptr, nullptr, nullptr, nullptr, loss, alpha, batch_size) {}
+
+        // a network with the layers, activations, loss and weights of a checkpoint, which must be valid
+        // and free of Custom activations; the optimizer starts afresh
+        explicit NeuralNet(Checkpoint<T> const &checkpoint, T alpha = 0.01, nnint batch_size = 1)
+                : NeuralNet(checkpoint.layers_count(), checkpoint.layer_size(),
+                            activations_of(checkpoint.layers_count(), checkpoint.layer_activation()),
+                            nullptr, nullptr, nullptr, nullptr, checkpoint.loss(), alpha, batch_size) {
+            bool const loaded = load(checkpoint);
+            assert(loaded && "In NeuralNet: invalid checkpoint!");
+            (void) loaded;
+        }
+
         // copy/move constructors/assignments deleted
         NeuralNet(NeuralNet const &) = delete;
 
@@ -160,29 +681,226 @@ namespace Net {
 
         NeuralNet &operator=(NeuralNet &&) = delete;
 
+        // make Loss::Custom the sum of l(a, t) over every output a and its answer t, with gradient dl(a, t),
+        // both Operators::BinomialOperator on one element, in place of the virtual error and derror
+        template<typename L, typename DL>
+        void set_custom_loss(Operators::BinomialOperator<L> l, Operators::BinomialOperator<DL> dl) {
+            assert(loss == Loss::Custom);
+            custom_loss = Net::custom_loss<T>(std::move(l), std::move(dl));
+            for (auto &replica : replicas) {
+                replica->custom_loss = custom_loss;
+            }
+        }
+
+        // replace the optimizer, starting it afresh on the current weights
+        void set_optimizer(std::unique_ptr<Optimizer::OptimizerBase<T> > optimizer) {
+            assert(optimizer);
+            this->optimizer = std::move(optimizer);
+            this->optimizer->bind(parameters);
+        }
+        Optimizer::OptimizerBase<T> &get_optimizer() {
+            return *optimizer;
+        }
+
+        // every weight and bias, and the gradients of the last step, each as one flat buffer
+        LinearAlgebra::FlatBuffer<T> &get_parameters() {
+            return parameters;
+        }
+        LinearAlgebra::FlatBuffer<T> const &get_parameters() const {
+            return parameters;
+        }
+        LinearAlgebra::FlatBuffer<T> const &get_gradients() const {
+            return gradients;
+        }
+
+        // write the weights, layer sizes, activations and loss to path; see Checkpoint.hpp.
+        // Returns false when the file cannot be written
+        bool save(std::string const &path) const {
+            return save_checkpoint(path, layers_count, layer_size, layer_activation, loss, parameters);
+        }
+
+        // take the weights of a checkpoint with the same layers, activations and loss, restarting the
+        // optimizer; returns false, leaving the weights alone, when it does not match
+        bool load(Checkpoint<T> const &checkpoint) {
+            if (!checkpoint.valid() || checkpoint.layers_count() != layers_count || checkpoint.loss() != loss ||
+                !std::equal(layer_size, layer_size + layers_count, checkpoint.layer_size()) ||
+                !std::equal(layer_activation, layer_activation + layers_count - 1, checkpoint.layer_activation())) {
+                return false;
+            }
+            for (nnint i = 0; i < layers_count - 1; i++) {
+                weights[i].assign(checkpoint.weights(i));
+                bias[i].assign(checkpoint.bias(i));
+            }
+            optimizer->bind(parameters);
+            round_parameters();
+            return true;
+        }
+
+        // save to path after every every-th epoch of learn, 0 to stop; a checkpoint costs one write of the
+        // parameter buffer
+        void set_checkpoint(std::string path, nnint every) {
+            checkpoint_path = std::move(path);
+            checkpoint_every = every;
+        }
+
+        // samples per weight update used by learn
+        void set_batch_size(nnint batch_size) {
+            assert(batch_size != 0);
+            this->batch_size = batch_size;
+            reserve_workspace();
+            for (auto &replica : replicas) {
+                replica->batch_size = batch_size;
+                replica->reserve_workspace();
+            }
+        }
+        nnint get_batch_size() const {
+            return batch_size;
+        }
+
+        // train with threads workers on the shared thread pool: this network and threads - 1 replicas that
+        // share its weights but have their own activations, gradients and workspace.
+        // Synchronous splits every batch across the workers and applies their summed gradients in one update,
+        // giving the same steps as one thread. Hogwild (learn from a dataset view only) has each worker run
+        // whole batches and update the weights without any locking, trading exactness for no waiting. It
+        // needs full precision, no binarized layer and an optimizer without state, i.e. set_optimizer with
+        // a plain SGD: the default momentum, and the moments of Adam and AdamW, would be read and written by
+        // every worker at once.
+        // Replicas are plain NeuralNets calling the same Custom activations and losses, which must then be
+        // thread-safe.
+        void set_threads(nnint threads, Parallelism parallelism = Parallelism::Synchronous) {
+            assert(threads != 0);
+            replicas.clear();
+            for (nnint i = 1; i < threads; i++) {
+                replicas.emplace_back(new NeuralNet(*this, Replica()));
+            }
+            worker_loss.assign(threads, 0);
+            this->parallelism = parallelism;
+        }
+        nnint get_threads() const {
+            return replicas.size() + 1;
+        }
+
+        // make forward and backward propagation read the weights rounded to bfloat16 or float16, halving the
+        // bytes the products stream from memory for large layers; they still accumulate in full precision,
+        // and the optimizer updates a full precision master copy, rounded again after every update.
+        // Activations and gradients stay in full precision
+        void set_precision(Precision precision) {
+            this->precision = precision;
+            bf16_parameters.reset();
+            fp16_parameters.reset();
+            if (precision == Precision::BFloat16) {
+                bf16_parameters = std::make_shared<LinearAlgebra::FlatCopy<LinearAlgebra::bfloat16> >(parameters);
+            } else if (precision == Precision::Float16) {
+                fp16_parameters = std::make_shared<LinearAlgebra::FlatCopy<LinearAlgebra::float16> >(parameters);
+            }
+            for (auto &replica : replicas) {
+                replica->precision = precision;
+                replica->bf16_parameters = bf16_parameters;
+                replica->fp16_parameters = fp16_parameters;
+            }
+        }
+        Precision get_precision() const {
+            return precision;
+        }
+
+        // binarize weight layer i (see Binary.hpp): Weights multiplies by the signs of its weights, scaled per
+        // output, and Full by the signs of its input too, bit-packed and multiplied with XNOR and popcount.
+        // Training updates real-valued latent weights, clipped to [-1, 1], through a straight-through
+        // estimator; binarized layers ignore set_precision. Checkpoints hold the latent weights only, so
+        // binarize again after loading one
+        void set_binarization(nnint i, Binarization binarization) {
+            assert(i < layers_count - 1);
+            layer_binarization[i] = binarization;
+            reserve_workspace();
+            for (auto &replica : replicas) {
+                replica->layer_binarization[i] = binarization;
+                replica->reserve_workspace();
+            }
+        }
+        Binarization get_binarization(nnint i) const {
+            assert(i < layers_count - 1);
+            return layer_binarization[i];
+        }
+
         // learn
+        // input and answer hold one column vector per test case; returns the mean error per case
         T learn(nnint test_case_count, Matrix *input, Matrix *answer) {
+            BNN_PROFILE_SCOPE("epoch", -1, 0, 0);
+            if (batch_size > 1) {
+                return learn_batched(test_case_count, input, answer);
+            }
             T ret = 0;
             for (nnint i = 0; i < test_case_count; i++) {
-                forward(input[i]);
-                //std::cout << "weights and bias :\n";
-                for(nnint j = 0; j < layers_count - 1; j++) {
-                    //std::cout << '#' << j + 1 <<'\n';
-                    //std::cout << weights[j] << '\n';
-                    //std::cout << bias[j] << '\n';
+                ret += step(input[i], answer[i]);
+            }
+            return end_epoch(ret / test_case_count);
+        }
+
+        // learn from one dataset holding a test case per column, e.g. a Matrix or a view into a file buffer;
+        // batches are views into it, so nothing is copied
+        T learn(ConstView input, ConstView answer) {
+            assert(input.get_row() == layer_size[0] && answer.get_row() == layer_size[layers_count - 1]);
+            assert(input.get_col() == answer.get_col() && input.get_col() != 0);
+            BNN_PROFILE_SCOPE("epoch", -1, 0, 0);
+            if (parallelism == Parallelism::Hogwild && !replicas.empty()) {
+                return end_epoch(learn_hogwild(input, answer));
+            }
+            nnint const test_case_count = input.get_col();
+            T ret = 0;
+            for (nnint first = 0; first < test_case_count; first += batch_size) {
+                nnint const batch = std::min(batch_size, test_case_count - first);
+                ret += step(input.col_block(first, batch), answer.col_block(first, batch));
+            }
+            return end_epoch(ret / test_case_count);
+        }
+
+        // learn one epoch from the batches of a loader, which is best given the batch size of this network;
+        // they are packed in the background while this trains
+        T learn(Data::BatchLoader<T> &loader) {
+            BNN_PROFILE_SCOPE("epoch", -1, 0, 0);
+            T ret = 0;
+            ConstView input, answer;
+            while (loader.next(input, answer)) {
+                assert(input.get_row() == layer_size[0] && answer.get_row() == layer_size[layers_count - 1]);
+                ret += step(input, answer);
+            }
+            return end_epoch(ret / loader.size());
+        }
+
+        // learn with one averaged update per batch_size cases, packed as columns of one matrix
+        T learn_batched(nnint test_case_count, Matrix *input, Matrix *answer) {
+            nnint const in_size = layer_size[0], out_size = layer_size[layers_count - 1];
+            T ret = 0;
+            for (nnint first = 0; first < test_case_count; first += batch_size) {
+                nnint const batch = std::min(batch_size, test_case_count - first);
+                batch_input.resize(in_size, batch);
+                batch_answer.resize(out_size, batch);
+                for (nnint j = 0; j < batch; j++) {
+                    for (nnint r = 0; r < in_size; r++) {
+                        batch_input(r, j) = input[first + j](r, 0);
+                    }
+                    for (nnint r = 0; r < out_size; r++) {
+                        batch_answer(r, j) = answer[first + j](r, 0);
+                    }
                 }
-                backward(answer[i]);
-                ret += error(answer[i]);
+                ret += step(batch_input, batch_answer);
             }
-            return ret / test_case_count;
+            return end_epoch(ret / test_case_count);
+        }
+
+        // heap blocks Matrix storage took during the most recent training step, over all workers;
+        // zero once the workspace has warmed up, which tests can assert on
+        nnint last_step_allocations() const {
+            return step_allocations;
         }
 
         // print
-        void print_case(std::ostream &os, Matrix input, Matrix expectedOutput) {
-            os << "Input is :" << '\n' << input.transposed() << '\n';
+        void print_case(std::ostream &os, ConstView input, ConstView expectedOutput) {
+            os << "Input is :" << '\n' << Matrix(input).transposed() << '\n';
+            samples = input.get_col();
             forward(input);
             os << "Output is :" << '\n' << layers[layers_count - 1].transposed() << '\n';
-            os << "Expected output is :" << '\n' << expectedOutput.transposed() << '\n';
+            os << "Expected output is :" << '\n' << Matrix(expectedOutput).transposed() << '\n';
         }
 
         // destructor
@@ -194,6 +912,10 @@ namespace Net {
             delete[] layer_size;
             delete[] wm;
             delete[] bm;
+            delete[] deltas;
+            delete[] layer_activation;
+            delete[] layer_binarization;
+            delete[] binarized;
         }
     };
 
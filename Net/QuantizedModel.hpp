@@ -0,0 +1,245 @@
+#ifndef BNN_Net_QuantizedModel_hpp
+#define BNN_Net_QuantizedModel_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <vector>
+#include "Activation.hpp"
+#include "InferenceModel.hpp"
+#include "NeuralNet.hpp"
+#include "../LinearAlgebra/Kernels/Int8.hpp"
+#include "../LinearAlgebra/Matrix.hpp"
+
+namespace Net {
+
+    /*
+     * A trained NeuralNet quantized to int8 after training, for inference only.
+     * The weights of each output are rounded to int8 with the scale max |w| / 127. The input of each layer is
+     * rounded to [0, 127] with a scale and a zero point covering the range it took over calibration samples,
+     * run through the float network when the model is built; the range always includes 0, which is then
+     * exact. A layer is one int8 x uint8 -> int32 product (Kernels/Int8.hpp), dequantized with the bias into
+     * floats for the activation, whose output is quantized again as the input of the next layer.
+     * Like InferenceModel, predict is const and keeps its scratch per thread, so threads can share a model.
+     */
+    template<typename T>
+    class QuantizedModel {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        using View = LinearAlgebra::MatrixView<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        struct Layer {
+            // out rows of int8 weights, padded bytes each
+            std::vector<std::int8_t> weights;
+            nnint padded;
+            // quantization of the input
+            T input_scale;
+            int input_zero;
+            // per output: weight scale times input scale, input_zero times the sum of the row, and the bias
+            std::vector<T> scale;
+            std::vector<std::int32_t> offset;
+            std::vector<T> bias;
+        };
+
+        std::vector<nnint> layer_size;
+        std::vector<Activation> layer_activation;
+        std::vector<Layer> layers;
+        CustomActivation<T> inner_function, outer_function;
+        nnint widest;
+
+        void activate_layer(nnint i, View out) const {
+            if (layer_activation[i] == Activation::Custom) {
+                (i + 2 < layer_size.size() ? inner_function : outer_function)(out, out);
+            } else {
+                activate<T>(layer_activation[i], out, out);
+            }
+        }
+
+        // the int8 weights of layer i from w(in x out), once its input quantization is known
+        static void quantize_weights(Layer &layer, ConstView w, ConstView bias) {
+            nnint const in = w.get_row(), out = w.get_col();
+            layer.padded = LinearAlgebra::Kernels::int8_padded(in);
+            layer.weights.assign(out * layer.padded, 0);
+            layer.scale.resize(out);
+            layer.offset.resize(out);
+            layer.bias.resize(out);
+            for (nnint o = 0; o < out; o++) {
+                T largest = 0;
+                for (nnint p = 0; p < in; p++) {
+                    largest = std::max(largest, std::abs(w(p, o)));
+                }
+                T const scale = largest > 0 ? largest / 127 : static_cast<T>(1);
+                std::int32_t sum = 0;
+                for (nnint p = 0; p < in; p++) {
+                    auto const q = static_cast<std::int8_t>(std::lround(w(p, o) / scale));
+                    layer.weights[o * layer.padded + p] = q;
+                    sum += q;
+                }
+                layer.scale[o] = scale * layer.input_scale;
+                layer.offset[o] = layer.input_zero * sum;
+                layer.bias[o] = bias(o, 0);
+            }
+        }
+
+        // scale and zero point mapping the range of x, widened to include 0, onto [0, 127]
+        static void quantize_input(Layer &layer, ConstView x) {
+            T lo = 0, hi = 0;
+            for (nnint r = 0; r < x.get_row(); r++) {
+                for (nnint c = 0; c < x.get_col(); c++) {
+                    lo = std::min(lo, x(r, c));
+                    hi = std::max(hi, x(r, c));
+                }
+            }
+            if (hi == lo) {
+                hi = lo + 1;
+            }
+            constexpr int top = LinearAlgebra::Kernels::uint8_activation_max;
+            layer.input_scale = (hi - lo) / top;
+            layer.input_zero = static_cast<int>(std::min<long>(std::max<long>(std::lround(-lo / layer.input_scale), 0), top));
+        }
+
+    public:
+        // calibration holds sample inputs, one per column, representative of what the model will see;
+        // the network must not have binarized layers, which have their own 1-bit inference
+        QuantizedModel(NeuralNet<T> const &net, ConstView calibration)
+                : layer_size(net.layer_size, net.layer_size + net.layers_count),
+                  layer_activation(net.layer_activation, net.layer_activation + net.layers_count - 1),
+                  layers(net.layers_count - 1),
+                  inner_function(net.inner_function), outer_function(net.outer_function),
+                  widest(*std::max_element(net.layer_size, net.layer_size + net.layers_count)) {
+            assert(calibration.get_row() == layer_size.front() && calibration.get_col() != 0);
+            // the float forward pass, recording the range of every layer's input
+            Matrix in(calibration), out;
+            Matrix const ones = Matrix::Ones(calibration.get_col(), 1);
+            for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+                assert(net.layer_binarization[i] == Binarization::None);
+                quantize_input(layers[i], in);
+                quantize_weights(layers[i], net.weights[i], net.bias[i]);
+                out.resize(layer_size[i + 1], calibration.get_col());
+                gemm(LinearAlgebra::Transpose::Trans, LinearAlgebra::Transpose::NoTrans, static_cast<T>(1),
+                     net.weights[i], in, static_cast<T>(0), out);
+                ger(static_cast<T>(1), net.bias[i], ones, out);
+                activate_layer(i, out);
+                std::swap(in, out);
+            }
+        }
+
+        nnint input_size() const {
+            return layer_size.front();
+        }
+        nnint output_size() const {
+            return layer_size.back();
+        }
+
+        // bytes the weights of all layers take
+        nnint weight_bytes() const {
+            nnint ret = 0;
+            for (Layer const &layer : layers) {
+                ret += layer.weights.size();
+            }
+            return ret;
+        }
+
+        // output = the network applied to input, both holding one sample per column
+        void predict(ConstView input, View output) const {
+            assert(input.get_row() == input_size() && input.get_col() != 0);
+            assert(output.get_row() == output_size() && output.get_col() == input.get_col());
+            namespace Kernels = LinearAlgebra::Kernels;
+            nnint const batch = input.get_col(), ld = Matrix::padded(batch);
+            // quantized input, products, and hidden layers alternating between two buffers, all of this thread
+            std::uint8_t *const packed = Kernels::detail::pack_buffer<std::uint8_t, 5>(batch * Kernels::int8_padded(widest));
+            std::int32_t *const products = Kernels::detail::pack_buffer<std::int32_t, 5>(widest * batch);
+            T *scratch[2] = {Kernels::detail::pack_buffer<T, 5>(widest * ld), Kernels::detail::pack_buffer<T, 6>(widest * ld)};
+            ConstView in = input;
+            for (nnint i = 0; i + 1 < layer_size.size(); i++) {
+                Layer const &layer = layers[i];
+                View const out = i + 2 < layer_size.size() ? View(scratch[i % 2], layer_size[i + 1], batch, ld) : output;
+                Kernels::quantize_uint8(layer_size[i], batch, in.data(), in.get_ld(), layer.input_scale, layer.input_zero,
+                                        layer.padded, packed);
+                Kernels::int8_gemm(layer_size[i + 1], batch, layer.padded, layer.weights.data(), packed, products, batch);
+                for (nnint o = 0; o < layer_size[i + 1]; o++) {
+                    std::int32_t const *p = products + o * batch;
+                    T *q = out.data() + o * out.get_ld();
+                    for (nnint j = 0; j < batch; j++) {
+                        q[j] = layer.scale[o] * static_cast<T>(p[j] - layer.offset[o]) + layer.bias[o];
+                    }
+                }
+                activate_layer(i, out);
+                in = out;
+            }
+        }
+
+        Matrix predict(ConstView input) const {
+            Matrix ret(output_size(), input.get_col());
+            predict(input, ret);
+            return ret;
+        }
+    };
+
+    // how far a quantized model is from the float model it came from, on the same inputs
+    template<typename T>
+    struct QuantizationReport {
+        // over every output: largest and mean absolute difference
+        T max_error, mean_error;
+        // samples whose largest output is the same in both
+        T agreement;
+        // samples whose largest output is that of the answer, when answers were given
+        bool answered;
+        T reference_accuracy, quantized_accuracy;
+    };
+
+    // compare the outputs of reference and model on input, one sample per column, and their accuracy against
+    // answer (as the largest output of each column) unless it is empty
+    template<typename T, typename X, typename A = LinearAlgebra::MatrixView<T const> >
+    QuantizationReport<T> compare(InferenceModel<T> const &reference, QuantizedModel<T> const &model,
+                                  X const &inputs, A const &answers = A()) {
+        LinearAlgebra::MatrixView<T const> const input = inputs.view(), answer = answers.view();
+        std::size_t const rows = reference.output_size(), batch = input.get_col();
+        assert(answer.get_col() == 0 || (answer.get_row() == rows && answer.get_col() == batch));
+        LinearAlgebra::Matrix<T> const expected = reference.predict(input), actual = model.predict(input);
+        // the largest output of each column
+        std::vector<std::size_t> expected_class(batch), actual_class(batch), answer_class(answer.get_col());
+        LinearAlgebra::argmax_cols(expected, expected_class.data());
+        LinearAlgebra::argmax_cols(actual, actual_class.data());
+        if (answer.get_col() != 0) {
+            LinearAlgebra::argmax_cols(answer, answer_class.data());
+        }
+        QuantizationReport<T> ret{0, 0, 0, answer.get_col() != 0, 0, 0};
+        for (std::size_t j = 0; j < batch; j++) {
+            for (std::size_t r = 0; r < rows; r++) {
+                T const d = std::abs(expected(r, j) - actual(r, j));
+                ret.max_error = std::max(ret.max_error, d);
+                ret.mean_error += d;
+            }
+            std::size_t const e = expected_class[j], a = actual_class[j];
+            ret.agreement += e == a;
+            if (ret.answered) {
+                std::size_t const t = answer_class[j];
+                ret.reference_accuracy += e == t;
+                ret.quantized_accuracy += a == t;
+            }
+        }
+        ret.mean_error /= static_cast<T>(rows * batch);
+        ret.agreement /= static_cast<T>(batch);
+        ret.reference_accuracy /= static_cast<T>(batch);
+        ret.quantized_accuracy /= static_cast<T>(batch);
+        return ret;
+    }
+
+    template<typename T>
+    std::ostream &operator<<(std::ostream &os, QuantizationReport<T> const &report) {
+        os << "int8 vs float: max error " << report.max_error << ", mean error " << report.mean_error
+           << ", same prediction " << 100 * report.agreement << "%";
+        if (report.answered) {
+            os << ", accuracy " << 100 * report.reference_accuracy << "% -> " << 100 * report.quantized_accuracy << "%";
+        }
+        return os;
+    }
+
+}
+
+#endif
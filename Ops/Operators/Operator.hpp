@@ -1,37 +1,105 @@
 #ifndef BNN_OperatorBase_hpp
 #define BNN_OperatorBase_hpp
 
-#include <functional>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "../../LinearAlgebra/Kernels/Simd.hpp"
+
+/*
+ * Elementwise operators for LinearAlgebra::map, zip, reduce and compute.
+ * An OperatorBase holds its functor by value and calls it directly, so the call inlines into the fused loop.
+ * A functor with `static constexpr bool vectorizable = true` also provides, like the operations of
+ * Expression.hpp,
+ *     template<typename V, typename P> BNN_ALWAYS_INLINE void packet(P &a) const;                  // size 1
+ *     template<typename V, typename P> BNN_ALWAYS_INLINE void packet(P &a, P const &b) const;      // size 2
+ * computing a = f(a) or f(a, b) on whole Kernels::Vec registers V, e.g.
+ *     struct ReLU {
+ *         static constexpr bool vectorizable = true;
+ *         template<typename T> T operator()(T x) const { return x > 0 ? x : 0; }
+ *         template<typename V, typename P> BNN_ALWAYS_INLINE void packet(P &x) const { x = V::max(x, V::zero()); }
+ *     };
+ * packet must be always-inline: only then does it end up in the kernel built for the instruction set of V.
+ * Other functors, lambdas among them, are called on one element at a time.
+ */
 
 namespace Operators {
 
-    template<typename FuncOut, std::size_t size, typename ...Ts>
-    class OperatorBase {
-        using Function = std::function<FuncOut(Ts...)>;
+    namespace detail {
+
+        template<typename F, typename = void>
+        constexpr bool is_vectorizable_v = false;
+        template<typename F>
+        constexpr bool is_vectorizable_v<F, std::enable_if_t<F::vectorizable> > = true;
 
-        Function const &Operator;
+    }
+
+    template<typename F, std::size_t size>
+    class OperatorBase {
+        F function;
 
     public:
+        static constexpr std::size_t arity = size;
+        static constexpr bool vectorizable = detail::is_vectorizable_v<F>;
+
         // constructor
-        explicit constexpr OperatorBase(Function F)
-                : Operator(F) {
-            static_assert(size == sizeof...(Ts),
-                          "In OperatorBase: size of parameter pack does not match the size given!");
-        }
+        constexpr explicit OperatorBase(F f) : function(std::move(f)) {}
 
-        // operator()
+        // operator(); only for arguments F takes, so that std::function and overloads can tell
         template<typename ...Is>
-        constexpr FuncOut operator()(Is... is) {
-            return Operator(is...);
+        constexpr auto operator()(Is &&...is) const -> decltype(std::declval<F const &>()(std::forward<Is>(is)...)) {
+            static_assert(sizeof...(Is) == size, "In OperatorBase: number of arguments does not match the size given!");
+            return function(std::forward<Is>(is)...);
+        }
+
+        // the same on registers, for a vectorizable functor
+        template<typename V, typename ...Ps>
+        BNN_ALWAYS_INLINE void packet(Ps &...ps) const {
+            static_assert(sizeof...(Ps) == size, "In OperatorBase: number of arguments does not match the size given!");
+            function.template packet<V>(ps...);
         }
     };
 
-    template<typename FuncOut>
-    using BinomialOperator = OperatorBase<FuncOut, 2>;
+    template<typename F>
+    using BinomialOperator = OperatorBase<F, 2>;
+
+    template<typename F>
+    using UnaryOperator = OperatorBase<F, 1>;
+
+    template<typename F>
+    constexpr UnaryOperator<F> unary(F f) {
+        return UnaryOperator<F>(std::move(f));
+    }
+
+    template<typename F>
+    constexpr BinomialOperator<F> binomial(F f) {
+        return BinomialOperator<F>(std::move(f));
+    }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+    // a + b, e.g. to sum with reduce(binomial(Plus()), 0, e)
+    struct Plus {
+        static constexpr bool vectorizable = true;
+
+        template<typename T>
+        constexpr T operator()(T a, T b) const {
+            return a + b;
+        }
+
+        template<typename V, typename P>
+        BNN_ALWAYS_INLINE void packet(P &a, P const &b) const {
+            a = V::add(a, b);
+        }
+    };
 
-    template<typename FuncOut>
-    using UnaryOperator = OperatorBase<FuncOut, 1>;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
 }
 
-#endif
\ No newline at end of file
+#endif
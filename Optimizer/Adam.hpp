@@ -0,0 +1,119 @@
+#ifndef BNN_Optimizer_Adam_hpp
+#define BNN_Optimizer_Adam_hpp
+
+#include <cassert>
+#include <cmath>
+#include "OptimizerBase.h"
+#include "../LinearAlgebra/Kernels/Gemm.hpp"
+
+namespace Optimizer {
+
+    namespace detail {
+
+        using LinearAlgebra::Kernels::Isa;
+        using LinearAlgebra::Kernels::Vec;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // u = g + l2 * p, m = beta1 * m + (1 - beta1) * u, v = beta2 * v + (1 - beta2) * u^2,
+        // p = shrink * p - step_size * m / (sqrt(v) + epsilon), with the bias corrections folded
+        // into step_size and epsilon by the caller
+        struct AdamKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T *p, std::size_t ldp,
+                                              T const *g, std::size_t ldg, T *m, std::size_t ldm, T *v, std::size_t ldv,
+                                              T beta1, T beta2, T step_size, T epsilon, T l2, T shrink) {
+                for (std::size_t i = 0; i < row; i++) {
+                    T *pr = p + i * ldp, *mr = m + i * ldm, *vr = v + i * ldv;
+                    T const *gr = g + i * ldg;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type const b1 = V::set1(beta1), c1 = V::set1(1 - beta1);
+                        typename V::type const b2 = V::set1(beta2), c2 = V::set1(1 - beta2);
+                        typename V::type const s = V::set1(-step_size), e = V::set1(epsilon);
+                        typename V::type const d = V::set1(l2), k = V::set1(shrink);
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const pv = V::load(pr + j);
+                            typename V::type const u = V::fmadd(d, pv, V::load(gr + j));
+                            typename V::type const mv = V::fmadd(b1, V::load(mr + j), V::mul(c1, u));
+                            typename V::type const vv = V::fmadd(b2, V::load(vr + j), V::mul(c2, V::mul(u, u)));
+                            V::store(mr + j, mv);
+                            V::store(vr + j, vv);
+                            V::store(pr + j, V::fmadd(s, V::div(mv, V::add(V::sqrt(vv), e)), V::mul(k, pv)));
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        T const u = gr[j] + l2 * pr[j];
+                        mr[j] = beta1 * mr[j] + (1 - beta1) * u;
+                        vr[j] = beta2 * vr[j] + (1 - beta2) * u * u;
+                        pr[j] = shrink * pr[j] - step_size * mr[j] / (std::sqrt(vr[j]) + epsilon);
+                    }
+                }
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // Adam, with weight decay added to the gradient (L2 regularization)
+    template<typename T>
+    class Adam : public OptimizerBase<T> {
+        using typename OptimizerBase<T>::Buffer;
+
+        T beta1, beta2, epsilon, weight_decay;
+        // decay the weights directly instead of through the gradient, as AdamW does
+        bool decoupled;
+        // first and second moment of every parameter
+        Buffer m, v;
+
+    protected:
+        Adam(T alpha, T beta1, T beta2, T epsilon, T weight_decay, bool decoupled)
+                : OptimizerBase<T>(alpha), beta1(beta1), beta2(beta2), epsilon(epsilon),
+                  weight_decay(weight_decay), decoupled(decoupled) {
+            assert(0 <= beta1 && beta1 < 1 && 0 <= beta2 && beta2 < 1);
+        }
+
+        void init(Buffer const &parameters) override {
+            m = Buffer::zeros_like(parameters);
+            v = Buffer::zeros_like(parameters);
+        }
+
+        void update(Buffer &parameters, Buffer const &gradients) override {
+            assert(parameters.same_layout(m));
+            // alpha * sqrt(1 - beta2^t) / (1 - beta1^t) and epsilon * sqrt(1 - beta2^t) apply both
+            // bias corrections without touching m and v
+            T const t = static_cast<T>(this->steps.load());
+            T const root = std::sqrt(1 - std::pow(beta2, t));
+            T const step_size = this->alpha * root / (1 - std::pow(beta1, t));
+            T const l2 = decoupled ? 0 : weight_decay;
+            T const shrink = decoupled ? 1 - this->alpha * weight_decay : 1;
+            std::size_t const size = parameters.size();
+            LinearAlgebra::Kernels::dispatch<detail::AdamKernel, T>(
+                    std::size_t(1), size, parameters.data(), size, gradients.data(), size,
+                    m.data(), size, v.data(), size, beta1, beta2, step_size, epsilon * root, l2, shrink);
+        }
+
+    public:
+        explicit Adam(T alpha = 0.001, T beta1 = 0.9, T beta2 = 0.999, T epsilon = 1e-8, T weight_decay = 0)
+                : Adam(alpha, beta1, beta2, epsilon, weight_decay, false) {}
+    };
+
+    // Adam with decoupled weight decay: p -= alpha * weight_decay * p besides the Adam step
+    template<typename T>
+    class AdamW : public Adam<T> {
+    public:
+        explicit AdamW(T alpha = 0.001, T weight_decay = 0.01, T beta1 = 0.9, T beta2 = 0.999, T epsilon = 1e-8)
+                : Adam<T>(alpha, beta1, beta2, epsilon, weight_decay, true) {}
+    };
+}
+
+#endif
@@ -1,22 +1,69 @@
 #ifndef BNN_OptimizerBase_hpp
 #define BNN_OptimizerBase_hpp
 
+#include <atomic>
+#include <cassert>
 #include <cstddef>
-#include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/FlatBuffer.hpp"
+
+/*
+ * Optimizers update a fixed set of parameter tensors, held in one FlatBuffer, from gradients
+ * laid out the same way. bind() makes the state buffers once, outside of training; step() then
+ * updates every parameter and its state in place with a single fused vectorized pass over the
+ * flat buffers, without temporaries.
+ */
 
 namespace Optimizer {
     using nnint = std::size_t;
+
     template<typename T>
     class OptimizerBase {
-        using Matrix = LinearAlgebra::Matrix<T>;
     protected:
-        virtual void init(nnint layers_count, nnint const *layer_size, Matrix const *layers,
-                Matrix const *matrix, Matrix const *bias, Matrix const *z, std::random_device &rd) = 0;
+        using Buffer = LinearAlgebra::FlatBuffer<T>;
+
+        // learning rate
+        T alpha;
+        // steps since bind, counting the current one; atomic as Hogwild training steps from several threads
+        std::atomic<nnint> steps;
+
+        // make the state for these parameters, typically Buffer::zeros_like(parameters)
+        virtual void init(Buffer const &/*parameters*/) {}
+
+        // parameters -= update(gradients) for step number steps
+        virtual void update(Buffer &parameters, Buffer const &gradients) = 0;
+
     public:
-        OptimizerBase(nnint layers_count, nnint const *layer_size, Matrix const *layers,
-                      Matrix const *matrix, Matrix const *bias, Matrix const *z, std::random_device &rd) {}
-        void forward(Matrix const &input) = 0;
-        void backward(Matrix const &trueValue) = 0;
+        explicit OptimizerBase(T alpha) : alpha(alpha), steps(0) {}
+
+        virtual ~OptimizerBase() = default;
+
+        // start over on a new set of parameters
+        void bind(Buffer const &parameters) {
+            steps = 0;
+            init(parameters);
+        }
+
+        // parameters and gradients share the layout of the buffer given to bind
+        void step(Buffer &parameters, Buffer const &gradients) {
+            assert(parameters.same_layout(gradients));
+            steps++;
+            update(parameters, gradients);
+        }
+
+        void set_learning_rate(T alpha) {
+            this->alpha = alpha;
+        }
+        T get_learning_rate() const {
+            return alpha;
+        }
+        nnint get_steps() const {
+            return steps;
+        }
+
+        // whether update keeps nothing between steps, so that several threads may step the same parameters
+        virtual bool stateless() const {
+            return false;
+        }
     };
 }
 
@@ -0,0 +1,125 @@
+#ifndef BNN_Optimizer_SGD_hpp
+#define BNN_Optimizer_SGD_hpp
+
+#include <cassert>
+#include "OptimizerBase.h"
+#include "../LinearAlgebra/Kernels/Gemm.hpp"
+
+namespace Optimizer {
+
+    namespace detail {
+
+        using LinearAlgebra::Kernels::Isa;
+        using LinearAlgebra::Kernels::Vec;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+        // p -= alpha * (g + decay * p)
+        struct SgdKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T *p, std::size_t ldp,
+                                              T const *g, std::size_t ldg, T alpha, T decay) {
+                for (std::size_t i = 0; i < row; i++) {
+                    T *pr = p + i * ldp;
+                    T const *gr = g + i * ldg;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type const a = V::set1(-alpha), d = V::set1(decay);
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const pv = V::load(pr + j);
+                            V::store(pr + j, V::fmadd(a, V::fmadd(d, pv, V::load(gr + j)), pv));
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        pr[j] -= alpha * (gr[j] + decay * pr[j]);
+                    }
+                }
+            }
+        };
+
+        // u = g + decay * p, v = mu * v + u, p -= alpha * (nesterov ? u + mu * v : v)
+        struct MomentumKernel {
+            template<Isa isa, typename T>
+            static BNN_ALWAYS_INLINE void run(std::size_t row, std::size_t col, T *p, std::size_t ldp,
+                                              T const *g, std::size_t ldg, T *v, std::size_t ldv,
+                                              T alpha, T mu, T decay, bool nesterov) {
+                for (std::size_t i = 0; i < row; i++) {
+                    T *pr = p + i * ldp, *vr = v + i * ldv;
+                    T const *gr = g + i * ldg;
+                    std::size_t j = 0;
+#if BNN_X86
+                    if constexpr (isa != Isa::Scalar) {
+                        using V = Vec<T, isa>;
+                        typename V::type const a = V::set1(-alpha), m = V::set1(mu), d = V::set1(decay);
+                        for (; j + V::width <= col; j += V::width) {
+                            typename V::type const pv = V::load(pr + j);
+                            typename V::type const u = V::fmadd(d, pv, V::load(gr + j));
+                            typename V::type const vv = V::fmadd(m, V::load(vr + j), u);
+                            V::store(vr + j, vv);
+                            V::store(pr + j, V::fmadd(a, nesterov ? V::fmadd(m, vv, u) : vv, pv));
+                        }
+                    }
+#endif
+                    for (; j < col; j++) {
+                        T const u = gr[j] + decay * pr[j];
+                        vr[j] = mu * vr[j] + u;
+                        pr[j] -= alpha * (nesterov ? u + mu * vr[j] : vr[j]);
+                    }
+                }
+            }
+        };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    }
+
+    // stochastic gradient descent with optional (Nesterov) momentum and L2 weight decay
+    template<typename T>
+    class SGD : public OptimizerBase<T> {
+        using typename OptimizerBase<T>::Buffer;
+
+        T momentum, weight_decay;
+        bool nesterov;
+        // velocity of every parameter, empty without momentum
+        Buffer velocity;
+
+    protected:
+        void init(Buffer const &parameters) override {
+            velocity = momentum != 0 ? Buffer::zeros_like(parameters) : Buffer();
+        }
+
+        void update(Buffer &parameters, Buffer const &gradients) override {
+            using LinearAlgebra::Kernels::dispatch;
+            if (momentum == 0) {
+                dispatch<detail::SgdKernel, T>(std::size_t(1), parameters.size(), parameters.data(), parameters.size(),
+                                               gradients.data(), gradients.size(), this->alpha, weight_decay);
+            } else {
+                assert(parameters.same_layout(velocity));
+                dispatch<detail::MomentumKernel, T>(std::size_t(1), parameters.size(), parameters.data(), parameters.size(),
+                                                    gradients.data(), gradients.size(), velocity.data(), velocity.size(),
+                                                    this->alpha, momentum, weight_decay, nesterov);
+            }
+        }
+
+    public:
+        explicit SGD(T alpha = 0.01, T momentum = 0, bool nesterov = false, T weight_decay = 0)
+                : OptimizerBase<T>(alpha), momentum(momentum), weight_decay(weight_decay), nesterov(nesterov) {
+            assert(!nesterov || momentum != 0);
+        }
+
+        // plain SGD has no velocity to race on
+        bool stateless() const override {
+            return momentum == 0;
+        }
+    };
+}
+
+#endif
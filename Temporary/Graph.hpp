@@ -0,0 +1,581 @@
+#ifndef BNN_TEMPORARY_Graph_hpp
+#define BNN_TEMPORARY_Graph_hpp
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+#include "Operand/Constant.hpp"
+#include "Operand/Scalar.hpp"
+#include "Operand/Variable.hpp"
+#include "Operator/Operators.hpp"
+#include "../LinearAlgebra/FlatBuffer.hpp"
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../LinearAlgebra/Profiler.hpp"
+#include "../LinearAlgebra/ThreadPool.hpp"
+#include "../Optimizer/SGD.hpp"
+
+/*
+ * A computation graph with reverse-mode differentiation.
+ * Variables (trained parameters, in one FlatBuffer for the optimizers) and Constants (inputs fed as views before
+ * each run) are its leaves, and every operator applied to them appends a node to a tape, in order.
+ * compile(loss) keeps the part of the tape the loss and any other named outputs depend on, and plans its memory
+ * once. Each value lives from its operator to its last reader, forward or backward, and each gradient from its
+ * first contribution to the backward of its operator; buffers whose lifetimes do not overlap share storage, all
+ * of it one allocation. An elementwise operator whose operand 0 has no other reader writes over it, and a run of
+ * such operators is fused: it goes over the data in bands of rows that stay in cache, every operator on one band
+ * before the next, across the thread pool. Backward likewise turns a gradient over in place where it can.
+ * forward, backward and step then run without allocating. Shapes, the batch included, are fixed at build time,
+ * and only the values of the loss, the named outputs and the variables are kept after a run.
+ */
+
+namespace Temporary {
+
+    template<typename T>
+    class Graph {
+        using Matrix = LinearAlgebra::Matrix<T>;
+        using View = LinearAlgebra::MatrixView<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+        using nnint = std::size_t;
+
+        // operators with more operands than this run on their own, not fused
+        static constexpr nnint fused_arity = 4;
+        // bytes of one band of rows of a fused run, per matrix
+        static constexpr nnint fused_band_bytes = 16 << 10;
+
+        enum class Kind {
+            Variable,
+            Constant,
+            Result
+        };
+
+        struct Node {
+            Kind kind;
+            nnint row, col;
+            // the operator computing a Result
+            std::unique_ptr<Operator<T> > op;
+            // parameter of a Variable
+            nnint slot;
+            // where the value and the gradient live once compiled, and the view fed to a Constant
+            View value, gradient;
+            ConstView fed;
+        };
+
+        std::vector<Node> nodes;
+        // starting values of the variables, until compile moves them into parameters
+        std::vector<Matrix> initial;
+        nnint loss_node;
+        bool compiled;
+
+        // the operators to run, in order; the end of the fused run starting at each; and per node whether it
+        // gets a gradient, and whether this backward has written it yet
+        std::vector<nnint> tape, run_end;
+        std::vector<char> wants_gradient, written;
+
+        LinearAlgebra::FlatBuffer<T> parameters, gradients;
+        std::unique_ptr<Optimizer::OptimizerBase<T> > optimizer;
+        // every value and gradient of the tape, and its elements with and without sharing
+        Matrix workspace;
+        nnint planned, unplanned;
+
+        // operands of the operator at hand
+        std::vector<ConstView> operands;
+        std::vector<View> operand_gradients;
+        std::unique_ptr<bool[]> accumulate;
+
+        OperandBase push(Kind kind, nnint row, nnint col, std::unique_ptr<Operator<T> > op) {
+            assert(!compiled && "In Graph: the graph is compiled already!");
+            if (op) {
+                for (nnint k = 0; k < op->arity(); k++) {
+                    assert(op->operand(k) < nodes.size());
+                }
+            }
+            nodes.push_back(Node{kind, row, col, std::move(op), 0, View(), View(), ConstView()});
+            return OperandBase(nodes.size() - 1);
+        }
+
+        Node const &node(OperandBase o) const {
+            assert(o.index() < nodes.size());
+            return nodes[o.index()];
+        }
+
+        ConstView value_of(nnint i) const {
+            assert(nodes[i].kind != Kind::Constant || nodes[i].fed.data() != nullptr);
+            return nodes[i].kind == Kind::Constant ? nodes[i].fed : ConstView(nodes[i].value);
+        }
+
+        // whether the operator at tape position t can run band by band
+        bool fusible(nnint t) const {
+            Node const &n = nodes[tape[t]];
+            if (!n.op->elementwise() || n.op->arity() > fused_arity) {
+                return false;
+            }
+            for (nnint k = 0; k < n.op->arity(); k++) {
+                if (nodes[n.op->operand(k)].row != n.row) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // the operators at tape positions [first, last), which write over one another, band by band
+        void forward_fused(nnint first, nnint last) {
+            BNN_PROFILE_SCOPE("fused", first, 0, 0);
+            nnint const rows = nodes[tape[first]].row;
+            nnint const band = std::max<nnint>(1, fused_band_bytes / (std::max<nnint>(nodes[tape[first]].col, 1) * sizeof(T)));
+            LinearAlgebra::parallel_for(rows, band, [&](nnint begin, nnint end) {
+                ConstView in[fused_arity];
+                for (nnint r = begin; r < end; r += band) {
+                    nnint const count = std::min(band, end - r);
+                    for (nnint t = first; t < last; t++) {
+                        Node const &n = nodes[tape[t]];
+                        for (nnint k = 0; k < n.op->arity(); k++) {
+                            in[k] = value_of(n.op->operand(k)).row_block(r, count);
+                        }
+                        n.op->forward(in, n.value.row_block(r, count));
+                    }
+                }
+            });
+        }
+
+        // give every value and gradient of the tape its place in the workspace; see the top of this file
+        void plan(std::vector<char> const &kept) {
+            nnint const count = nodes.size(), steps = tape.size();
+            std::vector<nnint> position(count, 0), consumers(count, 0);
+            for (nnint t = 0; t < steps; t++) {
+                position[tape[t]] = t;
+                Operator<T> const &op = *nodes[tape[t]].op;
+                for (nnint k = 0; k < op.arity(); k++) {
+                    consumers[op.operand(k)]++;
+                }
+            }
+            // buffer i holds the value of node i and buffer count + i its gradient, until merged
+            std::vector<nnint> parent(2 * count);
+            std::iota(parent.begin(), parent.end(), nnint(0));
+            auto const find = [&](nnint b) {
+                while (parent[b] != b) {
+                    b = parent[b] = parent[parent[b]];
+                }
+                return b;
+            };
+            for (nnint t = 0; t < steps; t++) {
+                nnint const n = tape[t], p = nodes[n].op->operand(0);
+                Operator<T> const &op = *nodes[n].op;
+                bool const only = nodes[p].kind == Kind::Result && consumers[p] == 1;
+                // the result writes over operand 0 when nothing reads that afterwards
+                if (op.elementwise() && only && !kept[p] && nodes[p].row == nodes[n].row && nodes[p].col == nodes[n].col &&
+                    !(wants_gradient[p] && nodes[p].op->reads_result()) && !(wants_gradient[n] && op.reads_operand(0))) {
+                    parent[find(n)] = find(p);
+                }
+                if (op.in_place_gradient() && only && wants_gradient[n] && wants_gradient[p]) {
+                    parent[find(count + p)] = find(count + n);
+                }
+            }
+            // lifetimes on a clock where the operator at t runs forward at t and backward at 2 steps - 1 - t
+            nnint const never = static_cast<nnint>(-1);
+            std::vector<nnint> first(2 * count, never), last(2 * count, 0), size(2 * count, 0);
+            auto const live = [&](nnint b, nnint from, nnint to, nnint elements) {
+                b = find(b);
+                first[b] = std::min(first[b], from);
+                last[b] = std::max(last[b], to);
+                size[b] = std::max(size[b], elements);
+            };
+            constexpr nnint line = sizeof(T) < LinearAlgebra::storage_alignment ? LinearAlgebra::storage_alignment / sizeof(T) : 1;
+            auto const elements = [&](nnint i) {
+                return (nodes[i].row * Matrix::padded(nodes[i].col) + line - 1) / line * line;
+            };
+            unplanned = 0;
+            for (nnint t = 0; t < steps; t++) {
+                nnint const n = tape[t], back = 2 * steps - 1 - t;
+                Operator<T> const &op = *nodes[n].op;
+                live(n, t, kept[n] ? 2 * steps : t, elements(n));
+                unplanned += elements(n);
+                if (wants_gradient[n] && op.reads_result()) {
+                    live(n, t, back, elements(n));
+                }
+                if (n == loss_node && wants_gradient[n]) {
+                    live(count + n, t, back, elements(n));
+                }
+                for (nnint k = 0; k < op.arity(); k++) {
+                    nnint const p = op.operand(k);
+                    if (nodes[p].kind != Kind::Result) {
+                        continue;
+                    }
+                    live(p, position[p], t, elements(p));
+                    if (wants_gradient[n] && op.reads_operand(k)) {
+                        live(p, position[p], back, elements(p));
+                    }
+                    if (wants_gradient[n] && wants_gradient[p]) {
+                        live(count + p, back, 2 * steps - 1 - position[p], elements(p));
+                    }
+                }
+                if (wants_gradient[n]) {
+                    unplanned += elements(n);
+                }
+            }
+            // buffers by first use, each into the smallest free slot that fits, else the largest free one, grown
+            std::vector<nnint> order;
+            for (nnint b = 0; b < 2 * count; b++) {
+                if (first[b] != never && find(b) == b) {
+                    order.push_back(b);
+                }
+            }
+            std::stable_sort(order.begin(), order.end(), [&](nnint a, nnint b) {
+                return first[a] < first[b];
+            });
+            struct Slot {
+                nnint size, busy_until, offset;
+            };
+            std::vector<Slot> slots;
+            std::vector<nnint> slot_of(2 * count, never);
+            for (nnint b : order) {
+                nnint fit = never, largest = never;
+                for (nnint s = 0; s < slots.size(); s++) {
+                    if (slots[s].busy_until >= first[b]) {
+                        continue;
+                    }
+                    if (slots[s].size >= size[b] && (fit == never || slots[s].size < slots[fit].size)) {
+                        fit = s;
+                    }
+                    if (largest == never || slots[s].size > slots[largest].size) {
+                        largest = s;
+                    }
+                }
+                nnint const s = fit != never ? fit : largest;
+                if (s == never) {
+                    slot_of[b] = slots.size();
+                    slots.push_back({size[b], last[b], 0});
+                } else {
+                    slot_of[b] = s;
+                    slots[s].size = std::max(slots[s].size, size[b]);
+                    slots[s].busy_until = last[b];
+                }
+            }
+            planned = 0;
+            for (Slot &slot : slots) {
+                slot.offset = planned;
+                planned += slot.size;
+            }
+            workspace = Matrix(1, std::max<nnint>(planned, 1));
+            for (nnint n : tape) {
+                Node &node = nodes[n];
+                node.value = View(workspace.data() + slots[slot_of[find(n)]].offset, node.row, node.col,
+                                  Matrix::padded(node.col));
+                if (wants_gradient[n]) {
+                    node.gradient = View(workspace.data() + slots[slot_of[find(count + n)]].offset, node.row, node.col,
+                                         Matrix::padded(node.col));
+                }
+            }
+            // runs of elementwise operators, each writing over the result of the one before
+            run_end.assign(steps, 0);
+            for (nnint t = steps; t-- > 0;) {
+                run_end[t] = t + 1;
+                if (t + 1 < steps && fusible(t) && fusible(t + 1) && nodes[tape[t + 1]].op->operand(0) == tape[t] &&
+                    find(tape[t + 1]) == find(tape[t])) {
+                    run_end[t] = run_end[t + 1];
+                }
+            }
+        }
+
+    public:
+        explicit Graph(T alpha = 0.01)
+                : loss_node(OperandBase::none), compiled(false),
+                  optimizer(std::make_unique<Optimizer::SGD<T> >(alpha, static_cast<T>(0.9))), planned(0), unplanned(0) {}
+
+        Graph(Graph const &) = delete;
+        Graph &operator=(Graph const &) = delete;
+
+        // leaves
+
+        Variable variable(Matrix initial) {
+            nnint const row = initial.get_row(), col = initial.get_col();
+            OperandBase const ret = push(Kind::Variable, row, col, nullptr);
+            nodes.back().slot = this->initial.size();
+            this->initial.push_back(std::move(initial));
+            return Variable(ret.index());
+        }
+
+        // normally distributed around 0, as NeuralNet starts its weights
+        Variable variable(nnint row, nnint col, std::random_device &rd, T stdv = static_cast<T>(0.3)) {
+            return variable(Matrix(row, col, rd, 0, stdv));
+        }
+
+        Constant constant(nnint row, nnint col) {
+            return Constant(push(Kind::Constant, row, col, nullptr).index());
+        }
+
+        // operators
+
+        // a user-defined operator with a result of row x col
+        OperandBase apply(std::unique_ptr<Operator<T> > op, nnint row, nnint col) {
+            return push(Kind::Result, row, col, std::move(op));
+        }
+
+        OperandBase matmul(OperandBase a, OperandBase b, LinearAlgebra::Transpose ta = LinearAlgebra::Transpose::NoTrans,
+                           LinearAlgebra::Transpose tb = LinearAlgebra::Transpose::NoTrans) {
+            bool const na = ta == LinearAlgebra::Transpose::NoTrans, nb = tb == LinearAlgebra::Transpose::NoTrans;
+            nnint const m = na ? node(a).row : node(a).col, k = na ? node(a).col : node(a).row;
+            nnint const n = nb ? node(b).col : node(b).row;
+            assert(k == (nb ? node(b).row : node(b).col));
+            static_cast<void>(k);
+            return apply(std::make_unique<MatMul<T> >(a, b, ta, tb), m, n);
+        }
+
+        OperandBase add_bias(OperandBase x, OperandBase b) {
+            assert(node(b).row == node(x).row && node(b).col == 1);
+            return apply(std::make_unique<AddBias<T> >(x, b), node(x).row, node(x).col);
+        }
+
+        OperandBase add(OperandBase a, OperandBase b) {
+            assert(node(a).row == node(b).row && node(a).col == node(b).col);
+            return apply(std::make_unique<Add<T> >(a, b), node(a).row, node(a).col);
+        }
+
+        OperandBase subtract(OperandBase a, OperandBase b) {
+            assert(node(a).row == node(b).row && node(a).col == node(b).col);
+            return apply(std::make_unique<Add<T> >(a, b, true), node(a).row, node(a).col);
+        }
+
+        OperandBase multiply(OperandBase a, OperandBase b) {
+            assert(node(a).row == node(b).row && node(a).col == node(b).col);
+            return apply(std::make_unique<Multiply<T> >(a, b), node(a).row, node(a).col);
+        }
+
+        OperandBase scale(OperandBase x, Scalar<T> s) {
+            return apply(std::make_unique<Scale<T> >(x, s), node(x).row, node(x).col);
+        }
+
+        OperandBase activation(Net::Activation activation, OperandBase x) {
+            return apply(std::make_unique<Activate<T> >(x, activation), node(x).row, node(x).col);
+        }
+
+        // the loss of x against answer averaged over the batch, 1 x 1; see LossOf
+        OperandBase loss(Net::Loss loss, OperandBase x, OperandBase answer) {
+            assert(node(x).row == node(answer).row && node(x).col == node(answer).col);
+            return apply(std::make_unique<LossOf<T> >(x, answer, loss), 1, 1);
+        }
+
+        // fix the graph: the tape for loss and outputs, the parameters, and the memory plan
+        void compile(OperandBase loss, std::vector<OperandBase> const &outputs = {}) {
+            assert(!compiled && node(loss).kind == Kind::Result && node(loss).row == 1 && node(loss).col == 1);
+            compiled = true;
+            loss_node = loss.index();
+            nnint const count = nodes.size();
+
+            std::vector<std::pair<nnint, nnint> > shapes;
+            for (Matrix const &m : initial) {
+                shapes.emplace_back(m.get_row(), m.get_col());
+            }
+            parameters = LinearAlgebra::FlatBuffer<T>(shapes);
+            gradients = LinearAlgebra::FlatBuffer<T>::zeros_like(parameters);
+            for (Node &n : nodes) {
+                if (n.kind == Kind::Variable) {
+                    n.value = parameters.view(n.slot);
+                    n.value.assign(initial[n.slot]);
+                    n.gradient = gradients.view(n.slot);
+                }
+            }
+            initial.clear();
+            optimizer->bind(parameters);
+
+            // every operator the loss and the outputs depend on, in the order they were added
+            std::vector<char> needed(count, 0), kept(count, 0);
+            needed[loss_node] = kept[loss_node] = 1;
+            for (OperandBase const &o : outputs) {
+                needed[o.index()] = kept[o.index()] = 1;
+            }
+            for (nnint i = count; i-- > 0;) {
+                if (needed[i] && nodes[i].op) {
+                    for (nnint k = 0; k < nodes[i].op->arity(); k++) {
+                        needed[nodes[i].op->operand(k)] = 1;
+                    }
+                }
+            }
+            for (nnint i = 0; i < count; i++) {
+                if (needed[i] && nodes[i].kind == Kind::Result) {
+                    tape.push_back(i);
+                }
+            }
+            // gradients go to the nodes on a path from a variable to the loss
+            std::vector<char> leads(count, 0), on_path(count, 0);
+            for (nnint i = 0; i < count; i++) {
+                leads[i] = nodes[i].kind == Kind::Variable;
+                if (needed[i] && nodes[i].op) {
+                    for (nnint k = 0; k < nodes[i].op->arity(); k++) {
+                        leads[i] = leads[i] || leads[nodes[i].op->operand(k)];
+                    }
+                }
+            }
+            on_path[loss_node] = 1;
+            for (nnint t = tape.size(); t-- > 0;) {
+                if (on_path[tape[t]]) {
+                    for (nnint k = 0; k < nodes[tape[t]].op->arity(); k++) {
+                        on_path[nodes[tape[t]].op->operand(k)] = 1;
+                    }
+                }
+            }
+            wants_gradient.assign(count, 0);
+            for (nnint i = 0; i < count; i++) {
+                wants_gradient[i] = leads[i] && on_path[i];
+            }
+            written.assign(count, 0);
+
+            plan(kept);
+
+            nnint widest = 0;
+            for (nnint n : tape) {
+                widest = std::max(widest, nodes[n].op->arity());
+            }
+            operands.assign(widest, ConstView());
+            operand_gradients.assign(widest, View());
+            accumulate = std::make_unique<bool[]>(std::max<nnint>(widest, 1));
+            for (nnint n : tape) {
+                Operator<T> &op = *nodes[n].op;
+                for (nnint k = 0; k < op.arity(); k++) {
+                    Node const &p = nodes[op.operand(k)];
+                    operands[k] = p.kind == Kind::Constant ? ConstView(nullptr, p.row, p.col) : ConstView(p.value);
+                }
+                op.reserve(operands.data(), nodes[n].value);
+            }
+        }
+
+        // the data of a constant, one sample per column, until the next feed; it is read in place, so it must
+        // stay alive through the matching backward
+        void feed(Constant c, ConstView data) {
+            Node &n = nodes[c.index()];
+            assert(n.kind == Kind::Constant && data.get_row() == n.row && data.get_col() == n.col);
+            n.fed = data;
+        }
+
+        // run the tape, returning the loss
+        T forward() {
+            assert(compiled);
+            for (nnint t = 0; t < tape.size();) {
+                if (run_end[t] > t + 1) {
+                    forward_fused(t, run_end[t]);
+                    t = run_end[t];
+                    continue;
+                }
+                Node &n = nodes[tape[t]];
+                BNN_PROFILE_SCOPE(n.op->name(), t, 0, 0);
+                for (nnint k = 0; k < n.op->arity(); k++) {
+                    operands[k] = value_of(n.op->operand(k));
+                }
+                n.op->forward(operands.data(), n.value);
+                t++;
+            }
+            return nodes[loss_node].value(0, 0);
+        }
+
+        // the gradient of the loss of the last forward with respect to every variable, into gradients()
+        void backward() {
+            assert(compiled);
+            if (!wants_gradient[loss_node]) {
+                return;
+            }
+            std::fill(written.begin(), written.end(), 0);
+            nodes[loss_node].gradient(0, 0) = 1;
+            written[loss_node] = 1;
+            for (nnint t = tape.size(); t-- > 0;) {
+                Node &n = nodes[tape[t]];
+                if (!wants_gradient[tape[t]]) {
+                    continue;
+                }
+                BNN_PROFILE_SCOPE(n.op->name(), t, 0, 0);
+                Operator<T> &op = *n.op;
+                for (nnint k = 0; k < op.arity(); k++) {
+                    nnint const p = op.operand(k);
+                    operands[k] = value_of(p);
+                    if (!wants_gradient[p]) {
+                        operand_gradients[k] = View();
+                        accumulate[k] = false;
+                        continue;
+                    }
+                    operand_gradients[k] = nodes[p].gradient;
+                    // an operand taken twice sums both contributions, whichever the operator writes first
+                    bool twice = false;
+                    for (nnint j = 0; j < op.arity(); j++) {
+                        twice = twice || (j != k && op.operand(j) == p);
+                    }
+                    if (twice && !written[p]) {
+                        View const g = nodes[p].gradient;
+                        for (nnint r = 0; r < g.get_row(); r++) {
+                            std::fill(g.data() + r * g.get_ld(), g.data() + r * g.get_ld() + g.get_col(), static_cast<T>(0));
+                        }
+                        written[p] = 1;
+                    }
+                    accumulate[k] = written[p];
+                    written[p] = 1;
+                }
+                op.backward(operands.data(), n.value, n.gradient, operand_gradients.data(), accumulate.get());
+            }
+        }
+
+        // one update from the fed batch, returning its loss
+        T step() {
+            BNN_PROFILE_SCOPE("step", -1, 0, 0);
+            T const ret = forward();
+            backward();
+            optimizer->step(parameters, gradients);
+            return ret;
+        }
+
+        // the value of a variable, the loss or an output named to compile, as of the last forward
+        ConstView value(OperandBase o) const {
+            assert(compiled);
+            return value_of(o.index());
+        }
+
+        // dL/d v for a variable v, as of the last backward
+        ConstView gradient(Variable v) const {
+            assert(compiled && node(v).kind == Kind::Variable);
+            return node(v).gradient;
+        }
+
+        // replace the optimizer, starting it afresh on the current parameters
+        void set_optimizer(std::unique_ptr<Optimizer::OptimizerBase<T> > optimizer) {
+            assert(optimizer);
+            this->optimizer = std::move(optimizer);
+            this->optimizer->bind(parameters);
+        }
+        Optimizer::OptimizerBase<T> &get_optimizer() {
+            return *optimizer;
+        }
+
+        // every variable, and the gradients of the last backward, each as one flat buffer
+        LinearAlgebra::FlatBuffer<T> &get_parameters() {
+            return parameters;
+        }
+        LinearAlgebra::FlatBuffer<T> const &get_gradients() const {
+            return gradients;
+        }
+
+        // bytes of the values and gradients of the tape as planned, and with a buffer each
+        nnint workspace_bytes() const {
+            return planned * sizeof(T);
+        }
+        nnint unplanned_bytes() const {
+            return unplanned * sizeof(T);
+        }
+
+        // operators on the tape, and how many of them run fused with the one before
+        nnint tape_size() const {
+            return tape.size();
+        }
+        nnint fused_count() const {
+            nnint ret = 0;
+            for (nnint t = 0; t < tape.size(); t = run_end[t]) {
+                ret += run_end[t] - t - 1;
+            }
+            return ret;
+        }
+    };
+
+}
+
+
+#endif
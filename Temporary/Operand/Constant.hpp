@@ -4,9 +4,15 @@
 
 #include "OperandBase.hpp"
 
-class Constant : public virtual OperandBase {
+namespace Temporary {
 
-};
+    // an input of a Graph, such as a batch or its answers, fed as a view before every run; no gradient
+    class Constant : public OperandBase {
+    public:
+        using OperandBase::OperandBase;
+    };
+
+}
 
 
 #endif
@@ -1,10 +1,29 @@
 #ifndef BNN_TEMPORARY_OperandBase_hpp
 #define BNN_TEMPORARY_OperandBase_hpp
 
+#include <cstddef>
 
-class OperandBase {
+namespace Temporary {
 
-};
+    // a node of a Graph, by its position on the graph: what operators take and return
+    class OperandBase {
+        std::size_t node;
+
+    public:
+        static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+        explicit OperandBase(std::size_t node = none) : node(node) {}
+
+        std::size_t index() const {
+            return node;
+        }
+
+        bool valid() const {
+            return node != none;
+        }
+    };
+
+}
 
 
 #endif
@@ -1,24 +1,22 @@
 #ifndef BNN_TEMPORARY_Scalar_hpp
 #define BNN_TEMPORARY_Scalar_hpp
 
-#include <cstddef>
-#include "OperandBase.hpp"
+namespace Temporary {
 
-template<typename T>
-class Scalar : public virtual OperandBase {
-    T const &s;
+    // a number fixed when the graph is built, e.g. the factor of Graph::scale
+    template<typename T>
+    class Scalar {
+        T s;
 
-public:
-    explicit Scalar(T const &t) : s(t) {}
+    public:
+        explicit Scalar(T t) : s(t) {}
 
-    T const &operator[](std::size_t) const {
-        return s;
-    }
+        T value() const {
+            return s;
+        }
+    };
 
-    std::size_t const size() const {
-        return 0;
-    }
-};
+}
 
 
 #endif
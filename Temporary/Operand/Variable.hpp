@@ -4,9 +4,15 @@
 
 #include "OperandBase.hpp"
 
-class Variable : public virtual OperandBase {
+namespace Temporary {
 
-};
+    // a trained parameter of a Graph, held in its parameter buffer, which gets a gradient on every backward
+    class Variable : public OperandBase {
+    public:
+        using OperandBase::OperandBase;
+    };
+
+}
 
 
 #endif
@@ -2,17 +2,87 @@
 #define BNN_TEMPORARY_OperatorBase_hpp
 
 #include <cstddef>
-#include <functional>
+#include "../Operand/OperandBase.hpp"
 #include "../SubClass/get_given_amount_of_parameters_for_constructor_class.hpp"
+#include "../../LinearAlgebra/MatrixView.hpp"
 
 /*
- * OperatorBase class gets N elements with type T with a constructor.
+ * Operators are the entries of a Graph's tape: each computes its result from its operands, and in reverse
+ * turns the gradient of its result into gradients of its operands. They also tell the graph what it may do
+ * with their buffers: which values backward still reads, whether the result may overwrite operand 0, and
+ * whether the gradient of operand 0 may overwrite that of the result.
+ * OperatorBase gets its N operands with a constructor taking N OperandBases.
  */
 
-template<typename T, std::size_t N>
-class OperatorBase : SubClass::BadNaming2<T, N> {
+namespace Temporary {
 
-};
+    template<typename T>
+    class Operator {
+    public:
+        using View = LinearAlgebra::MatrixView<T>;
+        using ConstView = LinearAlgebra::MatrixView<T const>;
+
+        virtual ~Operator() = default;
+
+        // for profiles and messages, a string literal
+        virtual char const *name() const = 0;
+
+        virtual std::size_t arity() const = 0;
+
+        // graph node of operand k
+        virtual std::size_t operand(std::size_t k) const = 0;
+
+        // out = f(in[0], ...); an elementwise operator may be given the same band of rows of each
+        virtual void forward(ConstView const *in, View out) = 0;
+
+        // din[k] = dL/d in[k] from dout = dL/d out, or din[k] += it where accumulate[k]; din[k] is empty where no
+        // gradient is wanted. dout is not read again afterwards, so backward may overwrite it, and with
+        // in_place_gradient din[0] may be dout itself
+        virtual void backward(ConstView const *in, ConstView out, View dout, View const *din, bool const *accumulate) = 0;
+
+        // row r of the result depends on row r of each operand only, and the result may be operand 0 itself
+        virtual bool elementwise() const {
+            return false;
+        }
+
+        // whether backward reads operand k, and the result
+        virtual bool reads_operand(std::size_t) const {
+            return true;
+        }
+        virtual bool reads_result() const {
+            return false;
+        }
+
+        // whether backward can compute din[0] over dout
+        virtual bool in_place_gradient() const {
+            return false;
+        }
+
+        // make any workspace, once, for operands and a result of these shapes; Graph::compile calls it before
+        // their buffers are filled
+        virtual void reserve(ConstView const *, View) {}
+    };
+
+    template<typename T, std::size_t N>
+    class OperatorBase : public Operator<T>, SubClass::BadNaming2<OperandBase, N> {
+        using Given = SubClass::BadNaming2<OperandBase, N>;
+
+    public:
+        template<typename ...Operands>
+        explicit OperatorBase(Operands... operands) : Given(operands...) {
+            static_assert(sizeof...(Operands) == N, "In OperatorBase: number of operands does not match N!");
+        }
+
+        std::size_t arity() const override {
+            return N;
+        }
+
+        std::size_t operand(std::size_t k) const override {
+            return this->given[k].index();
+        }
+    };
+
+}
 
 
 #endif
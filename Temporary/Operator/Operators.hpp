@@ -0,0 +1,380 @@
+#ifndef BNN_TEMPORARY_Operators_hpp
+#define BNN_TEMPORARY_Operators_hpp
+
+#include <cassert>
+#include <cstddef>
+#include "OperatorBase.hpp"
+#include "../Operand/Scalar.hpp"
+#include "../../LinearAlgebra/Matrix.hpp"
+#include "../../Net/Activation.hpp"
+#include "../../Net/Loss.hpp"
+
+/*
+ * The operators Graph builds from: products, bias, elementwise arithmetic, the activations of Net and its
+ * losses, all on the same kernels as NeuralNet. Matrices hold one sample per column.
+ */
+
+namespace Temporary {
+
+    namespace detail {
+
+        // d = g, or d += g when accumulating; nothing when d is g already
+        template<typename T>
+        void pass_gradient(LinearAlgebra::MatrixView<T const> g, LinearAlgebra::MatrixView<T> d, bool accumulate) {
+            if (accumulate) {
+                d += g;
+            } else if (d.data() != g.data()) {
+                d.assign(g);
+            }
+        }
+
+        inline LinearAlgebra::Transpose flip(LinearAlgebra::Transpose t) {
+            return t == LinearAlgebra::Transpose::NoTrans ? LinearAlgebra::Transpose::Trans
+                                                          : LinearAlgebra::Transpose::NoTrans;
+        }
+
+    }
+
+    // out = op(a) * op(b)
+    template<typename T>
+    class MatMul : public OperatorBase<T, 2> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+        using Transpose = LinearAlgebra::Transpose;
+
+        Transpose ta, tb;
+
+    public:
+        MatMul(OperandBase a, OperandBase b, Transpose ta, Transpose tb) : OperatorBase<T, 2>(a, b), ta(ta), tb(tb) {}
+
+        char const *name() const override {
+            return "matmul";
+        }
+
+        void forward(ConstView const *in, View out) override {
+            gemm(ta, tb, static_cast<T>(1), in[0], in[1], static_cast<T>(0), out);
+        }
+
+        // d op(a) = dout * op(b)^T and d op(b) = op(a)^T * dout, transposed back where the operand was
+        void backward(ConstView const *in, ConstView, View dout, View const *din, bool const *accumulate) override {
+            if (din[0].data() != nullptr) {
+                T const beta = accumulate[0] ? static_cast<T>(1) : static_cast<T>(0);
+                if (ta == Transpose::NoTrans) {
+                    gemm(Transpose::NoTrans, detail::flip(tb), static_cast<T>(1), dout, in[1], beta, din[0]);
+                } else {
+                    gemm(tb, Transpose::Trans, static_cast<T>(1), in[1], dout, beta, din[0]);
+                }
+            }
+            if (din[1].data() != nullptr) {
+                T const beta = accumulate[1] ? static_cast<T>(1) : static_cast<T>(0);
+                if (tb == Transpose::NoTrans) {
+                    gemm(detail::flip(ta), Transpose::NoTrans, static_cast<T>(1), in[0], dout, beta, din[1]);
+                } else {
+                    gemm(Transpose::Trans, ta, static_cast<T>(1), dout, in[0], beta, din[1]);
+                }
+            }
+        }
+    };
+
+    // out = x + b * ones^T, for a column b with a bias per row
+    template<typename T>
+    class AddBias : public OperatorBase<T, 2> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+        using Matrix = LinearAlgebra::Matrix<T>;
+
+        Matrix ones;
+
+    public:
+        AddBias(OperandBase x, OperandBase b) : OperatorBase<T, 2>(x, b) {}
+
+        char const *name() const override {
+            return "add_bias";
+        }
+
+        void reserve(ConstView const *, View out) override {
+            ones = Matrix::Ones(out.get_col(), 1);
+        }
+
+        void forward(ConstView const *in, View out) override {
+            if (out.data() != in[0].data()) {
+                out.assign(in[0]);
+            }
+            ger(static_cast<T>(1), in[1], ones, out);
+        }
+
+        void backward(ConstView const *, ConstView, View dout, View const *din, bool const *accumulate) override {
+            if (din[1].data() != nullptr) {
+                gemv(LinearAlgebra::Transpose::NoTrans, static_cast<T>(1), dout, ones,
+                     accumulate[1] ? static_cast<T>(1) : static_cast<T>(0), din[1]);
+            }
+            if (din[0].data() != nullptr) {
+                detail::pass_gradient(ConstView(dout), din[0], accumulate[0]);
+            }
+        }
+
+        bool elementwise() const override {
+            return true;
+        }
+        bool reads_operand(std::size_t) const override {
+            return false;
+        }
+        bool in_place_gradient() const override {
+            return true;
+        }
+    };
+
+    // out = a + b, or a - b
+    template<typename T>
+    class Add : public OperatorBase<T, 2> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+
+        bool subtract;
+
+    public:
+        Add(OperandBase a, OperandBase b, bool subtract = false) : OperatorBase<T, 2>(a, b), subtract(subtract) {}
+
+        char const *name() const override {
+            return subtract ? "subtract" : "add";
+        }
+
+        void forward(ConstView const *in, View out) override {
+            if (subtract) {
+                out.assign(in[0] - in[1]);
+            } else {
+                out.assign(in[0] + in[1]);
+            }
+        }
+
+        // din[1] first, while dout is intact
+        void backward(ConstView const *, ConstView, View dout, View const *din, bool const *accumulate) override {
+            if (din[1].data() != nullptr) {
+                if (!subtract) {
+                    detail::pass_gradient(ConstView(dout), din[1], accumulate[1]);
+                } else if (accumulate[1]) {
+                    din[1] -= dout;
+                } else {
+                    din[1].assign(-dout);
+                }
+            }
+            if (din[0].data() != nullptr) {
+                detail::pass_gradient(ConstView(dout), din[0], accumulate[0]);
+            }
+        }
+
+        bool elementwise() const override {
+            return true;
+        }
+        bool reads_operand(std::size_t) const override {
+            return false;
+        }
+        bool in_place_gradient() const override {
+            return true;
+        }
+    };
+
+    // out = a * b element for element
+    template<typename T>
+    class Multiply : public OperatorBase<T, 2> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+
+    public:
+        Multiply(OperandBase a, OperandBase b) : OperatorBase<T, 2>(a, b) {}
+
+        char const *name() const override {
+            return "multiply";
+        }
+
+        void forward(ConstView const *in, View out) override {
+            out.assign(elementwise_multiplied(in[0], in[1]));
+        }
+
+        // din[1] first, while dout is intact
+        void backward(ConstView const *in, ConstView, View dout, View const *din, bool const *accumulate) override {
+            if (din[1].data() != nullptr) {
+                if (accumulate[1]) {
+                    din[1] += elementwise_multiplied(dout, in[0]);
+                } else {
+                    din[1].assign(elementwise_multiplied(dout, in[0]));
+                }
+            }
+            if (din[0].data() != nullptr) {
+                if (accumulate[0]) {
+                    din[0] += elementwise_multiplied(dout, in[1]);
+                } else {
+                    din[0].assign(elementwise_multiplied(dout, in[1]));
+                }
+            }
+        }
+
+        bool elementwise() const override {
+            return true;
+        }
+        bool in_place_gradient() const override {
+            return true;
+        }
+    };
+
+    // out = s * x
+    template<typename T>
+    class Scale : public OperatorBase<T, 1> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+
+        T s;
+
+    public:
+        Scale(OperandBase x, Scalar<T> s) : OperatorBase<T, 1>(x), s(s.value()) {}
+
+        char const *name() const override {
+            return "scale";
+        }
+
+        void forward(ConstView const *in, View out) override {
+            out.assign(in[0] * s);
+        }
+
+        void backward(ConstView const *, ConstView, View dout, View const *din, bool const *accumulate) override {
+            if (din[0].data() == nullptr) {
+                return;
+            }
+            if (accumulate[0]) {
+                din[0] += dout * s;
+            } else {
+                din[0].assign(dout * s);
+            }
+        }
+
+        bool elementwise() const override {
+            return true;
+        }
+        bool reads_operand(std::size_t) const override {
+            return false;
+        }
+        bool in_place_gradient() const override {
+            return true;
+        }
+    };
+
+    // out = f(x) for a built-in activation; softmax normalizes each column, the others are elementwise
+    template<typename T>
+    class Activate : public OperatorBase<T, 1> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+
+        Net::Activation activation;
+
+    public:
+        Activate(OperandBase x, Net::Activation activation) : OperatorBase<T, 1>(x), activation(activation) {
+            assert(activation != Net::Activation::Custom);
+        }
+
+        char const *name() const override {
+            switch (activation) {
+                case Net::Activation::ReLU:
+                    return "relu";
+                case Net::Activation::Sigmoid:
+                    return "sigmoid";
+                case Net::Activation::Tanh:
+                    return "tanh";
+                case Net::Activation::Softmax:
+                    return "softmax";
+                default:
+                    return "identity";
+            }
+        }
+
+        void forward(ConstView const *in, View out) override {
+            Net::activate<T>(activation, in[0], out);
+        }
+
+        // f' from the output, over dout
+        void backward(ConstView const *, ConstView out, View dout, View const *din, bool const *accumulate) override {
+            if (din[0].data() != nullptr) {
+                Net::activate_backward<T>(activation, out, dout);
+                detail::pass_gradient(ConstView(dout), din[0], accumulate[0]);
+            }
+        }
+
+        bool elementwise() const override {
+            return activation != Net::Activation::Softmax;
+        }
+        bool reads_operand(std::size_t) const override {
+            return false;
+        }
+        bool reads_result() const override {
+            return true;
+        }
+        bool in_place_gradient() const override {
+            return true;
+        }
+    };
+
+    // out (1 x 1) = loss of x against the answers t, averaged over the columns; for the cross-entropies x holds
+    // the logits, which the loss takes through its sigmoid or softmax itself. The answers get no gradient
+    template<typename T>
+    class LossOf : public OperatorBase<T, 2> {
+        using typename Operator<T>::View;
+        using typename Operator<T>::ConstView;
+        using Matrix = LinearAlgebra::Matrix<T>;
+
+        Net::Loss loss;
+        std::size_t batch;
+        // the output activation for the cross-entropies, and dL/dx summed over the batch, both from forward
+        Matrix a, g;
+
+    public:
+        LossOf(OperandBase x, OperandBase t, Net::Loss loss) : OperatorBase<T, 2>(x, t), loss(loss), batch(0) {
+            assert(loss != Net::Loss::Custom);
+        }
+
+        char const *name() const override {
+            return "loss";
+        }
+
+        void reserve(ConstView const *in, View) override {
+            batch = in[0].get_col();
+            if (loss != Net::Loss::MeanSquaredError) {
+                a.resize(in[0].get_row(), in[0].get_col());
+            }
+            g.resize(in[0].get_row(), in[0].get_col());
+        }
+
+        // the activated output of the cross-entropies, as of the last forward
+        ConstView output() const {
+            return a;
+        }
+
+        void forward(ConstView const *in, View out) override {
+            T sum;
+            if (loss == Net::Loss::MeanSquaredError) {
+                sum = Net::loss_and_gradient<T>(loss, ConstView(), in[0], in[1], g);
+            } else {
+                Net::activate<T>(loss == Net::Loss::SoftmaxCrossEntropy ? Net::Activation::Softmax : Net::Activation::Sigmoid,
+                                 in[0], a);
+                sum = Net::loss_and_gradient<T>(loss, in[0], a, in[1], g);
+            }
+            out(0, 0) = sum / static_cast<T>(batch);
+        }
+
+        void backward(ConstView const *, ConstView, View dout, View const *din, bool const *accumulate) override {
+            assert(din[1].data() == nullptr && "In LossOf: the answers cannot take a gradient!");
+            T const s = dout(0, 0) / static_cast<T>(batch);
+            if (accumulate[0]) {
+                din[0] += g * s;
+            } else {
+                din[0].assign(g * s);
+            }
+        }
+
+        bool reads_operand(std::size_t) const override {
+            return false;
+        }
+    };
+
+}
+
+
+#endif
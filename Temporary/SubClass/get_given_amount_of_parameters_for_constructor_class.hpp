@@ -1,12 +1,14 @@
 #ifndef BNN_TEMPORARY_get_given_amount_of_parameters_class_hpp
 #define BNN_TEMPORARY_get_given_amount_of_parameters_class_hpp
 
+#include <array>
 #include <cstddef>
 #include <utility>
 
 /*
- * This template class is an abstract class that gets typical amount of inputs for constructor.
- * There might be some mistakes, so be careful with this.
+ * This template class is a base class whose constructor takes exactly as many values of T as the index
+ * sequence is long, and keeps them in order in given.
+ * (It used to hand them to a pure virtual init from the constructor, which cannot reach the derived class.)
  */
 
 
@@ -19,12 +21,11 @@ namespace SubClass {
     template<typename T, std::size_t ... Is>
     struct get_given_amount_of_parameters_for_constructor_class<T, std::index_sequence<Is...> > {
     protected:
-        virtual void init(always_t<T, Is>...) = 0;
+        std::array<T, sizeof...(Is)> given;
 
     public:
-        explicit constexpr get_given_amount_of_parameters_for_constructor_class(always_t<T, Is>... type) {
-            init(type...);
-        }
+        explicit constexpr get_given_amount_of_parameters_for_constructor_class(always_t<T, Is>... type)
+                : given{type...} {}
     };
 
     template<std::size_t N>
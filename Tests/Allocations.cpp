@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Net/NeuralNet.hpp"
+
+/*
+ * Training steps past the first epoch must take no heap blocks for Matrix storage, on one thread
+ * and split across two, even with std::function activations that return a new matrix on every call.
+ * Built with BNN_CHECK_ALLOCATIONS, so NeuralNet asserts the same on every step.
+ */
+
+namespace {
+
+    using Matrix = LinearAlgebra::Matrix<double>;
+    using Function = std::function<Matrix(Matrix const &)>;
+    using nnint = std::size_t;
+
+    Function const sigmoid = [](Matrix const &z) {
+        Matrix ret(z.get_row(), z.get_col());
+        for (nnint i = 0; i < z.get_row(); i++) {
+            for (nnint j = 0; j < z.get_col(); j++) {
+                ret(i, j) = 1 / (1 + std::exp(-z(i, j)));
+            }
+        }
+        return ret;
+    };
+
+    Function const dsigmoid = [](Matrix const &z) {
+        Matrix ret(z.get_row(), z.get_col());
+        for (nnint i = 0; i < z.get_row(); i++) {
+            for (nnint j = 0; j < z.get_col(); j++) {
+                double const s = 1 / (1 + std::exp(-z(i, j)));
+                ret(i, j) = s * (1 - s);
+            }
+        }
+        return ret;
+    };
+
+    // steps of the epochs after the first that touched the heap
+    nnint allocating_steps(Net::NeuralNet<double> &nn, Matrix *input, Matrix *answer, nnint cases, nnint batch) {
+        nnint ret = 0;
+        for (nnint epoch = 0; epoch < 3; epoch++) {
+            for (nnint first = 0; first < cases; first += batch) {
+                nn.learn(std::min(batch, cases - first), input + first, answer + first);
+                ret += epoch > 0 && nn.last_step_allocations() != 0;
+            }
+        }
+        return ret;
+    }
+
+}
+
+int main() {
+    constexpr nnint batch = 8, cases = 60;
+    nnint layer_size[3]{3, 6, 5};
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    Matrix input[cases], answer[cases];
+    for (nnint j = 0; j < cases; j++) {
+        input[j] = Matrix(layer_size[0], 1);
+        answer[j] = Matrix(layer_size[2], 1);
+        for (nnint r = 0; r < layer_size[0]; r++) {
+            input[j](r, 0) = uniform(engine);
+        }
+        for (nnint r = 0; r < layer_size[2]; r++) {
+            answer[j](r, 0) = uniform(engine) < 0.5 ? 0 : 1;
+        }
+    }
+
+    int failed = 0;
+    for (nnint threads : {1, 2}) {
+        Net::NeuralNet<double> nn(3, layer_size, sigmoid, sigmoid, dsigmoid, dsigmoid, 0.01);
+        nn.set_batch_size(batch);
+        nn.set_threads(threads);
+        nnint const steps = allocating_steps(nn, input, answer, cases, batch);
+        std::printf("%zu thread(s): %zu steps allocated after warm-up\n", threads, steps);
+        failed |= steps != 0;
+    }
+    return failed;
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Net/FixedNet.hpp"
+#include "../Net/InferenceModel.hpp"
+#include "../Net/NeuralNet.hpp"
+
+/*
+ * A FixedNet loaded from a trained NeuralNet must predict what the InferenceModel of the same network
+ * does, up to rounding, for every built-in activation it has a counterpart of.
+ */
+
+namespace {
+
+    using Matrix = LinearAlgebra::Matrix<double>;
+    using nnint = std::size_t;
+    using namespace Net::Fixed;
+
+    constexpr nnint cases = 16;
+
+    // largest difference between the predictions of both, after a few epochs on random data
+    template<typename Fixed>
+    double difference(Net::NeuralNet<double> &nn, std::mt19937 &engine) {
+        constexpr nnint in = Fixed::input_size(), out = Fixed::output_size();
+        std::uniform_real_distribution<double> uniform(-1, 1);
+        Matrix input(in, cases), answer(out, cases);
+        LinearAlgebra::Matrix<double, in, cases> fixed_input;
+        for (nnint j = 0; j < cases; j++) {
+            for (nnint r = 0; r < in; r++) {
+                fixed_input(r, j) = input(r, j) = uniform(engine);
+            }
+            for (nnint r = 0; r < out; r++) {
+                answer(r, j) = uniform(engine) < 0 ? 0 : 1;
+            }
+        }
+        for (nnint epoch = 0; epoch < 20; epoch++) {
+            nn.learn(input, answer);
+        }
+
+        Matrix const expected = Net::InferenceModel<double>(nn).predict(input);
+        LinearAlgebra::Matrix<double, out, cases> const actual = Fixed(nn).predict(fixed_input);
+        double ret = 0;
+        for (nnint j = 0; j < cases; j++) {
+            for (nnint r = 0; r < out; r++) {
+                ret = std::max(ret, std::abs(expected(r, j) - actual(r, j)));
+            }
+        }
+        return ret;
+    }
+
+    bool check(char const *name, double difference) {
+        std::printf("%s: largest difference %g\n", name, difference);
+        return difference <= 1e-12;
+    }
+
+}
+
+int main() {
+    std::mt19937 engine(1);
+    bool passed = true;
+    {
+        nnint layer_size[3]{3, 6, 5};
+        Net::NeuralNet<double> nn(3, layer_size, Net::Activation::ReLU, Net::Activation::Sigmoid,
+                                  Net::Loss::SigmoidCrossEntropy, 0.1);
+        using Fixed = Net::FixedNet<double, Layer<3, 6, ReLU>, Layer<6, 5, Sigmoid> >;
+        passed &= check("relu, sigmoid", difference<Fixed>(nn, engine));
+    }
+    {
+        nnint layer_size[4]{4, 8, 6, 3};
+        Net::Activation const activations[3]{Net::Activation::Tanh, Net::Activation::Identity,
+                                             Net::Activation::Softmax};
+        Net::NeuralNet<double> nn(4, layer_size, activations, Net::Loss::SoftmaxCrossEntropy, 0.1);
+        using Fixed = Net::FixedNet<double, Layer<4, 8, Tanh>, Layer<8, 6, Identity>, Layer<6, 3, Softmax> >;
+        passed &= check("tanh, identity, softmax", difference<Fixed>(nn, engine));
+    }
+    return passed ? 0 : 1;
+}
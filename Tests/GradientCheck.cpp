@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Temporary/Graph.hpp"
+
+/*
+ * The gradients Graph::backward leaves for every variable must match central differences of
+ * Graph::forward, on graphs whose memory plan writes values and gradients over one another, with
+ * operands taken twice, softmax (which is not elementwise) and every transposed form of matmul.
+ */
+
+namespace {
+
+    using Matrix = LinearAlgebra::Matrix<double>;
+    using Graph = Temporary::Graph<double>;
+    using LinearAlgebra::Transpose;
+    using Net::Activation;
+    using nnint = std::size_t;
+
+    constexpr double step = 1e-5, tolerance = 1e-6;
+
+    Matrix random(nnint row, nnint col, std::mt19937 &engine, double low = -1, double high = 1) {
+        std::uniform_real_distribution<double> uniform(low, high);
+        Matrix ret(row, col);
+        for (nnint i = 0; i < row; i++) {
+            for (nnint j = 0; j < col; j++) {
+                ret(i, j) = uniform(engine);
+            }
+        }
+        return ret;
+    }
+
+    // largest relative difference between backward and central differences over every parameter
+    double worst_error(Graph &graph) {
+        graph.forward();
+        graph.backward();
+        LinearAlgebra::FlatBuffer<double> &parameters = graph.get_parameters();
+        LinearAlgebra::FlatBuffer<double> analytic = LinearAlgebra::FlatBuffer<double>::zeros_like(parameters);
+        analytic.copy_from(graph.get_gradients());
+        double ret = 0;
+        for (nnint s = 0; s < parameters.count(); s++) {
+            LinearAlgebra::MatrixView<double> const p = parameters.view(s);
+            LinearAlgebra::MatrixView<double const> const g = analytic.view(s);
+            for (nnint i = 0; i < p.get_row(); i++) {
+                for (nnint j = 0; j < p.get_col(); j++) {
+                    double const x = p(i, j);
+                    p(i, j) = x + step;
+                    double const up = graph.forward();
+                    p(i, j) = x - step;
+                    double const down = graph.forward();
+                    p(i, j) = x;
+                    double const numeric = (up - down) / (2 * step);
+                    ret = std::max(ret, std::abs(numeric - g(i, j)) / std::max({1.0, std::abs(numeric), std::abs(g(i, j))}));
+                }
+            }
+        }
+        return ret;
+    }
+
+    bool check(char const *name, Graph &graph) {
+        double const error = worst_error(graph);
+        std::printf("%s: largest relative error %g, %zu of %zu workspace bytes, %zu operators fused\n", name, error,
+                    graph.workspace_bytes(), graph.unplanned_bytes(), graph.fused_count());
+        return error <= tolerance;
+    }
+
+}
+
+int main() {
+    constexpr nnint batch = 5;
+    std::mt19937 engine(1);
+    bool passed = true;
+
+    // op(W1) transposed, a chain of elementwise operators over one buffer, h taken twice and a softmax output
+    {
+        Graph graph;
+        Temporary::Constant const x = graph.constant(4, batch), t = graph.constant(3, batch);
+        Temporary::Variable const w1 = graph.variable(random(4, 6, engine)), b1 = graph.variable(random(6, 1, engine));
+        Temporary::Variable const w2 = graph.variable(random(6, 3, engine));
+        Temporary::OperandBase const h = graph.activation(Activation::Tanh,
+                                                          graph.add_bias(graph.matmul(w1, x, Transpose::Trans), b1));
+        Temporary::OperandBase const r = graph.add(graph.scale(graph.multiply(h, h), Temporary::Scalar<double>(0.5)), h);
+        Temporary::OperandBase const y = graph.activation(Activation::Softmax, graph.matmul(w2, r, Transpose::Trans));
+        graph.compile(graph.loss(Net::Loss::MeanSquaredError, y, t));
+        Matrix const input = random(4, batch, engine), answer = random(3, batch, engine, 0, 1);
+        graph.feed(x, input);
+        graph.feed(t, answer);
+        bool const shared = graph.workspace_bytes() < graph.unplanned_bytes() && graph.fused_count() != 0;
+        passed &= check("tanh, x * x, softmax", graph) && shared;
+    }
+
+    // op(x) and both operands of a product transposed, a variable squared, and a sigmoid cross-entropy
+    {
+        Graph graph;
+        Temporary::Constant const x = graph.constant(batch, 4), t = graph.constant(3, 3);
+        Temporary::Variable const w = graph.variable(random(3, 4, engine)), v = graph.variable(random(batch, 3, engine));
+        Temporary::Variable const u = graph.variable(random(3, 3, engine));
+        Temporary::OperandBase const z = graph.matmul(w, x, Transpose::NoTrans, Transpose::Trans);
+        Temporary::OperandBase const zz = graph.matmul(v, z, Transpose::Trans, Transpose::Trans);
+        Temporary::OperandBase const d = graph.subtract(graph.activation(Activation::Sigmoid, zz),
+                                                        graph.activation(Activation::Identity, zz));
+        Temporary::OperandBase const logits = graph.add(d, graph.multiply(u, u));
+        graph.compile(graph.loss(Net::Loss::SigmoidCrossEntropy, logits, t));
+        Matrix const input = random(batch, 4, engine), answer = random(3, 3, engine, 0, 1);
+        graph.feed(x, input);
+        graph.feed(t, answer);
+        passed &= check("transposed products, u * u", graph);
+    }
+
+    // a softmax in the middle, its gradient turned over in place, and a softmax cross-entropy
+    {
+        Graph graph;
+        Temporary::Constant const x = graph.constant(4, batch), t = graph.constant(4, batch);
+        Temporary::Variable const w = graph.variable(random(4, 4, engine)), b = graph.variable(random(4, 1, engine));
+        Temporary::OperandBase const s = graph.activation(Activation::Softmax, graph.add_bias(graph.matmul(w, x), b));
+        Temporary::OperandBase const y = graph.matmul(w, graph.activation(Activation::Sigmoid, s));
+        graph.compile(graph.loss(Net::Loss::SoftmaxCrossEntropy, y, t));
+        Matrix const input = random(4, batch, engine);
+        // one distribution per column, as the softmax cross-entropy takes
+        Matrix answer = random(4, batch, engine, 0, 1);
+        for (nnint j = 0; j < batch; j++) {
+            double const sum = answer(0, j) + answer(1, j) + answer(2, j) + answer(3, j);
+            for (nnint i = 0; i < 4; i++) {
+                answer(i, j) /= sum;
+            }
+        }
+        graph.feed(x, input);
+        graph.feed(t, answer);
+        passed &= check("softmax inside, w taken twice", graph);
+    }
+    return passed ? 0 : 1;
+}
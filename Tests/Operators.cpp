@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Net/NeuralNet.hpp"
+#include "../Ops/Operators/Operator.hpp"
+
+/*
+ * map, zip and reduce with Operators must give what plain loops over the elements give, on strided
+ * views starting mid-row, for vectorizable functors and plain lambdas alike, and whatever the thread count.
+ * A network whose Custom activations and loss are operators must then train exactly like the same network
+ * with the matching built-in ones.
+ */
+
+namespace {
+
+    using Matrix = LinearAlgebra::Matrix<double>;
+    using View = LinearAlgebra::MatrixView<double>;
+    using ConstView = LinearAlgebra::MatrixView<double const>;
+    using nnint = std::size_t;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+    struct Square {
+        static constexpr bool vectorizable = true;
+
+        double operator()(double x) const {
+            return x * x;
+        }
+
+        template<typename V, typename P>
+        BNN_ALWAYS_INLINE void packet(P &x) const {
+            x = V::mul(x, x);
+        }
+    };
+
+    struct Max {
+        static constexpr bool vectorizable = true;
+
+        double operator()(double a, double b) const {
+            return std::max(a, b);
+        }
+
+        template<typename V, typename P>
+        BNN_ALWAYS_INLINE void packet(P &a, P const &b) const {
+            a = V::max(a, b);
+        }
+    };
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+    struct Sigmoid {
+        double operator()(double z) const {
+            return 1 / (1 + std::exp(-z));
+        }
+    };
+
+    struct DSigmoid {
+        double operator()(double z) const {
+            double const s = 1 / (1 + std::exp(-z));
+            return s * (1 - s);
+        }
+    };
+
+    Matrix random(nnint row, nnint col, std::mt19937 &engine) {
+        std::uniform_real_distribution<double> uniform(-2, 2);
+        Matrix ret(row, col);
+        for (nnint i = 0; i < row; i++) {
+            for (nnint j = 0; j < col; j++) {
+                ret(i, j) = uniform(engine);
+            }
+        }
+        return ret;
+    }
+
+    // whether out holds f(r, c) at every element, within tolerance of its size
+    template<typename F>
+    bool matches(ConstView out, F const &f, double tolerance = 0) {
+        for (nnint i = 0; i < out.get_row(); i++) {
+            for (nnint j = 0; j < out.get_col(); j++) {
+                double const expected = f(i, j);
+                if (std::abs(out(i, j) - expected) > tolerance * std::max(1.0, std::abs(expected))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool report(char const *name, bool passed) {
+        std::printf("%-40s %s\n", name, passed ? "ok" : "FAILED");
+        return passed;
+    }
+
+    bool elementwise(std::mt19937 &engine) {
+        Matrix const A = random(300, 301, engine), B = random(300, 301, engine);
+        // windows starting mid-row, so no row of them is aligned, with the rest of each row left out
+        ConstView const a = A.view().block(3, 5, 290, 287), b = B.view().block(7, 1, 290, 287);
+        bool passed = true;
+
+        Matrix const squared = LinearAlgebra::compute(Operators::unary(Square()), a);
+        passed &= report("map, vectorizable", matches(squared, [&](nnint i, nnint j) { return a(i, j) * a(i, j); }));
+
+        auto const halve = Operators::unary([](double x) { return x / 2; });
+        Matrix const halved = LinearAlgebra::compute(halve, a.col_block(10, 100));
+        passed &= report("map, lambda, col_block", matches(halved, [&](nnint i, nnint j) { return a(i, 10 + j) / 2; }));
+
+        Matrix const larger = LinearAlgebra::compute(Operators::binomial(Max()), a, b);
+        passed &= report("zip, vectorizable",
+                         matches(larger, [&](nnint i, nnint j) { return std::max(a(i, j), b(i, j)); }));
+
+        auto const difference = Operators::binomial([](double x, double y) { return x - 3 * y; });
+        Matrix const differences = LinearAlgebra::compute(difference, a.row_block(4, 50), b.row_block(9, 50));
+        // the vector builds may contract x - 3 * y into one fused multiply-add
+        passed &= report("zip, lambda, row_block",
+                         matches(differences, [&](nnint i, nnint j) { return a(4 + i, j) - 3 * b(9 + i, j); }, 1e-15));
+
+        // into a strided window of a larger matrix, leaving the rest of it alone
+        Matrix out(300, 301, 7.0);
+        View const window = out.view().block(2, 3, 290, 287);
+        window.assign(LinearAlgebra::zip(Operators::binomial(Max()), LinearAlgebra::map(Operators::unary(Square()), a), b));
+        bool written = matches(window, [&](nnint i, nnint j) { return std::max(a(i, j) * a(i, j), b(i, j)); });
+        written &= matches(out.view().row_block(0, 2), [](nnint, nnint) { return 7.0; });
+        written &= matches(out.view().block(2, 0, 290, 3), [](nnint, nnint) { return 7.0; });
+        written &= matches(out.view().block(2, 290, 290, 11), [](nnint, nnint) { return 7.0; });
+        passed &= report("zip of map into a window", written);
+
+        double sum = 0, largest = a(0, 0), sum_of_squares = 0;
+        for (nnint i = 0; i < a.get_row(); i++) {
+            for (nnint j = 0; j < a.get_col(); j++) {
+                sum += a(i, j);
+                largest = std::max(largest, a(i, j));
+                sum_of_squares += a(i, j) * a(i, j);
+            }
+        }
+        double const reduced = LinearAlgebra::reduce(Operators::binomial(Operators::Plus()), 0.0, a);
+        passed &= report("reduce, Plus", std::abs(reduced - sum) <= 1e-9 * std::max(1.0, std::abs(sum)));
+        passed &= report("reduce, vectorizable max", LinearAlgebra::reduce(Operators::binomial(Max()), a(0, 0), a) == largest);
+        auto const plus = Operators::binomial([](double x, double y) { return x + y; });
+        double const squares = LinearAlgebra::reduce(plus, 0.0, LinearAlgebra::map(Operators::unary(Square()), a));
+        passed &= report("reduce of map, lambda", std::abs(squares - sum_of_squares) <= 1e-9 * sum_of_squares);
+        return passed;
+    }
+
+    // the same network with built-in activations and loss, and with operators doing the same
+    bool network(std::mt19937 &engine) {
+        constexpr nnint cases = 64;
+        nnint layer_size[3]{4, 7, 3};
+        Net::NeuralNet<double> builtin(3, layer_size, Net::Activation::Sigmoid, Net::Activation::Sigmoid,
+                                       Net::Loss::MeanSquaredError, 0.1, 8);
+        Net::NeuralNet<double> custom(3, layer_size, Operators::unary(Sigmoid()), Operators::unary(Sigmoid()),
+                                      Operators::unary(DSigmoid()), Operators::unary(DSigmoid()), 0.1, 8);
+        // 1/2 (a - t)^2, as MeanSquaredError
+        custom.set_custom_loss(Operators::binomial([](double a, double t) { return (a - t) * (a - t) / 2; }),
+                               Operators::binomial([](double a, double t) { return a - t; }));
+        custom.get_parameters().copy_from(builtin.get_parameters());
+
+        Matrix const input = random(4, cases, engine);
+        Matrix answer = random(3, cases, engine);
+        for (nnint i = 0; i < 3; i++) {
+            for (nnint j = 0; j < cases; j++) {
+                answer(i, j) = answer(i, j) > 0;
+            }
+        }
+        double worst = 0;
+        for (nnint epoch = 0; epoch < 20; epoch++) {
+            double const expected = builtin.learn(input, answer), actual = custom.learn(input, answer);
+            worst = std::max(worst, std::abs(expected - actual) / std::max(1.0, std::abs(expected)));
+        }
+        ConstView const p = builtin.get_parameters().flat(), q = custom.get_parameters().flat();
+        bool const same = matches(q, [&](nnint i, nnint j) { return p(i, j); }, 1e-9);
+        return report("Custom operators train as built-ins", same && worst <= 1e-9);
+    }
+
+}
+
+int main() {
+    std::mt19937 engine(1);
+    bool passed = true;
+    for (nnint threads : {1, 4}) {
+        LinearAlgebra::set_threads(threads);
+        std::printf("%zu thread(s)\n", threads);
+        passed &= elementwise(engine);
+        passed &= network(engine);
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <random>
+#include "../LinearAlgebra/Matrix.hpp"
+#include "../Net/InferenceModel.hpp"
+#include "../Net/NeuralNet.hpp"
+#include "../Net/QuantizedModel.hpp"
+
+/*
+ * An int8 QuantizedModel, calibrated on the training inputs, must stay close to the full precision
+ * InferenceModel of the same trained network on average, pick the same class for almost every sample and
+ * lose next to no accuracy, on the training set and on unseen inputs. Single outputs may still differ a
+ * lot for samples right on a class boundary.
+ */
+
+namespace {
+
+    using Matrix = LinearAlgebra::Matrix<double>;
+    using nnint = std::size_t;
+
+    constexpr nnint inputs = 3, classes = 3;
+    // mean output difference, least agreement and accuracy lost allowed
+    constexpr double max_mean_error = 0.02, min_agreement = 0.97, max_accuracy_loss = 0.02;
+
+    // samples of uniform inputs labelled, one-hot, by their largest input
+    void make_set(std::mt19937 &engine, Matrix &input, Matrix &answer) {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        for (nnint j = 0; j < input.get_col(); j++) {
+            nnint label = 0;
+            for (nnint r = 0; r < inputs; r++) {
+                input(r, j) = uniform(engine);
+                label = input(r, j) > input(label, j) ? r : label;
+            }
+            for (nnint r = 0; r < classes; r++) {
+                answer(r, j) = r == label;
+            }
+        }
+    }
+
+    bool check(char const *name, Net::QuantizationReport<double> const &report) {
+        std::printf("%s: max error %g, mean error %g, agreement %g, accuracy %g (int8 %g)\n", name,
+                    report.max_error, report.mean_error, report.agreement, report.reference_accuracy,
+                    report.quantized_accuracy);
+        return report.mean_error <= max_mean_error && report.agreement >= min_agreement &&
+               report.quantized_accuracy >= report.reference_accuracy - max_accuracy_loss;
+    }
+
+}
+
+int main() {
+    constexpr nnint training = 512, unseen = 1024;
+    std::mt19937 engine(1);
+    Matrix input(inputs, training), answer(classes, training), test_input(inputs, unseen), test_answer(classes, unseen);
+    make_set(engine, input, answer);
+    make_set(engine, test_input, test_answer);
+
+    nnint layer_size[3]{inputs, 8, classes};
+    Net::NeuralNet<double> nn(3, layer_size, Net::Activation::ReLU, Net::Activation::Softmax,
+                              Net::Loss::SoftmaxCrossEntropy, 0.01);
+    for (nnint epoch = 0; epoch < 200; epoch++) {
+        nn.learn(input, answer);
+    }
+
+    Net::InferenceModel<double> model(nn);
+    Net::QuantizedModel<double> quantized(nn, input);
+    bool passed = check("training set", Net::compare(model, quantized, input, answer));
+    passed &= check("unseen inputs", Net::compare(model, quantized, test_input, test_answer));
+    return passed ? 0 : 1;
+}
@@ -37,91 +37,9 @@ int main() {
 
     nnint layer_size[layer_count]{SIZE, SIZE + 3, output_size};
 
-    NN nn(layer_count,
-          layer_size,
-          // inner_function
-          [](Matrix matrix) -> Matrix {
-              const nnint row = matrix.get_row();
-              const nnint col = matrix.get_col();
-              /*
-              const double max = matrix.get_max();
-              Matrix M(row, col);
-              double sum = 0;
-              for(nnint i = 0; i < row; i++) {
-                  for(nnint j = 0; j < col; j++) {
-                      sum += exp(matrix(i, j) - max);
-                  }
-              }
-              for(nnint i = 0; i < row; i++) {
-                  for(nnint j = 0; j < col; j++) {
-                      M(i, j) = exp(matrix(i, j) - max) / sum;
-                  }
-              }
-              return M;
-               */
-              Matrix M(row, col);
-              for(nnint i = 0; i < row; i++) {
-                  for(nnint j = 0; j < col; j++) {
-                      M(i, j) = (matrix(i, j) > 0 ? matrix(i, j) : 0);
-                  }
-              }
-              return M;
-          },
-          // outer_function
-          //[](Matrix matrix) -> Matrix { return matrix; },
-          [](Matrix matrix) -> Matrix {
-              const nnint row = matrix.get_row();
-              const nnint col = matrix.get_col();
-              Matrix M(row, col);
-              for(nnint i = 0; i < row; i++) {
-                  for(nnint j = 0; j < col; j++) {
-                      M(i, j) = 1. / (1. + exp(-matrix(i, j)));
-                  }
-              }
-              return M;
-            },
-          // dinner_function
-          [](Matrix matrix) -> Matrix {
-                const nnint row = matrix.get_row();
-                const nnint col = matrix.get_col();
-                /*
-                const double max = matrix.get_max();
-                Matrix M(row, col);
-                double sum = 0;
-                for(nnint i = 0; i < row; i++) {
-                    for(nnint j = 0; j < col; j++) {
-                        sum += exp(matrix(i, j) - max);
-                    }
-                }
-                for(nnint i = 0; i < row; i++) {
-                    for(nnint j = 0; j < col; j++) {
-                        M(i, j) = exp(matrix(i, j) - max) / sum;
-                    }
-                }
-                return M;
-                 */
-                Matrix M(row, col);
-                for(nnint i = 0; i < row; i++) {
-                    for(nnint j = 0; j < col; j++) {
-                        M(i, j) = (matrix(i, j) > 0);
-                    }
-                }
-                return M;
-          },
-          // douter_function
-          [](Matrix matrix) -> Matrix {
-              const nnint row = matrix.get_row();
-              const nnint col = matrix.get_col();
-              Matrix M(row, col);
-              for(nnint i = 0; i < row; i++) {
-                  for(nnint j = 0; j < col; j++) {
-                      M(i, j) = 1;
-                  }
-              }
-              return M;
-          },
-          0.003
-    );
+    // ReLU hidden layers, sigmoid outputs trained on binary cross-entropy
+    NN nn(layer_count, layer_size, Net::Activation::ReLU, Net::Activation::Sigmoid,
+          Net::Loss::SigmoidCrossEntropy, 0.003);
 
     for(nnint i = 0; i < 700; i++) {
         std::cout << i << " : " << nn.learn(testcase_num, input, output) << '\n';